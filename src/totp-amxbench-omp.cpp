@@ -0,0 +1,29 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// The open.mp side of neufox-2fa-amxbench: what the Pawn component does for the component when
+// a script loads, without a server around it.
+
+#include <Server/Components/Pawn/Impl/pawn_natives.hpp>
+#include "totp-component.hpp"
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+// Point the component's amx_* at the VM's functions, indexed like the SA-MP plugin export table
+// the Pawn component's own table starts with, and register the SCRIPT_API natives with amx.
+void RegisterComponentNatives(AMX* amx, void* const* functions, size_t count)
+{
+	using AmxFunctions = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<IPawnComponent&>().getAmxFunctions())>>;
+	static AmxFunctions table {};
+	std::copy_n(functions, std::min(count, table.size()), table.begin());
+	setAmxFunctions(table);
+
+	TOTPComponent::getInstance();
+	pawn_natives::AmxLoad(amx);
+}
@@ -0,0 +1,14 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// The Pawn VM under the names in totp-amxbench-vm.hpp, for the open.mp build of
+// neufox-2fa-amxbench.
+
+#define AMX_NODYNALOAD
+#include "totp-amxbench-vm.hpp"
+#include <amx/amx.c>
@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Renames the Pawn VM's functions for the open.mp build of neufox-2fa-amxbench. The component
+// defines amx_* itself, forwarding each through the table the Pawn component hands it, so the
+// VM built into the benchmark takes other names and fills that table as the server would.
+// Included before amx.h, both by the harness and by totp-amxbench-vm.c.
+
+#define amx_Align16 amxvm_Align16
+#define amx_Align32 amxvm_Align32
+#define amx_Align64 amxvm_Align64
+#define amx_Allot amxvm_Allot
+#define amx_Callback amxvm_Callback
+#define amx_Cleanup amxvm_Cleanup
+#define amx_Clone amxvm_Clone
+#define amx_Exec amxvm_Exec
+#define amx_FindNative amxvm_FindNative
+#define amx_FindPublic amxvm_FindPublic
+#define amx_FindPubVar amxvm_FindPubVar
+#define amx_FindTagId amxvm_FindTagId
+#define amx_Flags amxvm_Flags
+#define amx_GetAddr amxvm_GetAddr
+#define amx_GetNative amxvm_GetNative
+#define amx_GetPublic amxvm_GetPublic
+#define amx_GetPubVar amxvm_GetPubVar
+#define amx_GetString amxvm_GetString
+#define amx_GetTag amxvm_GetTag
+#define amx_GetUserData amxvm_GetUserData
+#define amx_Init amxvm_Init
+#define amx_InitJIT amxvm_InitJIT
+#define amx_MemInfo amxvm_MemInfo
+#define amx_NameLength amxvm_NameLength
+#define amx_NativeInfo amxvm_NativeInfo
+#define amx_NumNatives amxvm_NumNatives
+#define amx_NumPublics amxvm_NumPublics
+#define amx_NumPubVars amxvm_NumPubVars
+#define amx_NumTags amxvm_NumTags
+#define amx_Push amxvm_Push
+#define amx_PushAddress amxvm_PushAddress
+#define amx_PushArray amxvm_PushArray
+#define amx_PushString amxvm_PushString
+#define amx_RaiseError amxvm_RaiseError
+#define amx_Register amxvm_Register
+#define amx_Release amxvm_Release
+#define amx_SetCallback amxvm_SetCallback
+#define amx_SetDebugHook amxvm_SetDebugHook
+#define amx_SetString amxvm_SetString
+#define amx_SetUserData amxvm_SetUserData
+#define amx_StrLen amxvm_StrLen
+#define amx_UTF8Check amxvm_UTF8Check
+#define amx_UTF8Get amxvm_UTF8Get
+#define amx_UTF8Len amxvm_UTF8Len
+#define amx_UTF8Put amxvm_UTF8Put
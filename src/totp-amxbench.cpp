@@ -0,0 +1,388 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// neufox-2fa-amxbench and neufox-2fa-amxbench-omp: time the natives as a script sees them,
+// through the Pawn VM.
+//
+//   neufox-2fa-amxbench[-omp] [--amx FILE] [--iterations N] [--repeat N] [--filter TEXT]
+//
+// Runs the abstract machine from pawn/source with totp-amxbench.amx, which is compiled from
+// totp-amxbench.pwn when the build finds pawncc. Each Case_ public loops over one native; the
+// harness reports the time per call and, subtracting an empty loop, per native, next to two
+// natives of its own that do nothing, with and without reading a string, to show the boundary
+// alone. The same script runs against either front-end, as the natives share their names:
+//
+// - neufox-2fa-amxbench registers the SA-MP plugin's natives through its own AmxLoad, so every
+//   call goes through SYSREQ, the native table, amx_GetAddr and amx_GetString as under SA-MP.
+// - neufox-2fa-amxbench-omp (TOTP_AMXBENCH_OPENMP) registers the component's SCRIPT_API natives
+//   through pawn-natives as the Pawn component does, with the VM's functions handed to the
+//   component in its AMX function table, so calls pay the same argument marshalling as on an
+//   open.mp server. Natives that take a player are skipped there: they look the player up in
+//   the server's player pool, which needs a running server.
+//
+// Built only with -DBUILD_BENCHMARKS=ON.
+
+#ifdef TOTP_AMXBENCH_OPENMP
+	#include "totp-amxbench-vm.hpp"
+#endif
+#include "totp-plugin.hpp"
+#include "totp-player-data.hpp"
+#include "totp-engine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef TOTP_AMXBENCH_SCRIPT
+	#define TOTP_AMXBENCH_SCRIPT "totp-amxbench.amx"
+#endif
+
+#ifdef TOTP_AMXBENCH_OPENMP
+void RegisterComponentNatives(AMX* amx, void* const* functions, size_t count);
+#else
+PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX* amx);
+PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX* amx);
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick();
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Any valid secret works.
+	constexpr const char* SECRET = "DKRYFMTAHOVCJQXE";
+
+	void printLog(const char* format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+		std::vfprintf(stderr, format, args);
+		va_end(args);
+		std::fputc('\n', stderr);
+	}
+
+	cell AMX_NATIVE_CALL n_Bench_Nop(AMX* amx, const cell* params)
+	{
+		(void)amx;
+		return params[1];
+	}
+
+	// What every native with a string argument does before its own work.
+	cell AMX_NATIVE_CALL n_Bench_NopString(AMX* amx, const cell* params)
+	{
+		char text[16];
+		cell* addr;
+		amx_GetAddr(amx, params[1], &addr);
+		amx_GetString(text, addr, 0, sizeof(text));
+		return static_cast<cell>(strlen(text));
+	}
+
+	// The server natives the include's OnPlayerConnect hook uses.
+	cell AMX_NATIVE_CALL n_GetPlayerIp(AMX* amx, const cell* params)
+	{
+		cell* addr;
+		amx_GetAddr(amx, params[2], &addr);
+		amx_SetString(addr, "127.0.0.1", 0, 0, static_cast<size_t>(params[3]));
+		return 9;
+	}
+
+	cell AMX_NATIVE_CALL n_gpci(AMX* amx, const cell* params)
+	{
+		cell* addr;
+		amx_GetAddr(amx, params[2], &addr);
+		amx_SetString(addr, "AMXBENCH", 0, 0, static_cast<size_t>(params[3]));
+		return 1;
+	}
+
+	const AMX_NATIVE_INFO benchNatives[] = {
+		{ "Bench_Nop", n_Bench_Nop },
+		{ "Bench_NopString", n_Bench_NopString },
+		{ "GetPlayerIp", n_GetPlayerIp },
+		{ "gpci", n_gpci },
+		{ NULL, NULL }
+	};
+
+#ifdef TOTP_AMXBENCH_OPENMP
+	// The VM's functions at their place in the plugin export table, for the component. Only
+	// those pawn-natives and the natives call are filled in.
+	void registerNatives(AMX& amx)
+	{
+		void* functions[PLUGIN_AMX_EXPORT_UTF8Put + 1] = {};
+		functions[PLUGIN_AMX_EXPORT_Allot] = reinterpret_cast<void*>(&amx_Allot);
+		functions[PLUGIN_AMX_EXPORT_Exec] = reinterpret_cast<void*>(&amx_Exec);
+		functions[PLUGIN_AMX_EXPORT_FindNative] = reinterpret_cast<void*>(&amx_FindNative);
+		functions[PLUGIN_AMX_EXPORT_FindPublic] = reinterpret_cast<void*>(&amx_FindPublic);
+		functions[PLUGIN_AMX_EXPORT_GetAddr] = reinterpret_cast<void*>(&amx_GetAddr);
+		functions[PLUGIN_AMX_EXPORT_GetString] = reinterpret_cast<void*>(&amx_GetString);
+		functions[PLUGIN_AMX_EXPORT_GetUserData] = reinterpret_cast<void*>(&amx_GetUserData);
+		functions[PLUGIN_AMX_EXPORT_NumNatives] = reinterpret_cast<void*>(&amx_NumNatives);
+		functions[PLUGIN_AMX_EXPORT_Push] = reinterpret_cast<void*>(&amx_Push);
+		functions[PLUGIN_AMX_EXPORT_PushArray] = reinterpret_cast<void*>(&amx_PushArray);
+		functions[PLUGIN_AMX_EXPORT_PushString] = reinterpret_cast<void*>(&amx_PushString);
+		functions[PLUGIN_AMX_EXPORT_RaiseError] = reinterpret_cast<void*>(&amx_RaiseError);
+		functions[PLUGIN_AMX_EXPORT_Register] = reinterpret_cast<void*>(&amx_Register);
+		functions[PLUGIN_AMX_EXPORT_Release] = reinterpret_cast<void*>(&amx_Release);
+		functions[PLUGIN_AMX_EXPORT_SetString] = reinterpret_cast<void*>(&amx_SetString);
+		functions[PLUGIN_AMX_EXPORT_SetUserData] = reinterpret_cast<void*>(&amx_SetUserData);
+		functions[PLUGIN_AMX_EXPORT_StrLen] = reinterpret_cast<void*>(&amx_StrLen);
+		RegisterComponentNatives(&amx, functions, sizeof(functions) / sizeof(functions[0]));
+	}
+#endif
+
+	// Load a compiled script the way the server does: the file fills the start of a block as
+	// large as the script's stack top, and amx_Init sets the machine up in place.
+	bool loadProgram(const std::string& path, AMX& amx, std::vector<unsigned char>& memory)
+	{
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+
+		AMX_HEADER header;
+		bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+			&& header.magic == AMX_MAGIC
+			&& header.size >= static_cast<int32_t>(sizeof(header))
+			&& header.stp >= header.size;
+		if (ok)
+		{
+			memory.assign(static_cast<size_t>(header.stp), 0);
+			std::rewind(file);
+			ok = std::fread(memory.data(), 1, static_cast<size_t>(header.size), file) == static_cast<size_t>(header.size);
+		}
+		std::fclose(file);
+		if (!ok)
+			return false;
+
+		std::memset(&amx, 0, sizeof(amx));
+		return amx_Init(&amx, memory.data()) == AMX_ERR_NONE;
+	}
+
+	// A public's arguments, first to last. Strings are copied onto the script's heap per call.
+	struct Argument
+	{
+		cell value;
+		const char* text;
+	};
+
+	// Call a public once and return how long it took, or a negative value if it failed.
+	double call(AMX& amx, int index, const std::vector<Argument>& args, cell* result = nullptr)
+	{
+		std::vector<cell> allocated;
+		for (size_t i = args.size(); i-- > 0;)
+		{
+			if (args[i].text)
+			{
+				cell address;
+				cell* physical;
+				if (amx_PushString(&amx, &address, &physical, args[i].text, 0, 0) != AMX_ERR_NONE)
+					return -1.0;
+				allocated.push_back(address);
+			}
+			else
+			{
+				amx_Push(&amx, args[i].value);
+			}
+		}
+
+		cell value = 0;
+		auto start = Clock::now();
+		int error = amx_Exec(&amx, &value, index);
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		if (result)
+			*result = value;
+
+		// Strings are allotted one after another; releasing the first frees them all.
+		if (!allocated.empty())
+			amx_Release(&amx, allocated.front());
+
+		return error == AMX_ERR_NONE ? elapsed : -1.0;
+	}
+
+	struct Case
+	{
+		const char* name;
+		const char* publicName;
+		std::vector<Argument> args;
+		// Acts on player 0, enabled by Case_Setup.
+		bool player;
+	};
+
+	void usage()
+	{
+		std::fprintf(stderr, "usage: neufox-2fa-amxbench [--amx FILE] [--iterations N] [--repeat N] [--filter TEXT]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string path = TOTP_AMXBENCH_SCRIPT;
+	long iterations = 1000000;
+	int repeat = 5;
+	std::string filter;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			usage();
+			return 1;
+		}
+
+		const char* value = argv[++i];
+		if (arg == "--amx")
+			path = value;
+		else if (arg == "--iterations")
+			iterations = std::atol(value);
+		else if (arg == "--repeat")
+			repeat = std::atoi(value);
+		else if (arg == "--filter")
+			filter = value;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	// Natives loop in the script, so the count has to fit a cell.
+	if (iterations <= 0 || iterations > 0x7FFFFFFF || repeat <= 0)
+	{
+		std::fprintf(stderr, "error: --iterations must be 1 to 2147483647 and --repeat positive\n");
+		return 1;
+	}
+
+	logprintf = printLog;
+#ifndef TOTP_AMXBENCH_OPENMP
+	PlayerDataManager::Get().Resize(DEFAULT_MAX_PLAYERS);
+#endif
+
+	AMX amx;
+	std::vector<unsigned char> memory;
+	if (!loadProgram(path, amx, memory))
+	{
+		std::fprintf(stderr, "error: cannot load %s; build it from src/totp-amxbench.pwn with pawncc and pass --amx\n", path.c_str());
+		return 1;
+	}
+
+#ifdef TOTP_AMXBENCH_OPENMP
+	// Ours last, so the check covers natives nobody provides.
+	registerNatives(amx);
+	if (amx_Register(&amx, benchNatives, -1) != AMX_ERR_NONE)
+	{
+		std::fprintf(stderr, "error: %s uses natives the component does not provide\n", path.c_str());
+		return 1;
+	}
+	const bool players = false;
+	const char* frontEnd = "open.mp component";
+#else
+	// Ours first, so AmxLoad reports only natives nobody provides.
+	amx_Register(&amx, benchNatives, -1);
+	if (AmxLoad(&amx) != AMX_ERR_NONE)
+	{
+		std::fprintf(stderr, "error: %s uses natives the plugin does not provide\n", path.c_str());
+		return 1;
+	}
+
+	int setup;
+	cell enabled = 0;
+	if (amx_FindPublic(&amx, "Case_Setup", &setup) != AMX_ERR_NONE || call(amx, setup, { { 0, SECRET } }, &enabled) < 0 || !enabled)
+	{
+		std::fprintf(stderr, "error: Case_Setup could not enable TOTP for player 0\n");
+		return 1;
+	}
+	const bool players = true;
+	const char* frontEnd = "SA-MP plugin";
+#endif
+
+	// The current code, so TOTP_Verify takes the success path every time.
+	std::string code = TOTPUtils::generateTOTP(std::string(SECRET), TOTPEngine::currentTimestamp());
+
+	const std::vector<Case> cases = {
+		{ "Bench_Nop", "Case_Nop", { { static_cast<cell>(iterations), nullptr } }, false },
+		{ "Bench_NopString", "Case_NopString", { { static_cast<cell>(iterations), nullptr }, { 0, "123456" } }, false },
+		{ "TOTP_IsEnabled", "Case_IsEnabled", { { static_cast<cell>(iterations), nullptr } }, true },
+		{ "TOTP_IsVerified", "Case_IsVerified", { { static_cast<cell>(iterations), nullptr } }, true },
+		{ "TOTP_GetFailedAttempts", "Case_GetFailedAttempts", { { static_cast<cell>(iterations), nullptr } }, true },
+		{ "TOTP_IsIPThrottled", "Case_IsIPThrottled", { { static_cast<cell>(iterations), nullptr }, { 0, "10.0.0.1" } }, false },
+		{ "TOTP_Verify", "Case_Verify", { { static_cast<cell>(iterations), nullptr }, { 0, code.c_str() } }, true },
+		{ "TOTP_GenerateSecret", "Case_GenerateSecret", { { static_cast<cell>(iterations), nullptr } }, true },
+		{ "TOTP_GetSecret", "Case_GetSecret", { { static_cast<cell>(iterations), nullptr } }, true },
+		{ "TOTP_Enable", "Case_Enable", { { static_cast<cell>(iterations), nullptr }, { 0, SECRET } }, true },
+		{ "TOTP_GetStates", "Case_GetStates", { { static_cast<cell>(iterations), nullptr } }, false },
+	};
+
+	// The empty loop, timed the same way, is what each native case has on top of its calls.
+	int loopIndex;
+	if (amx_FindPublic(&amx, "Case_Loop", &loopIndex) != AMX_ERR_NONE)
+	{
+		std::fprintf(stderr, "error: %s has no Case_Loop\n", path.c_str());
+		return 1;
+	}
+
+	double loop = -1.0;
+	for (int r = 0; r < repeat; r++)
+	{
+		double elapsed = call(amx, loopIndex, { { static_cast<cell>(iterations), nullptr } });
+		if (elapsed >= 0 && (loop < 0 || elapsed < loop))
+			loop = elapsed;
+	}
+
+	double scale = 1e9 / static_cast<double>(iterations);
+	std::printf("%s natives, %ld iterations, best of %d; empty loop %.2f ns/iteration\n", frontEnd, iterations, repeat, loop * scale);
+	std::printf("%-24s %12s %12s\n", "native", "ns/call", "ns/native");
+
+	for (const Case& benchmark : cases)
+	{
+		if (!filter.empty() && std::string_view(benchmark.name).find(filter) == std::string_view::npos)
+			continue;
+
+		if (benchmark.player && !players)
+		{
+			std::printf("%-24s %12s\n", benchmark.name, "needs server");
+			continue;
+		}
+
+		int index;
+		if (amx_FindPublic(&amx, benchmark.publicName, &index) != AMX_ERR_NONE)
+		{
+			std::printf("%-24s %12s\n", benchmark.name, "missing");
+			continue;
+		}
+
+		double best = -1.0;
+		for (int r = 0; r < repeat; r++)
+		{
+			double elapsed = call(amx, index, benchmark.args);
+			if (elapsed >= 0 && (best < 0 || elapsed < best))
+				best = elapsed;
+		}
+
+		if (best < 0)
+		{
+			std::printf("%-24s %12s\n", benchmark.name, "failed");
+			continue;
+		}
+
+		double own = std::max(best - loop, 0.0);
+		std::printf("%-24s %12.2f %12.2f\n", benchmark.name, best * scale, own * scale);
+#ifndef TOTP_AMXBENCH_OPENMP
+		ProcessTick();
+#endif
+	}
+
+#ifndef TOTP_AMXBENCH_OPENMP
+	AmxUnload(&amx);
+#endif
+	amx_Cleanup(&amx);
+	return 0;
+}
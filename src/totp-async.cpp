@@ -0,0 +1,157 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-async.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Most jobs a worker takes in one go; a flood is split between workers in chunks this size.
+	constexpr size_t MAX_BATCH = 64;
+	constexpr unsigned MAX_WORKERS = 4;
+
+	void deleteChain(TOTPAsync::VerifyJob* job)
+	{
+		while (job)
+		{
+			TOTPAsync::VerifyJob* next = job->next;
+			job->key.clear();
+			delete job;
+			job = next;
+		}
+	}
+}
+
+namespace TOTPAsync
+{
+	VerifyPool::~VerifyPool()
+	{
+		stop();
+	}
+
+	VerifyJob* VerifyPool::acquire()
+	{
+		if (workers_.empty())
+		{
+			stopping_ = false;
+			unsigned count = std::clamp(std::thread::hardware_concurrency() / 2, 1u, MAX_WORKERS);
+			for (unsigned i = 0; i < count; i++)
+				workers_.emplace_back(&VerifyPool::run, this);
+		}
+
+		VerifyJob* job = free_;
+		if (job)
+			free_ = job->next;
+		else
+			job = new VerifyJob();
+
+		job->next = nullptr;
+		job->success = false;
+		return job;
+	}
+
+	void VerifyPool::submit(VerifyJob* job)
+	{
+		inFlight_++;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			job->next = nullptr;
+			if (pendingTail_)
+				pendingTail_->next = job;
+			else
+				pendingHead_ = job;
+			pendingTail_ = job;
+		}
+		wake_.notify_one();
+	}
+
+	void VerifyPool::release(VerifyJob* job)
+	{
+		job->key.clear();
+		job->cache.clear();
+		std::memset(job->code, 0, sizeof(job->code));
+		job->next = free_;
+		free_ = job;
+		inFlight_--;
+	}
+
+	void VerifyPool::run()
+	{
+		std::vector<TOTPUtils::BatchRequest> requests;
+		requests.reserve(MAX_BATCH);
+
+		for (;;)
+		{
+			VerifyJob* first;
+			bool more;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [this] { return stopping_ || pendingHead_; });
+				if (stopping_)
+					return;
+
+				first = pendingHead_;
+				VerifyJob* last = first;
+				for (size_t n = 1; n < MAX_BATCH && last->next; n++)
+					last = last->next;
+
+				pendingHead_ = last->next;
+				if (!pendingHead_)
+					pendingTail_ = nullptr;
+				last->next = nullptr;
+				more = pendingHead_ != nullptr;
+			}
+			if (more)
+				wake_.notify_one();
+
+			requests.clear();
+			for (VerifyJob* job = first; job; job = job->next)
+				requests.push_back({ &job->key, std::string_view(job->code, job->codeLength), job->timestamp, false, &job->cache });
+
+			TOTPUtils::verifyTOTPBatch(requests.data(), requests.size());
+
+			// Link the results newest first so the main thread's reversal restores submission order.
+			VerifyJob* top = nullptr;
+			size_t i = 0;
+			for (VerifyJob* job = first; job; i++)
+			{
+				VerifyJob* next = job->next;
+				job->success = requests[i].success;
+				job->next = top;
+				top = job;
+				job = next;
+			}
+
+			first->next = completed_.load(std::memory_order_relaxed);
+			while (!completed_.compare_exchange_weak(first->next, top, std::memory_order_release, std::memory_order_relaxed))
+			{
+			}
+		}
+	}
+
+	void VerifyPool::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_all();
+
+		for (std::thread& worker : workers_)
+			worker.join();
+		workers_.clear();
+
+		deleteChain(pendingHead_);
+		pendingHead_ = pendingTail_ = nullptr;
+		deleteChain(completed_.exchange(nullptr, std::memory_order_acquire));
+		deleteChain(free_);
+		free_ = nullptr;
+		inFlight_ = 0;
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Background verification. The main thread hands jobs to a few worker threads and collects
+// the finished ones on its own tick, so callbacks and events keep running on the main thread.
+// Workers take every queued job at once and hash them through TOTPUtils::verifyTOTPBatch.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "totp-utils.hpp"
+
+namespace TOTPAsync
+{
+	// Everything a worker needs, copied so the player's data can change while the job is in flight.
+	struct VerifyJob
+	{
+		// Matched against the player's pending ticket when the result comes back.
+		uint64_t ticket;
+		int playerID;
+		TOTPUtils::TOTPKey key;
+		TOTPUtils::CodeCache cache;
+		char code[TOTPUtils::MAX_DIGITS];
+		size_t codeLength;
+		uint64_t timestamp;
+		bool success;
+		VerifyJob* next;
+	};
+
+	class VerifyPool
+	{
+	private:
+		std::vector<std::thread> workers_;
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		bool stopping_ = false;
+
+		// Submitted jobs, oldest first. Guarded by mutex_.
+		VerifyJob* pendingHead_ = nullptr;
+		VerifyJob* pendingTail_ = nullptr;
+
+		// Finished jobs, pushed by any worker and taken all at once by the main thread.
+		std::atomic<VerifyJob*> completed_ { nullptr };
+
+		// Recycled jobs. Only touched by the main thread.
+		VerifyJob* free_ = nullptr;
+		size_t inFlight_ = 0;
+
+		void run();
+
+		void release(VerifyJob* job);
+
+	public:
+		~VerifyPool();
+
+		// Get a job to fill in. Starts the workers on first use.
+		VerifyJob* acquire();
+
+		void submit(VerifyJob* job);
+
+		// Call handler for every finished job, in submission order per worker, then recycle them.
+		template <class Handler>
+		void drain(Handler&& handler)
+		{
+			if (inFlight_ == 0)
+				return;
+
+			VerifyJob* job = completed_.exchange(nullptr, std::memory_order_acquire);
+
+			// The stack hands jobs back newest first.
+			VerifyJob* ordered = nullptr;
+			while (job)
+			{
+				VerifyJob* next = job->next;
+				job->next = ordered;
+				ordered = job;
+				job = next;
+			}
+
+			while (ordered)
+			{
+				VerifyJob* next = ordered->next;
+				handler(*ordered);
+				release(ordered);
+				ordered = next;
+			}
+		}
+
+		size_t inFlight() const { return inFlight_; }
+
+		// Wait for the workers to finish and exit. Unfinished jobs are dropped.
+		void stop();
+	};
+}
@@ -0,0 +1,53 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Compiled with AVX2 enabled; only called after CPU detection.
+
+#include "totp-base32-impl.hpp"
+
+#if defined(TOTP_ARCH_X86)
+#include <immintrin.h>
+
+namespace
+{
+	struct AVX2
+	{
+		using Type = __m256i;
+		static constexpr size_t WIDTH = 32;
+
+		static Type load(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+		static void store(void* p, Type v) { _mm256_storeu_si256(static_cast<__m256i*>(p), v); }
+		static Type set1(uint8_t v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+		static Type add(Type a, Type b) { return _mm256_add_epi8(a, b); }
+		static Type sub(Type a, Type b) { return _mm256_sub_epi8(a, b); }
+		static Type band(Type a, Type b) { return _mm256_and_si256(a, b); }
+		static Type bor(Type a, Type b) { return _mm256_or_si256(a, b); }
+		static Type lessEqual(Type a, Type b) { return _mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b); }
+		static Type select(Type mask, Type a, Type b) { return _mm256_blendv_epi8(b, a, mask); }
+		static bool all(Type mask) { return _mm256_movemask_epi8(mask) == -1; }
+	};
+}
+
+namespace TOTPBase32::Detail
+{
+	bool decodeValuesAVX2(const char* input, size_t length, uint8_t* output)
+	{
+		return decodeValues<AVX2>(input, length, output);
+	}
+
+	bool validateAVX2(const char* input, size_t length)
+	{
+		return validate<AVX2>(input, length);
+	}
+
+	void encodeValuesAVX2(const uint8_t* input, size_t length, char* output)
+	{
+		encodeValues<AVX2>(input, length, output);
+	}
+}
+#endif
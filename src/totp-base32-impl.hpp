@@ -0,0 +1,126 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Width-generic base32 character mapping used by the SIMD kernels. Like the multi-buffer
+// SHA-1 code, each kernel translation unit instantiates these templates with its own vector
+// type; the scalar type below handles the tails and CPUs without a kernel.
+
+#include "totp-cpu.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace TOTPBase32
+{
+	namespace Detail
+	{
+		// One byte per lane; masks are 0xFF or 0x00.
+		struct Scalar
+		{
+			using Type = uint8_t;
+			static constexpr size_t WIDTH = 1;
+
+			static Type load(const void* p) { return *static_cast<const uint8_t*>(p); }
+			static void store(void* p, Type v) { *static_cast<uint8_t*>(p) = v; }
+			static Type set1(uint8_t v) { return v; }
+			static Type add(Type a, Type b) { return static_cast<uint8_t>(a + b); }
+			static Type sub(Type a, Type b) { return static_cast<uint8_t>(a - b); }
+			static Type band(Type a, Type b) { return a & b; }
+			static Type bor(Type a, Type b) { return a | b; }
+			static Type lessEqual(Type a, Type b) { return a <= b ? 0xFF : 0x00; }
+			static Type select(Type mask, Type a, Type b) { return static_cast<uint8_t>((mask & a) | (~mask & b)); }
+			static bool all(Type mask) { return mask == 0xFF; }
+		};
+
+		// Letters of either case map to 0-25 and '2'-'7' to 26-31; valid is set for those lanes.
+		template <class V>
+		inline typename V::Type charsToValues(typename V::Type chars, typename V::Type& valid)
+		{
+			using T = typename V::Type;
+
+			T folded = V::band(chars, V::set1(0xDF));
+			T letterValue = V::sub(folded, V::set1('A'));
+			T digitValue = V::sub(chars, V::set1('2'));
+			T letter = V::lessEqual(letterValue, V::set1(25));
+			T digit = V::lessEqual(digitValue, V::set1(5));
+
+			valid = V::bor(letter, digit);
+			return V::select(letter, letterValue, V::add(digitValue, V::set1(26)));
+		}
+
+		template <class V>
+		inline typename V::Type valuesToChars(typename V::Type values)
+		{
+			using T = typename V::Type;
+
+			T letter = V::lessEqual(values, V::set1(25));
+			return V::add(values, V::select(letter, V::set1('A'), V::set1('2' - 26)));
+		}
+
+		template <class V>
+		inline bool decodeValues(const char* input, size_t length, uint8_t* output)
+		{
+			size_t i = 0;
+			for (; i + V::WIDTH <= length; i += V::WIDTH)
+			{
+				typename V::Type valid;
+				typename V::Type values = charsToValues<V>(V::load(input + i), valid);
+				if (!V::all(valid))
+					return false;
+				V::store(output + i, values);
+			}
+
+			if constexpr (V::WIDTH > 1)
+				return decodeValues<Scalar>(input + i, length - i, output + i);
+			return true;
+		}
+
+		template <class V>
+		inline bool validate(const char* input, size_t length)
+		{
+			size_t i = 0;
+			for (; i + V::WIDTH <= length; i += V::WIDTH)
+			{
+				typename V::Type valid;
+				charsToValues<V>(V::load(input + i), valid);
+				if (!V::all(valid))
+					return false;
+			}
+
+			if constexpr (V::WIDTH > 1)
+				return validate<Scalar>(input + i, length - i);
+			return true;
+		}
+
+		template <class V>
+		inline void encodeValues(const uint8_t* input, size_t length, char* output)
+		{
+			size_t i = 0;
+			for (; i + V::WIDTH <= length; i += V::WIDTH)
+				V::store(output + i, valuesToChars<V>(V::load(input + i)));
+
+			if constexpr (V::WIDTH > 1)
+				encodeValues<Scalar>(input + i, length - i, output + i);
+		}
+
+#if defined(TOTP_ARCH_X86)
+		bool decodeValuesSSE2(const char* input, size_t length, uint8_t* output);
+		bool validateSSE2(const char* input, size_t length);
+		void encodeValuesSSE2(const uint8_t* input, size_t length, char* output);
+
+		bool decodeValuesAVX2(const char* input, size_t length, uint8_t* output);
+		bool validateAVX2(const char* input, size_t length);
+		void encodeValuesAVX2(const uint8_t* input, size_t length, char* output);
+#elif defined(TOTP_ARCH_ARM64)
+		bool decodeValuesNEON(const char* input, size_t length, uint8_t* output);
+		bool validateNEON(const char* input, size_t length);
+		void encodeValuesNEON(const uint8_t* input, size_t length, char* output);
+#endif
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// NEON is part of the AArch64 baseline, so this needs no extra flags or detection.
+
+#include "totp-base32-impl.hpp"
+
+#if defined(TOTP_ARCH_ARM64)
+#include <arm_neon.h>
+
+namespace
+{
+	struct NEON
+	{
+		using Type = uint8x16_t;
+		static constexpr size_t WIDTH = 16;
+
+		static Type load(const void* p) { return vld1q_u8(static_cast<const uint8_t*>(p)); }
+		static void store(void* p, Type v) { vst1q_u8(static_cast<uint8_t*>(p), v); }
+		static Type set1(uint8_t v) { return vdupq_n_u8(v); }
+		static Type add(Type a, Type b) { return vaddq_u8(a, b); }
+		static Type sub(Type a, Type b) { return vsubq_u8(a, b); }
+		static Type band(Type a, Type b) { return vandq_u8(a, b); }
+		static Type bor(Type a, Type b) { return vorrq_u8(a, b); }
+		static Type lessEqual(Type a, Type b) { return vcleq_u8(a, b); }
+		static Type select(Type mask, Type a, Type b) { return vbslq_u8(mask, a, b); }
+		static bool all(Type mask) { return vminvq_u8(mask) == 0xFF; }
+	};
+}
+
+namespace TOTPBase32::Detail
+{
+	bool decodeValuesNEON(const char* input, size_t length, uint8_t* output)
+	{
+		return decodeValues<NEON>(input, length, output);
+	}
+
+	bool validateNEON(const char* input, size_t length)
+	{
+		return validate<NEON>(input, length);
+	}
+
+	void encodeValuesNEON(const uint8_t* input, size_t length, char* output)
+	{
+		encodeValues<NEON>(input, length, output);
+	}
+}
+#endif
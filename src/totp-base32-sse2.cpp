@@ -0,0 +1,53 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Compiled with SSE2 enabled; only called after CPU detection.
+
+#include "totp-base32-impl.hpp"
+
+#if defined(TOTP_ARCH_X86)
+#include <emmintrin.h>
+
+namespace
+{
+	struct SSE2
+	{
+		using Type = __m128i;
+		static constexpr size_t WIDTH = 16;
+
+		static Type load(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+		static void store(void* p, Type v) { _mm_storeu_si128(static_cast<__m128i*>(p), v); }
+		static Type set1(uint8_t v) { return _mm_set1_epi8(static_cast<char>(v)); }
+		static Type add(Type a, Type b) { return _mm_add_epi8(a, b); }
+		static Type sub(Type a, Type b) { return _mm_sub_epi8(a, b); }
+		static Type band(Type a, Type b) { return _mm_and_si128(a, b); }
+		static Type bor(Type a, Type b) { return _mm_or_si128(a, b); }
+		static Type lessEqual(Type a, Type b) { return _mm_cmpeq_epi8(_mm_max_epu8(a, b), b); }
+		static Type select(Type mask, Type a, Type b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+		static bool all(Type mask) { return _mm_movemask_epi8(mask) == 0xFFFF; }
+	};
+}
+
+namespace TOTPBase32::Detail
+{
+	bool decodeValuesSSE2(const char* input, size_t length, uint8_t* output)
+	{
+		return decodeValues<SSE2>(input, length, output);
+	}
+
+	bool validateSSE2(const char* input, size_t length)
+	{
+		return validate<SSE2>(input, length);
+	}
+
+	void encodeValuesSSE2(const uint8_t* input, size_t length, char* output)
+	{
+		encodeValues<SSE2>(input, length, output);
+	}
+}
+#endif
@@ -0,0 +1,225 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-base32.hpp"
+#include "totp-base32-impl.hpp"
+#include <algorithm>
+#include <array>
+
+namespace
+{
+	using namespace TOTPBase32::Detail;
+
+	// Characters are mapped and bits packed in chunks of this many symbols (a multiple of 8).
+	constexpr size_t CHUNK = 256;
+
+	constexpr uint8_t SKIP = 0x40;
+	constexpr uint8_t INVALID = 0x80;
+
+	constexpr std::array<uint8_t, 256> makeDecodeTable()
+	{
+		std::array<uint8_t, 256> table = {};
+		for (size_t i = 0; i < table.size(); i++)
+			table[i] = INVALID;
+		for (uint8_t i = 0; i < 26; i++)
+		{
+			table['A' + i] = i;
+			table['a' + i] = i;
+		}
+		for (uint8_t i = 0; i < 6; i++)
+			table['2' + i] = 26 + i;
+		table[' '] = SKIP;
+		table['\t'] = SKIP;
+		table['\n'] = SKIP;
+		table['\r'] = SKIP;
+		table['-'] = SKIP;
+		return table;
+	}
+
+	constexpr std::array<uint8_t, 256> DECODE_TABLE = makeDecodeTable();
+
+	struct Kernels
+	{
+		bool (*decodeValues)(const char*, size_t, uint8_t*);
+		bool (*validate)(const char*, size_t);
+		void (*encodeValues)(const uint8_t*, size_t, char*);
+	};
+
+	Kernels select()
+	{
+#if defined(TOTP_ARCH_X86)
+		const TOTPCpu::Features& cpu = TOTPCpu::features();
+		if (cpu.avx2)
+			return { decodeValuesAVX2, validateAVX2, encodeValuesAVX2 };
+		if (cpu.sse2)
+			return { decodeValuesSSE2, validateSSE2, encodeValuesSSE2 };
+#elif defined(TOTP_ARCH_ARM64)
+		return { decodeValuesNEON, validateNEON, encodeValuesNEON };
+#endif
+		return { decodeValues<Scalar>, validate<Scalar>, encodeValues<Scalar> };
+	}
+
+	const Kernels& kernels()
+	{
+		static const Kernels selected = select();
+		return selected;
+	}
+
+	// Accumulates 5-bit symbols and writes out whole bytes.
+	struct BitWriter
+	{
+		uint8_t* output;
+		size_t capacity;
+		size_t length = 0;
+		uint32_t buffer = 0;
+		int bits = 0;
+
+		bool push(uint8_t symbol)
+		{
+			buffer = (buffer << 5) | symbol;
+			bits += 5;
+			if (bits < 8)
+				return true;
+
+			if (length == capacity)
+				return false;
+
+			bits -= 8;
+			output[length++] = static_cast<uint8_t>(buffer >> bits);
+			return true;
+		}
+
+		// Eight symbols make exactly five bytes.
+		bool pushGroup(const uint8_t* symbols)
+		{
+			if (bits != 0 || capacity - length < 5)
+			{
+				for (int i = 0; i < 8; i++)
+				{
+					if (!push(symbols[i]))
+						return false;
+				}
+				return true;
+			}
+
+			uint64_t group = 0;
+			for (int i = 0; i < 8; i++)
+				group = (group << 5) | symbols[i];
+			for (int i = 4; i >= 0; i--)
+				output[length++] = static_cast<uint8_t>(group >> (8 * i));
+			return true;
+		}
+	};
+
+	// Handles separators; used when the fast path finds a character outside the alphabet.
+	std::optional<size_t> decodeScalar(std::string_view input, uint8_t* output, size_t capacity)
+	{
+		BitWriter writer { output, capacity };
+		for (char c : input)
+		{
+			uint8_t value = DECODE_TABLE[static_cast<uint8_t>(c)];
+			if (value == SKIP)
+				continue;
+			if (value == INVALID || !writer.push(value))
+				return std::nullopt;
+		}
+
+		return writer.length;
+	}
+}
+
+namespace TOTPBase32
+{
+	bool isValid(std::string_view input)
+	{
+		return kernels().validate(input.data(), input.length());
+	}
+
+	void encodeSymbols(const uint8_t* symbols, size_t count, char* output)
+	{
+		kernels().encodeValues(symbols, count, output);
+	}
+
+	void encode(const uint8_t* input, size_t length, char* output)
+	{
+		std::array<uint8_t, CHUNK> symbols;
+		size_t count = 0;
+
+		// Five bytes make exactly eight symbols.
+		for (; length >= 5; input += 5, length -= 5)
+		{
+			uint64_t group = 0;
+			for (int i = 0; i < 5; i++)
+				group = (group << 8) | input[i];
+			for (int i = 7; i >= 0; i--)
+				symbols[count++] = static_cast<uint8_t>((group >> (5 * i)) & 0x1F);
+
+			if (count == symbols.size())
+			{
+				encodeSymbols(symbols.data(), count, output);
+				output += count;
+				count = 0;
+			}
+		}
+
+		uint32_t buffer = 0;
+		int bits = 0;
+		for (size_t i = 0; i < length; i++)
+		{
+			buffer = (buffer << 8) | input[i];
+			bits += 8;
+			while (bits >= 5)
+			{
+				bits -= 5;
+				symbols[count++] = static_cast<uint8_t>((buffer >> bits) & 0x1F);
+			}
+		}
+		if (bits > 0)
+			symbols[count++] = static_cast<uint8_t>((buffer << (5 - bits)) & 0x1F);
+
+		encodeSymbols(symbols.data(), count, output);
+		symbols.fill(0);
+	}
+
+	std::optional<size_t> decode(std::string_view input, uint8_t* output, size_t capacity)
+	{
+		std::array<uint8_t, CHUNK> symbols;
+		BitWriter writer { output, capacity };
+
+		const char* data = input.data();
+		size_t remaining = input.length();
+		while (remaining > 0)
+		{
+			size_t count = std::min(remaining, symbols.size());
+			if (!kernels().decodeValues(data, count, symbols.data()))
+			{
+				symbols.fill(0);
+				return decodeScalar(input, output, capacity);
+			}
+
+			bool written = true;
+			size_t i = 0;
+			for (; written && i + 8 <= count; i += 8)
+				written = writer.pushGroup(symbols.data() + i);
+			for (; written && i < count; i++)
+				written = writer.push(symbols[i]);
+
+			if (!written)
+			{
+				symbols.fill(0);
+				return std::nullopt;
+			}
+
+			data += count;
+			remaining -= count;
+		}
+
+		symbols.fill(0);
+		return writer.length;
+	}
+}
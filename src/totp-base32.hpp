@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// RFC 4648 base32 without padding. Character mapping and validation run through SSE2, AVX2
+// or NEON kernels picked at load time; bit packing is scalar. Nothing here allocates.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace TOTPBase32
+{
+	constexpr std::string_view ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+	constexpr size_t encodedLength(size_t bytes) { return (bytes * 8 + 4) / 5; }
+	constexpr size_t decodedLength(size_t chars) { return chars * 5 / 8; }
+
+	// True if every character is in the alphabet, in either case. Separators are not accepted.
+	bool isValid(std::string_view input);
+
+	// Map 5-bit values to alphabet characters.
+	void encodeSymbols(const uint8_t* symbols, size_t count, char* output);
+
+	// Writes encodedLength(length) characters; the last one is zero-padded on the right.
+	void encode(const uint8_t* input, size_t length, char* output);
+
+	// Case-insensitive; spaces, tabs, newlines and dashes are skipped and bits that do not make
+	// up a whole byte are dropped. Returns nullopt on any other character or if output is too small.
+	std::optional<size_t> decode(std::string_view input, uint8_t* output, size_t capacity);
+}
@@ -0,0 +1,626 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// neufox-2fa-bench: micro-benchmarks of the verification hot paths, for comparing a change
+// against the tree it started from.
+//
+//   neufox-2fa-bench [--filter TEXT] [--min-time SECONDS] [--json FILE] [--compare FILE]
+//
+// Each case runs until it has taken at least the minimum time and reports ns/op and heap
+// allocations/op, counted by replacing the global operator new. --json saves the results in
+// the same layout Google Benchmark uses, so its compare.py reads them too; --compare prints
+// the change against such a file. Built only with -DBUILD_BENCHMARKS=ON.
+
+#include "totp-utils.hpp"
+#include "totp-base32.hpp"
+#include "totp-crypto.hpp"
+#include "totp-extension.hpp"
+#include "totp-player-data.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	std::atomic<uint64_t> allocations { 0 };
+}
+
+// Every allocation in the process goes through here, so a case's count is exact as long as
+// nothing else runs at the same time. The array and nothrow forms forward to these.
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	// Keep the compiler from dropping a result nobody reads.
+	template <class T>
+	void keep(const T& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+#endif
+	}
+
+	// Handed to each case. The case does its setup, then runs its body run() times.
+	class State
+	{
+	public:
+		explicit State(uint64_t iterations)
+			: iterations_(iterations)
+		{
+		}
+
+		uint64_t iterations() const { return iterations_; }
+
+		// Work items per iteration, for the cases that process a batch at a time.
+		void setItems(uint64_t items) { items_ = items; }
+		uint64_t items() const { return items_; }
+
+		// Start the clock and the allocation count; everything before this is setup.
+		void start()
+		{
+			startAllocations_ = allocations.load(std::memory_order_relaxed);
+			startTime_ = Clock::now();
+		}
+
+		void stop()
+		{
+			elapsed_ = Clock::now() - startTime_;
+			allocated_ = allocations.load(std::memory_order_relaxed) - startAllocations_;
+		}
+
+		double seconds() const { return std::chrono::duration<double>(elapsed_).count(); }
+		uint64_t allocated() const { return allocated_; }
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		uint64_t iterations_;
+		uint64_t items_ = 1;
+		Clock::time_point startTime_;
+		Clock::duration elapsed_ {};
+		uint64_t startAllocations_ = 0;
+		uint64_t allocated_ = 0;
+	};
+
+	// Runs body state.iterations() times between start and stop.
+	template <class Body>
+	void measure(State& state, Body&& body)
+	{
+		uint64_t iterations = state.iterations();
+		state.start();
+		for (uint64_t i = 0; i < iterations; i++)
+			body(i);
+		state.stop();
+	}
+
+	struct Case
+	{
+		std::string name;
+		std::function<void(State&)> run;
+	};
+
+	struct Result
+	{
+		std::string name;
+		uint64_t iterations;
+		double nsPerOp;
+		double allocsPerOp;
+		double itemsPerSecond;
+	};
+
+	std::vector<Case>& cases()
+	{
+		static std::vector<Case> list;
+		return list;
+	}
+
+	void add(std::string name, std::function<void(State&)> run)
+	{
+		cases().push_back({ std::move(name), std::move(run) });
+	}
+
+	const char* algorithmName(TOTPUtils::Algorithm algorithm)
+	{
+		switch (algorithm)
+		{
+		case TOTPUtils::Algorithm::SHA256:
+			return "sha256";
+		case TOTPUtils::Algorithm::SHA512:
+			return "sha512";
+		default:
+			return "sha1";
+		}
+	}
+
+	// Fixed, so runs compare; the time step does not change anything measured.
+	constexpr uint64_t TIMESTAMP = 1700000000;
+
+	// A valid secret of length characters. Benchmarks do not need it to be random.
+	std::string makeSecret(size_t length)
+	{
+		static constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+		std::string secret(length, 'A');
+		for (size_t i = 0; i < length; i++)
+			secret[i] = ALPHABET[(i * 7 + 3) % 32];
+		return secret;
+	}
+
+	TOTPUtils::TOTPKey makeKey(size_t length, TOTPUtils::Algorithm algorithm = TOTPUtils::Algorithm::SHA1)
+	{
+		TOTPUtils::Params params;
+		params.algorithm = algorithm;
+		TOTPUtils::TOTPKey key;
+		TOTPUtils::prepareKey(makeSecret(length), params, key);
+		return key;
+	}
+
+	// The code a player would type: correct, but for the oldest step in the window, so a
+	// verification checks every step before it finds it.
+	std::string typedCode(const TOTPUtils::TOTPKey& key, int window)
+	{
+		return TOTPUtils::generateTOTP(key, TIMESTAMP - static_cast<uint64_t>(window) * key.params.period);
+	}
+
+	void registerUtils()
+	{
+		using namespace TOTPUtils;
+
+		for (size_t length : { 16, 32, 64 })
+		{
+			add("prepareKey/len:" + std::to_string(length), [length](State& state) {
+				std::string secret = makeSecret(length);
+				Params params;
+				TOTPKey key;
+				measure(state, [&](uint64_t) {
+					prepareKey(secret, params, key);
+					keep(key.length);
+				});
+			});
+
+			// The string API decodes the secret on every call.
+			add("generateTOTP/string/len:" + std::to_string(length), [length](State& state) {
+				std::string secret = makeSecret(length);
+				measure(state, [&](uint64_t i) {
+					std::string code = generateTOTP(secret, TIMESTAMP + i * 30);
+					keep(code);
+				});
+			});
+		}
+
+		for (Algorithm algorithm : { Algorithm::SHA1, Algorithm::SHA256, Algorithm::SHA512 })
+		{
+			std::string suffix = algorithmName(algorithm);
+			add("generateCode/" + suffix, [algorithm](State& state) {
+				TOTPKey key = makeKey(32, algorithm);
+				measure(state, [&](uint64_t i) {
+					keep(generateCode(key, TIMESTAMP + i * 30));
+				});
+			});
+
+			add("generateTOTP/key/" + suffix, [algorithm](State& state) {
+				TOTPKey key = makeKey(32, algorithm);
+				measure(state, [&](uint64_t i) {
+					std::string code = generateTOTP(key, TIMESTAMP + i * 30);
+					keep(code);
+				});
+			});
+		}
+
+		for (int window : { 0, 1, 2, 5 })
+		{
+			std::string suffix = "window:" + std::to_string(window);
+			add("verifyTOTP/key/" + suffix, [window](State& state) {
+				TOTPKey key = makeKey(32);
+				std::string code = typedCode(key, window);
+				measure(state, [&](uint64_t) {
+					keep(verifyTOTP(key, code, TIMESTAMP, window));
+				});
+			});
+
+			add("verifyTOTP/string/" + suffix, [window](State& state) {
+				std::string secret = makeSecret(32);
+				std::string code = typedCode(makeKey(32), window);
+				measure(state, [&](uint64_t) {
+					keep(verifyTOTP(secret, code, TIMESTAMP, Params(), window));
+				});
+			});
+
+			// The cache holds at most MAX_STEPS codes; wider windows bypass it.
+			if (static_cast<size_t>(window) * 2 + 1 > CodeCache::MAX_STEPS)
+				continue;
+
+			// A retry within the same step: every code comes from the cache.
+			add("verifyTOTP/cached/" + suffix, [window](State& state) {
+				TOTPKey key = makeKey(32);
+				CodeCache cache;
+				std::string code = typedCode(key, window);
+				verifyTOTP(key, cache, code, TIMESTAMP, window);
+				measure(state, [&](uint64_t) {
+					keep(verifyTOTP(key, cache, code, TIMESTAMP, window));
+				});
+			});
+
+			// A new step every attempt: one code is hashed, the rest are reused.
+			add("verifyTOTP/rollover/" + suffix, [window](State& state) {
+				TOTPKey key = makeKey(32);
+				CodeCache cache;
+				std::string code = typedCode(key, window);
+				measure(state, [&](uint64_t i) {
+					keep(verifyTOTP(key, cache, code, TIMESTAMP + i * 30, window));
+				});
+			});
+		}
+
+		for (size_t batch : { 1, 4, 8, 16, 64, 256 })
+		{
+			add("verifyTOTPBatch/batch:" + std::to_string(batch), [batch](State& state) {
+				std::vector<TOTPKey> keys(batch);
+				std::vector<std::string> codes(batch);
+				std::vector<BatchRequest> requests(batch);
+				for (size_t i = 0; i < batch; i++)
+				{
+					Params params;
+					prepareKey(makeSecret(32 - i % 8), params, keys[i]);
+					codes[i] = typedCode(keys[i], 1);
+					requests[i].key = &keys[i];
+					requests[i].code = codes[i];
+					requests[i].timestamp = TIMESTAMP;
+				}
+				state.setItems(batch);
+				measure(state, [&](uint64_t) {
+					verifyTOTPBatch(requests.data(), requests.size(), 1);
+					keep(requests[0].success);
+				});
+			});
+		}
+
+		for (size_t length : { 16, 32, 64 })
+		{
+			add("generateSecret/len:" + std::to_string(length), [length](State& state) {
+				measure(state, [&](uint64_t) {
+					std::optional<std::string> secret = generateSecret(length);
+					keep(secret);
+				});
+			});
+		}
+
+		for (size_t batch : { 1, 16, 256 })
+		{
+			add("generateSecrets/batch:" + std::to_string(batch), [batch](State& state) {
+				std::vector<char> output(batch * DEFAULT_SECRET_LENGTH);
+				state.setItems(batch);
+				measure(state, [&](uint64_t) {
+					keep(generateSecrets(batch, DEFAULT_SECRET_LENGTH, output.data()));
+				});
+			});
+		}
+	}
+
+	void registerBase32()
+	{
+		for (size_t length : { 16, 32, 64, 256 })
+		{
+			add("base32/decode/len:" + std::to_string(length), [length](State& state) {
+				std::string secret = makeSecret(length);
+				std::vector<uint8_t> output(TOTPBase32::decodedLength(length) + 1);
+				measure(state, [&](uint64_t) {
+					keep(TOTPBase32::decode(secret, output.data(), output.size()));
+				});
+			});
+
+			size_t bytes = TOTPBase32::decodedLength(length);
+			add("base32/encode/len:" + std::to_string(length), [bytes](State& state) {
+				std::vector<uint8_t> input(bytes, 0xA5);
+				std::vector<char> output(TOTPBase32::encodedLength(bytes));
+				measure(state, [&](uint64_t) {
+					TOTPBase32::encode(input.data(), input.size(), output.data());
+					keep(output[0]);
+				});
+			});
+		}
+	}
+
+	void registerAccessors()
+	{
+		// What the natives touch on every call, for the component and the plugin.
+		add("extension/isVerified", [](State& state) {
+			TOTPExtension* extension = TOTPExtension::create(0);
+			extension->setEnabled(true);
+			measure(state, [&](uint64_t) {
+				keep(extension->isVerified());
+			});
+			extension->freeExtension();
+		});
+
+		add("extension/getSecret", [](State& state) {
+			TOTPExtension* extension = TOTPExtension::create(0);
+			extension->setSecret(std::string_view(makeSecret(32)));
+			measure(state, [&](uint64_t) {
+				keep(extension->getSecret());
+			});
+			extension->freeExtension();
+		});
+
+		add("extension/setSecret", [](State& state) {
+			// Alternate, so every call decodes and prepares a new key.
+			TOTPExtension* extension = TOTPExtension::create(0);
+			std::string secrets[2] = { makeSecret(32), makeSecret(31) };
+			measure(state, [&](uint64_t i) {
+				extension->setSecret(std::string_view(secrets[i & 1]));
+			});
+			extension->freeExtension();
+		});
+
+		add("extension/createFree", [](State& state) {
+			measure(state, [&](uint64_t i) {
+				TOTPExtension* extension = TOTPExtension::create(static_cast<int>(i % PLAYER_POOL_SIZE));
+				keep(extension);
+				extension->freeExtension();
+			});
+		});
+
+		add("playerData/isVerified", [](State& state) {
+			PlayerDataManager& players = PlayerDataManager::Get();
+			players.SetEnabled(0, true);
+			measure(state, [&](uint64_t) {
+				keep(players.IsVerified(0));
+			});
+			players.SetEnabled(0, false);
+		});
+
+		add("playerData/setSecret", [](State& state) {
+			PlayerDataManager& players = PlayerDataManager::Get();
+			std::string secrets[2] = { makeSecret(32), makeSecret(31) };
+			measure(state, [&](uint64_t i) {
+				players.SetSecret(0, secrets[i & 1]);
+			});
+			players.SetSecret(0, {});
+		});
+
+		add("playerData/countUnverified", [](State& state) {
+			PlayerDataManager& players = PlayerDataManager::Get();
+			for (int i = 0; i < static_cast<int>(DEFAULT_MAX_PLAYERS); i += 3)
+				players.SetEnabled(i, true);
+			measure(state, [&](uint64_t) {
+				keep(players.CountUnverified());
+			});
+			for (int i = 0; i < static_cast<int>(DEFAULT_MAX_PLAYERS); i += 3)
+				players.SetEnabled(i, false);
+		});
+	}
+
+	// Grow the iteration count until one run takes at least minTime.
+	Result run(const Case& benchmark, double minTime)
+	{
+		uint64_t iterations = 1;
+		while (true)
+		{
+			State state(iterations);
+			benchmark.run(state);
+
+			double seconds = state.seconds();
+			if (seconds >= minTime || iterations >= (uint64_t(1) << 40))
+			{
+				double ops = static_cast<double>(iterations);
+				return {
+					benchmark.name,
+					iterations,
+					seconds * 1e9 / ops,
+					static_cast<double>(state.allocated()) / ops,
+					seconds > 0 ? ops * static_cast<double>(state.items()) / seconds : 0.0
+				};
+			}
+
+			// Aim a little past minTime from what this run took, growing at most tenfold.
+			double scale = seconds > 0 ? minTime * 1.4 / seconds : 10.0;
+			scale = std::min(std::max(scale, 2.0), 10.0);
+			iterations = static_cast<uint64_t>(static_cast<double>(iterations) * scale);
+		}
+	}
+
+	std::string escape(std::string_view text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	bool writeJSON(const std::string& path, const std::vector<Result>& results)
+	{
+		std::ofstream file(path);
+		if (!file)
+			return false;
+
+		// One benchmark per line, which readBaseline relies on.
+		file << "{\n  \"context\": {\"executable\": \"neufox-2fa-bench\", \"num_cpus\": " << std::thread::hardware_concurrency()
+			 << ", \"crypto_backend\": \"" << escape(TOTPCrypto::backendName()) << "\"},\n  \"benchmarks\": [\n";
+		char line[512];
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& result = results[i];
+			std::snprintf(line, sizeof(line),
+				"    {\"name\": \"%s\", \"run_type\": \"iteration\", \"iterations\": %llu, \"real_time\": %.3f, \"cpu_time\": %.3f, "
+				"\"time_unit\": \"ns\", \"allocs_per_iter\": %.3f, \"items_per_second\": %.1f}%s\n",
+				escape(result.name).c_str(), static_cast<unsigned long long>(result.iterations), result.nsPerOp, result.nsPerOp,
+				result.allocsPerOp, result.itemsPerSecond, i + 1 < results.size() ? "," : "");
+			file << line;
+		}
+		file << "  ]\n}\n";
+		return static_cast<bool>(file);
+	}
+
+	// The text after "key": on a line, up to the next comma or brace.
+	std::string field(const std::string& line, const char* key)
+	{
+		std::string pattern = std::string("\"") + key + "\": ";
+		size_t start = line.find(pattern);
+		if (start == std::string::npos)
+			return {};
+		start += pattern.length();
+		if (line[start] == '"')
+		{
+			size_t end = line.find('"', start + 1);
+			return end == std::string::npos ? std::string() : line.substr(start + 1, end - start - 1);
+		}
+		size_t end = line.find_first_of(",}", start);
+		return line.substr(start, end - start);
+	}
+
+	// Reads files written by writeJSON; anything else has to be one benchmark per line as well.
+	std::vector<Result> readBaseline(const std::string& path, bool& ok)
+	{
+		std::vector<Result> baseline;
+		std::ifstream file(path);
+		ok = static_cast<bool>(file);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::string name = field(line, "name");
+			std::string time = field(line, "real_time");
+			if (name.empty() || time.empty())
+				continue;
+
+			std::string allocs = field(line, "allocs_per_iter");
+			baseline.push_back({ name, 0, std::atof(time.c_str()), allocs.empty() ? -1.0 : std::atof(allocs.c_str()), 0.0 });
+		}
+		return baseline;
+	}
+
+	void usage()
+	{
+		std::fprintf(stderr, "usage: neufox-2fa-bench [--filter TEXT] [--min-time SECONDS] [--json FILE] [--compare FILE] [--list]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::string jsonPath;
+	std::string comparePath;
+	double minTime = 0.25;
+	bool list = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else if (arg == "--min-time" && hasValue)
+			minTime = std::atof(argv[++i]);
+		else if (arg == "--json" && hasValue)
+			jsonPath = argv[++i];
+		else if (arg == "--compare" && hasValue)
+			comparePath = argv[++i];
+		else if (arg == "--list")
+			list = true;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	if (minTime <= 0)
+	{
+		std::fprintf(stderr, "error: --min-time must be positive\n");
+		return 1;
+	}
+
+	std::vector<Result> baseline;
+	if (!comparePath.empty())
+	{
+		bool ok = false;
+		baseline = readBaseline(comparePath, ok);
+		if (!ok)
+		{
+			std::fprintf(stderr, "error: cannot read %s\n", comparePath.c_str());
+			return 1;
+		}
+	}
+
+	registerUtils();
+	registerBase32();
+	registerAccessors();
+
+	std::printf("crypto backend: %s\n", TOTPCrypto::backendName());
+	std::printf("%-36s %14s %12s %10s %14s", "benchmark", "iterations", "ns/op", "allocs/op", "items/s");
+	if (!baseline.empty())
+		std::printf(" %10s %10s", "base ns", "change");
+	std::printf("\n");
+
+	std::vector<Result> results;
+	for (const Case& benchmark : cases())
+	{
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+			continue;
+
+		if (list)
+		{
+			std::printf("%s\n", benchmark.name.c_str());
+			continue;
+		}
+
+		Result result = run(benchmark, minTime);
+		std::printf("%-36s %14llu %12.2f %10.2f %14.0f", result.name.c_str(), static_cast<unsigned long long>(result.iterations),
+			result.nsPerOp, result.allocsPerOp, result.itemsPerSecond);
+
+		auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Result& entry) { return entry.name == result.name; });
+		if (base != baseline.end() && base->nsPerOp > 0)
+		{
+			std::printf(" %10.2f %+9.1f%%", base->nsPerOp, (result.nsPerOp / base->nsPerOp - 1.0) * 100.0);
+			if (base->allocsPerOp >= 0 && result.allocsPerOp != base->allocsPerOp)
+				std::printf("  allocs %.2f -> %.2f", base->allocsPerOp, result.allocsPerOp);
+		}
+		std::printf("\n");
+		std::fflush(stdout);
+		results.push_back(result);
+	}
+
+	if (!jsonPath.empty() && !writeJSON(jsonPath, results))
+	{
+		std::fprintf(stderr, "error: cannot write %s\n", jsonPath.c_str());
+		return 1;
+	}
+	return 0;
+}
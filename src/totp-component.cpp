@@ -12,149 +12,449 @@
 #include "totp-component.hpp"
 #include "totp-extension.hpp"
 #include "totp-utils.hpp"
+#include "totp-engine.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+
+namespace
+{
+	constexpr StringView TICK_BUDGET_US_KEY = "totp.tick_budget_us";
+	constexpr StringView TICK_BUDGET_HASHES_KEY = "totp.tick_budget_hashes";
+	constexpr StringView ACCOUNT_STORE_KEY = "totp.account_store";
+	constexpr StringView ACCOUNT_STORE_DEFAULT = "scriptfiles/totp-accounts.dat";
+	constexpr StringView JOURNAL_INTERVAL_KEY = "totp.journal_interval_ms";
+	constexpr StringView MASTER_KEY_KEY = "totp.master_key";
+	constexpr StringView ACCOUNT_BACKEND_KEY = "totp.account_backend";
+	constexpr StringView ACCOUNT_BACKEND_FILE = "file";
+	constexpr StringView ACCOUNT_BACKEND_SQLITE = "sqlite";
+	constexpr StringView ACCOUNT_DATABASE_KEY = "totp.account_database";
+	constexpr StringView ACCOUNT_DATABASE_DEFAULT = "scriptfiles/totp-accounts.db";
+	constexpr StringView RESTORE_ON_GMX_KEY = "totp.restore_on_gmx";
+
+	using TOTPVerify::ADDRESS_LENGTH;
+
+	bool addressOf(IPlayer& player, char (&output)[ADDRESS_LENGTH])
+	{
+		return PeerAddress::ToString(player.getNetworkData().networkID.address, output, ADDRESS_LENGTH);
+	}
+
+}
 
 std::optional<std::string> TOTPComponent::generateSecret(IPlayer& player)
 {
 	return TOTPUtils::generateSecret();
 }
 
+std::optional<std::string> TOTPComponent::generateSecret(IPlayer& player, size_t length)
+{
+	return TOTPUtils::generateSecret(length);
+}
+
+std::optional<std::vector<std::string>> TOTPComponent::generateSecrets(size_t count, size_t length)
+{
+	return TOTPUtils::generateSecrets(count, length);
+}
+
 bool TOTPComponent::enableTOTP(IPlayer& player, const std::string& secret)
 {
-	if (secret.empty() || secret.length() < 10 || secret.length() > TOTP_SECRET_LENGTH)
-		return false;
+	char plain[TOTPUtils::MAX_SECRET_LENGTH];
+	std::string_view resolved(plain, TOTPEngine::resolveSecret(sealer_, secret, plain));
 
-	for (char c : secret)
+	bool enabled = false;
+	if (TOTPEngine::isValidSecret(resolved))
 	{
-		if (!((c >= 'A' && c <= 'Z') || (c >= '2' && c <= '7') || (c >= 'a' && c <= 'z')))
-			return false;
+		if (TOTPExtension* data = attachExtension(player))
+		{
+			TOTPEngine::enable(*data, resolved);
+			saveBoundAccount(*data);
+			eventDispatcher_.dispatch(&TOTPEventHandler::onTOTPEnabled, player);
+
+			callScripts(&ScriptCallbacks::onEnable, player.getID());
+
+			enabled = true;
+		}
 	}
 
-	if (ITOTPExtension* data = queryExtension<ITOTPExtension>(&player))
+	std::memset(plain, 0, sizeof(plain));
+	return enabled;
+}
+
+bool TOTPComponent::disableTOTP(IPlayer& player)
+{
+	if (TOTPExtension* data = attachExtension(player))
 	{
-		data->setSecret(secret.c_str());
-		data->setEnabled(true);
-		data->setVerified(false);
-		data->resetFailedAttempts();
-		eventDispatcher_.dispatch(&TOTPEventHandler::onTOTPEnabled, player);
+		TOTPEngine::disable(*data);
+		saveBoundAccount(*data);
+		eventDispatcher_.dispatch(&TOTPEventHandler::onTOTPDisabled, player);
 
-		if (pawn_)
-		{
-			int playerID = player.getID();
-			for (IPawnScript* script : pawn_->sideScripts())
-				script->Call("OnPlayerTOTPEnable", DefaultReturnValue_False, playerID);
+		callScripts(&ScriptCallbacks::onDisable, player.getID());
 
-			if (auto script = pawn_->mainScript())
-				script->Call("OnPlayerTOTPEnable", DefaultReturnValue_False, playerID);
-		}
+		return true;
+	}
 
+	return false;
+}
+
+bool TOTPComponent::setSettings(IPlayer& player, const TOTPSettings& settings)
+{
+	if (TOTPExtension* data = attachExtension(player))
+	{
+		if (!data->setSettings(settings))
+			return false;
+
+		saveBoundAccount(*data);
 		return true;
 	}
+	return false;
+}
+
+TOTPExtension* TOTPComponent::attachExtension(IPlayer& player)
+{
+	TOTPExtension* data = queryExtension<TOTPExtension>(&player);
+	if (!data)
+	{
+		data = TOTPExtension::create(player.getID());
+		player.addExtension(data, true);
+	}
+	return data;
+}
 
+IPlayer* TOTPComponent::VerifyHost::findPlayer(int id)
+{
+	return component->core_->getPlayers().get(id);
+}
+
+TOTPExtension* TOTPComponent::VerifyHost::extensionOf(IPlayer& player)
+{
+	return queryExtension<TOTPExtension>(&player);
+}
+
+int TOTPComponent::VerifyHost::playerID(IPlayer& player)
+{
+	return player.getID();
+}
+
+bool TOTPComponent::VerifyHost::addressOf(IPlayer& player, char (&address)[TOTPVerify::ADDRESS_LENGTH])
+{
+	return ::addressOf(player, address);
+}
+
+std::string_view TOTPComponent::VerifyHost::serialOf(IPlayer& player)
+{
+	StringView serial = player.getSerial();
+	return std::string_view(serial.data(), serial.length());
+}
+
+std::string_view TOTPComponent::VerifyHost::nameOf(IPlayer& player)
+{
+	StringView name = player.getName();
+	return std::string_view(name.data(), name.length());
+}
+
+void TOTPComponent::VerifyHost::notifyVerify(IPlayer& player, bool success, std::string_view code)
+{
+	component->eventDispatcher_.dispatch(&TOTPEventHandler::onTOTPVerify, player, success, StringView(code.data(), code.length()));
+
+	component->callScripts(&ScriptCallbacks::onVerify, player.getID(), success);
+}
+
+TOTPVerifyResult TOTPComponent::verifyCode(IPlayer& player, StringView code)
+{
+	return verifier_.verifyCode(player, std::string_view(code.data(), code.length()));
+}
+
+void TOTPComponent::verifyCodes(Span<TOTPVerifyRequest> requests)
+{
+	verifier_.verifyCodes(requests.data(), requests.size());
+}
+
+bool TOTPComponent::verifyCodeAsync(IPlayer& player, StringView code)
+{
+	return verifier_.verifyCodeAsync(player, std::string_view(code.data(), code.length()));
+}
+
+bool TOTPComponent::isAddressThrottled(StringView address)
+{
+	return verifier_.isAddressThrottled(std::string_view(address.data(), address.length()));
+}
+
+bool TOTPComponent::isEnabled(IPlayer& player)
+{
+	if (ITOTPExtension* data = queryExtension<ITOTPExtension>(&player))
+	{
+		return data->isEnabled();
+	}
 	return false;
 }
 
-bool TOTPComponent::disableTOTP(IPlayer& player)
+bool TOTPComponent::isVerified(IPlayer& player)
 {
 	if (ITOTPExtension* data = queryExtension<ITOTPExtension>(&player))
 	{
-		data->setEnabled(false);
-		data->setVerified(false);
-		data->setSecret("");
-		eventDispatcher_.dispatch(&TOTPEventHandler::onTOTPDisabled, player);
+		return data->isVerified();
+	}
+	return false;
+}
 
-		if (pawn_)
-		{
-			int playerID = player.getID();
-			for (IPawnScript* script : pawn_->sideScripts())
-				script->Call("OnPlayerTOTPDisable", DefaultReturnValue_False, playerID);
+bool TOTPComponent::isVerifyPending(IPlayer& player)
+{
+	if (TOTPExtension* data = queryExtension<TOTPExtension>(&player))
+	{
+		return data->getPendingTicket() != 0;
+	}
+	return false;
+}
 
-			if (auto script = pawn_->mainScript())
-				script->Call("OnPlayerTOTPDisable", DefaultReturnValue_False, playerID);
-		}
+TOTPStore::AccountStore* TOTPComponent::accountStore()
+{
+	if (accountStore_.isOpen())
+		return &accountStore_;
 
-		return true;
+	// Report a bad path or file once rather than on every login.
+	if (accountBackend_ != AccountBackend::File || accountStoreFailed_ || accountStorePath_.empty())
+		return nullptr;
+
+	if (!accountStore_.open(accountStorePath_, journalInterval_))
+	{
+		accountStoreFailed_ = true;
+		if (core_)
+			core_->logLn(LogLevel::Error, "[TOTP] Could not open account store %s", accountStorePath_.c_str());
+		return nullptr;
 	}
+	return &accountStore_;
+}
 
-	return false;
+TOTPSQLite::AccountDatabase* TOTPComponent::accountDatabase()
+{
+	if (accountDatabase_.isOpen())
+		return &accountDatabase_;
+
+	if (accountBackend_ != AccountBackend::SQLite || accountDatabaseFailed_ || accountDatabasePath_.empty())
+		return nullptr;
+
+	if (!accountDatabase_.open(accountDatabasePath_, journalInterval_))
+	{
+		accountDatabaseFailed_ = true;
+		if (core_)
+			core_->logLn(LogLevel::Error, "[TOTP] Could not open account database %s", accountDatabasePath_.c_str());
+		return nullptr;
+	}
+	return &accountDatabase_;
+}
+
+bool TOTPComponent::hasAccountBackend()
+{
+	if (accountBackend_ == AccountBackend::SQLite)
+		return accountDatabase() != nullptr;
+	return accountStore() != nullptr;
+}
+
+bool TOTPComponent::storeAccount(std::string_view account, const TOTPStore::Entry& entry)
+{
+	if (accountBackend_ == AccountBackend::SQLite)
+	{
+		TOTPSQLite::AccountDatabase* database = accountDatabase();
+		return database && database->store(account, entry);
+	}
+
+	TOTPStore::AccountStore* store = accountStore();
+	return store && store->store(account, entry);
+}
+
+bool TOTPComponent::removeAccount(std::string_view account)
+{
+	if (accountBackend_ == AccountBackend::SQLite)
+	{
+		TOTPSQLite::AccountDatabase* database = accountDatabase();
+		return database && database->remove(account);
+	}
+
+	TOTPStore::AccountStore* store = accountStore();
+	return store && store->remove(account);
 }
 
-bool TOTPComponent::verifyCode(IPlayer& player, const std::string& code)
+bool TOTPComponent::applyAccount(IPlayer& player, std::string_view account, const TOTPUtils::Params& params, std::string_view secret)
 {
-	if (code.length() != 6)
+	if (!TOTPEngine::isValidSecret(secret))
 		return false;
 
-	ITOTPExtension* data = queryExtension<ITOTPExtension>(&player);
-	if (!data || !data->isEnabled() || !data->hasSecret())
+	TOTPSettings settings;
+	settings.algorithm = static_cast<TOTPAlgorithm>(params.algorithm);
+	settings.digits = params.digits;
+	settings.period = params.period;
+
+	TOTPExtension* data = attachExtension(player);
+	if (!data || !data->setSettings(settings))
 		return false;
 
-	auto nowSteady = std::chrono::steady_clock::now();
-	TimePoint nowTimePoint = std::chrono::time_point_cast<Microseconds>(nowSteady);
+	TOTPEngine::enable(*data, secret);
+	data->setAccount(account);
+	return true;
+}
 
-	if (data->getFailedAttempts() >= MAX_FAILED_ATTEMPTS)
-	{
-		auto timeSinceLastAttempt = std::chrono::duration_cast<std::chrono::seconds>(
-			nowTimePoint - data->getLastAttempt()
-		).count();
+bool TOTPComponent::loadAccount(IPlayer& player, StringView account)
+{
+	TOTPStore::AccountStore* store = accountStore();
+	if (!store)
+		return false;
 
-		if (timeSinceLastAttempt < RATE_LIMIT_SECONDS)
-			return false;
-		else
-			data->resetFailedAttempts();
-	}
+	std::string_view name(account.data(), account.length());
+	TOTPStore::Entry entry;
+	if (!store->find(name, entry))
+		return false;
+
+	char secret[TOTPUtils::MAX_SECRET_LENGTH];
+	size_t secretLength = TOTPEngine::resolveSecret(sealer_, entry.getSecret(), secret);
+	bool loaded = secretLength != 0 && applyAccount(player, name, entry.params, std::string_view(secret, secretLength));
 
-	data->setLastAttempt(nowTimePoint);
+	std::memset(secret, 0, sizeof(secret));
+	entry.clear();
+	return loaded;
+}
 
-	auto nowSystem = std::chrono::system_clock::now();
-	uint64_t timestamp = std::chrono::duration_cast<std::chrono::seconds>(
-		nowSystem.time_since_epoch()
-	).count();
+bool TOTPComponent::loadAccountAsync(IPlayer& player, StringView account)
+{
+	if (!hasAccountBackend())
+		return false;
 
-	bool success = TOTPUtils::verifyTOTP(data->getSecret(), code, timestamp);
+	TOTPExtension* data = attachExtension(player);
+	if (!data)
+		return false;
 
-	if (success)
+	uint64_t ticket = verifier_.nextTicket();
+	if (accountBackend_ == AccountBackend::SQLite)
 	{
-		data->setVerified(true);
-		data->resetFailedAttempts();
+		if (!accountDatabase_.load(ticket, player.getID(), std::string_view(account.data(), account.length())))
+			return false;
 	}
 	else
 	{
-		data->incrementFailedAttempts();
+		// The mapped store is read in place, so only the result waits for the next tick.
+		loadResults_.push_back({ ticket, player.getID(), loadAccount(player, account) });
 	}
 
-	eventDispatcher_.dispatch(&TOTPEventHandler::onTOTPVerify, player, success, code);
+	data->setPendingLoad(ticket);
+	return true;
+}
 
-	if (pawn_)
+void TOTPComponent::notifyLoaded(IPlayer& player, bool success)
+{
+	eventDispatcher_.dispatch(&TOTPEventHandler::onTOTPLoaded, player, success);
+
+	callScripts(&ScriptCallbacks::onLoaded, player.getID(), success);
+}
+
+void TOTPComponent::loadAccounts(Span<TOTPLoadRequest> requests)
+{
+	for (size_t i = 0; i < requests.size(); i++)
+		requests[i].success = false;
+
+	TOTPStore::AccountStore* store = accountStore();
+	if (!store)
+		return;
+
+	// Look everything up first, so the sealed secrets can be opened together.
+	loadEntries_.resize(requests.size());
+	loadOpens_.clear();
+	for (size_t i = 0; i < requests.size(); i++)
 	{
-		int playerID = player.getID();
-		for (IPawnScript* script : pawn_->sideScripts())
-			script->Call("OnPlayerTOTPVerify", DefaultReturnValue_False, playerID, success);
+		TOTPStore::Entry& entry = loadEntries_[i];
+		const TOTPLoadRequest& request = requests[i];
+		entry.secretLength = 0;
+		if (!request.player || !store->find(std::string_view(request.account.data(), request.account.length()), entry))
+			continue;
 
-		if (auto script = pawn_->mainScript())
+		if (TOTPSeal::isSealed(entry.getSecret()))
 		{
-			script->Call("OnPlayerTOTPVerify", DefaultReturnValue_False, playerID, success);
+			TOTPSeal::OpenRequest open;
+			open.sealed = entry.getSecret();
+			loadOpens_.push_back(open);
 		}
 	}
 
-	return success;
-}
+	sealer_.openAll(loadOpens_.data(), loadOpens_.size());
 
-bool TOTPComponent::isEnabled(IPlayer& player)
-{
-	if (ITOTPExtension* data = queryExtension<ITOTPExtension>(&player))
+	size_t opened = 0;
+	for (size_t i = 0; i < requests.size(); i++)
 	{
-		return data->isEnabled();
+		TOTPStore::Entry& entry = loadEntries_[i];
+		if (entry.secretLength == 0)
+			continue;
+
+		std::string_view secret = entry.getSecret();
+		if (TOTPSeal::isSealed(secret))
+		{
+			const TOTPSeal::OpenRequest& open = loadOpens_[opened++];
+			secret = std::string_view(open.secret, open.success ? open.secretLength : 0);
+		}
+
+		TOTPLoadRequest& request = requests[i];
+		request.success = applyAccount(*request.player, std::string_view(request.account.data(), request.account.length()), entry.params, secret);
+		entry.clear();
 	}
-	return false;
+
+	for (TOTPSeal::OpenRequest& open : loadOpens_)
+		std::memset(open.secret, 0, sizeof(open.secret));
 }
 
-bool TOTPComponent::isVerified(IPlayer& player)
+bool TOTPComponent::writeAccount(std::string_view account, TOTPExtension& data)
 {
-	if (ITOTPExtension* data = queryExtension<ITOTPExtension>(&player))
+	if (!data.isEnabled() || !data.hasSecret())
 	{
-		return data->isVerified();
+		removeAccount(account);
+		return true;
 	}
-	return false;
+
+	TOTPStore::Entry entry;
+	entry.secretLength = TOTPEngine::exportSecret(sealer_, data.getSecret(), entry.secret, sizeof(entry.secret));
+	entry.params = data.getParams();
+	if (entry.secretLength == 0)
+		return false;
+
+	bool saved = storeAccount(account, entry);
+	entry.clear();
+	return saved;
+}
+
+void TOTPComponent::saveBoundAccount(TOTPExtension& data)
+{
+	if (!data.getAccount().empty())
+		writeAccount(data.getAccount(), data);
+}
+
+bool TOTPComponent::saveAccount(IPlayer& player, StringView account)
+{
+	if (!hasAccountBackend() || account.length() == 0 || account.length() > TOTPStore::MAX_ACCOUNT_LENGTH)
+		return false;
+
+	TOTPExtension* data = attachExtension(player);
+	if (!data)
+		return false;
+
+	std::string_view name(account.data(), account.length());
+	if (!writeAccount(name, *data))
+		return false;
+
+	data->setAccount(name);
+	return true;
+}
+
+bool TOTPComponent::deleteAccount(StringView account)
+{
+	return removeAccount(std::string_view(account.data(), account.length()));
+}
+
+Span<const uint64_t> TOTPComponent::getEnabledMask()
+{
+	const std::vector<uint64_t>& words = TOTPExtension::enabledPlayers().words();
+	return Span<const uint64_t>(words.data(), words.size());
+}
+
+Span<const uint64_t> TOTPComponent::getVerifiedMask()
+{
+	const std::vector<uint64_t>& words = TOTPExtension::verifiedPlayers().words();
+	return Span<const uint64_t>(words.data(), words.size());
 }
 
 IEventDispatcher<TOTPEventHandler>& TOTPComponent::getEventDispatcher()
@@ -175,8 +475,68 @@ SemanticVersion TOTPComponent::componentVersion() const
 void TOTPComponent::onLoad(ICore* c)
 {
 	core_ = c;
-	core_->getPlayers().getPlayerConnectDispatcher().addEventHandler(this);
+	core_->getEventDispatcher().addEventHandler(this);
 	setAmxLookups(core_);
+
+	IConfig& config = core_->getConfig();
+	int* budgetUs = config.getInt(TICK_BUDGET_US_KEY);
+	int* budgetHashes = config.getInt(TICK_BUDGET_HASHES_KEY);
+	verifier_.setTickBudget(Microseconds(budgetUs ? std::max(*budgetUs, 0) : 0), budgetHashes ? std::max(*budgetHashes, 0) : 0);
+
+	StringView storePath = config.getString(ACCOUNT_STORE_KEY);
+	accountStorePath_.assign(storePath.data(), storePath.length());
+	if (int* interval = config.getInt(JOURNAL_INTERVAL_KEY))
+		journalInterval_ = std::chrono::milliseconds(std::max(*interval, 1));
+
+	StringView databasePath = config.getString(ACCOUNT_DATABASE_KEY);
+	accountDatabasePath_.assign(databasePath.data(), databasePath.length());
+
+	StringView backend = config.getString(ACCOUNT_BACKEND_KEY);
+	if (backend == ACCOUNT_BACKEND_SQLITE)
+	{
+		accountBackend_ = AccountBackend::SQLite;
+		if (!TOTPSQLite::isAvailable())
+		{
+			accountDatabaseFailed_ = true;
+			core_->logLn(LogLevel::Error, "[TOTP] %s is sqlite but this build has no SQLite support", ACCOUNT_BACKEND_KEY.data());
+		}
+	}
+	else if (!backend.empty() && backend != ACCOUNT_BACKEND_FILE)
+	{
+		core_->logLn(LogLevel::Error, "[TOTP] Unknown %s \"%.*s\", using the account store file", ACCOUNT_BACKEND_KEY.data(), static_cast<int>(backend.length()), backend.data());
+	}
+
+	if (bool* restore = config.getBool(RESTORE_ON_GMX_KEY))
+		restoreOnGmx_ = *restore;
+
+	StringView masterKey = config.getString(MASTER_KEY_KEY);
+	if (!sealer_.setKey(std::string_view(masterKey.data(), masterKey.length())))
+	{
+		if (!TOTPSeal::isAvailable())
+			core_->logLn(LogLevel::Error, "[TOTP] %s is set but this build has no OpenSSL; secrets are not sealed", MASTER_KEY_KEY.data());
+		else
+			core_->logLn(LogLevel::Error, "[TOTP] %s must be 64 hex digits; secrets are not sealed", MASTER_KEY_KEY.data());
+	}
+}
+
+void TOTPComponent::provideConfiguration(ILogger& logger, IEarlyConfig& config, bool defaults)
+{
+	if (defaults || config.getType(TICK_BUDGET_US_KEY) == ConfigOptionType_None)
+		config.setInt(TICK_BUDGET_US_KEY, 0);
+	if (defaults || config.getType(TICK_BUDGET_HASHES_KEY) == ConfigOptionType_None)
+		config.setInt(TICK_BUDGET_HASHES_KEY, 0);
+	if (defaults || config.getType(ACCOUNT_STORE_KEY) == ConfigOptionType_None)
+		config.setString(ACCOUNT_STORE_KEY, ACCOUNT_STORE_DEFAULT);
+	if (defaults || config.getType(JOURNAL_INTERVAL_KEY) == ConfigOptionType_None)
+		config.setInt(JOURNAL_INTERVAL_KEY, static_cast<int>(TOTPJournal::DEFAULT_COMMIT_INTERVAL.count()));
+	if (defaults || config.getType(ACCOUNT_BACKEND_KEY) == ConfigOptionType_None)
+		config.setString(ACCOUNT_BACKEND_KEY, ACCOUNT_BACKEND_FILE);
+	if (defaults || config.getType(ACCOUNT_DATABASE_KEY) == ConfigOptionType_None)
+		config.setString(ACCOUNT_DATABASE_KEY, ACCOUNT_DATABASE_DEFAULT);
+	if (defaults || config.getType(RESTORE_ON_GMX_KEY) == ConfigOptionType_None)
+		config.setBool(RESTORE_ON_GMX_KEY, true);
+	if (defaults || config.getType(MASTER_KEY_KEY) == ConfigOptionType_None)
+		config.setString(MASTER_KEY_KEY, "");
 }
 
 void TOTPComponent::onInit(IComponentList* components)
@@ -200,6 +560,7 @@ void TOTPComponent::onFree(IComponent* component)
 	if (component == pawn_)
 	{
 		pawn_ = nullptr;
+		scriptCallbacks_.clear();
 		setAmxFunctions();
 		setAmxLookups();
 	}
@@ -212,30 +573,91 @@ void TOTPComponent::free()
 
 void TOTPComponent::reset()
 {
+	snapshot_.clear();
 	if (core_)
 	{
 		for (IPlayer* player : core_->getPlayers().entries())
-		{
-			if (ITOTPExtension* data = queryExtension<ITOTPExtension>(player))
-			{
-				data->reset();
-			}
-		}
+			snapshot_.reset(*player, restoreOnGmx_);
 	}
 }
 
-void TOTPComponent::onPlayerConnect(IPlayer& player)
+void TOTPComponent::onTick(Microseconds elapsed, TimePoint now)
 {
-	player.addExtension(new TOTPExtension(), true);
+	verifier_.onTick();
+
+	// Swapped out first, as a callback may queue another load.
+	deliveredLoads_.swap(loadResults_);
+	for (const LoadResult& result : deliveredLoads_)
+	{
+		IPlayer* player = core_->getPlayers().get(result.playerID);
+		TOTPExtension* data = player ? queryExtension<TOTPExtension>(player) : nullptr;
+		if (!data || data->getPendingLoad() != result.ticket)
+			continue;
+
+		data->setPendingLoad(0);
+		notifyLoaded(*player, result.success);
+	}
+	deliveredLoads_.clear();
+
+	std::string storageError;
+	if (accountStore_.takeError(storageError))
+		core_->logLn(LogLevel::Error, "[TOTP] Account store: %s", storageError.c_str());
+	if (accountDatabase_.takeError(storageError))
+		core_->logLn(LogLevel::Error, "[TOTP] Account database: %s", storageError.c_str());
+
+	accountDatabase_.drain([this](TOTPSQLite::LoadJob& job)
+	{
+		IPlayer* player = core_->getPlayers().get(job.playerID);
+		TOTPExtension* data = player ? queryExtension<TOTPExtension>(player) : nullptr;
+
+		// The player left, or asked for another load since.
+		if (!data || data->getPendingLoad() != job.ticket)
+			return;
+
+		data->setPendingLoad(0);
+
+		bool loaded = false;
+		if (job.found)
+		{
+			char secret[TOTPUtils::MAX_SECRET_LENGTH];
+			size_t secretLength = TOTPEngine::resolveSecret(sealer_, job.entry.getSecret(), secret);
+			loaded = secretLength != 0 && applyAccount(*player, job.getAccount(), job.entry.params, std::string_view(secret, secretLength));
+			std::memset(secret, 0, sizeof(secret));
+		}
+
+		notifyLoaded(*player, loaded);
+	});
 }
 
 void TOTPComponent::onAmxLoad(IPawnScript& script)
 {
 	pawn_natives::AmxLoad(script.GetAMX());
+
+	// The first script after a restart is the new gamemode.
+	if (!snapshot_.empty())
+		snapshot_.restore();
+
+	auto findPublic = [&script](const char* name)
+	{
+		int index;
+		return script.FindPublic(name, &index) == AMX_ERR_NONE ? index : -1;
+	};
+
+	ScriptCallbacks callbacks;
+	callbacks.script = &script;
+	callbacks.onVerify = findPublic("OnPlayerTOTPVerify");
+	callbacks.onEnable = findPublic("OnPlayerTOTPEnable");
+	callbacks.onDisable = findPublic("OnPlayerTOTPDisable");
+	callbacks.onLoaded = findPublic("OnPlayerTOTPLoaded");
+
+	// Scripts without any of our callbacks are never visited.
+	if (callbacks.onVerify >= 0 || callbacks.onEnable >= 0 || callbacks.onDisable >= 0 || callbacks.onLoaded >= 0)
+		scriptCallbacks_.add(callbacks);
 }
 
 void TOTPComponent::onAmxUnload(IPawnScript& script)
 {
+	scriptCallbacks_.remove(&ScriptCallbacks::script, &script);
 }
 
 TOTPComponent* TOTPComponent::getInstance()
@@ -255,6 +677,7 @@ TOTPComponent::~TOTPComponent()
 	}
 	if (core_)
 	{
-		core_->getPlayers().getPlayerConnectDispatcher().removeEventHandler(this);
+		core_->getEventDispatcher().removeEventHandler(this);
 	}
+	verifier_.stop();
 }
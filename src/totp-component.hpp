@@ -10,15 +10,24 @@
 
 #include <sdk.hpp>
 #include "totp-interface.hpp"
+#include "totp-utils.hpp"
+#include "totp-verify.hpp"
+#include "totp-store.hpp"
+#include "totp-seal.hpp"
+#include "totp-sqlite.hpp"
+#include "totp-dispatch.hpp"
 #include <Server/Components/Pawn/pawn.hpp>
 #include <Impl/events_impl.hpp>
+#include <vector>
 
 using namespace Impl;
 
+class TOTPExtension;
+
 class TOTPComponent final
 	: public ITOTPComponent
-	, public PlayerConnectEventHandler
 	, public PawnEventHandler
+	, public CoreEventHandler
 {
 private:
 	ICore* core_ = nullptr;
@@ -26,22 +35,173 @@ private:
 	DefaultEventDispatcher<TOTPEventHandler> eventDispatcher_;
 	inline static TOTPComponent* instance_ = nullptr;
 
-	static constexpr int MAX_FAILED_ATTEMPTS = 3;
-	static constexpr int RATE_LIMIT_SECONDS = 60;
+	// Looks players up for verifier_ and passes its results to subscribers and scripts.
+	struct VerifyHost
+	{
+		TOTPComponent* component;
+
+		IPlayer* findPlayer(int id);
+		TOTPExtension* extensionOf(IPlayer& player);
+		int playerID(IPlayer& player);
+		bool addressOf(IPlayer& player, char (&address)[TOTPVerify::ADDRESS_LENGTH]);
+		std::string_view serialOf(IPlayer& player);
+		std::string_view nameOf(IPlayer& player);
+		void notifyVerify(IPlayer& player, bool success, std::string_view code);
+	};
+
+	// Limiters, the per-tick budget from totp.tick_budget_us and totp.tick_budget_hashes,
+	// deferred attempts, batches and the workers for verifyCodeAsync.
+	TOTPVerify::Verifier<VerifyHost, IPlayer> verifier_ { VerifyHost { this } };
+
+	// Public indices of our callbacks in one script, or -1 where it does not define them.
+	// Resolved when the script loads, so dispatching never looks a name up.
+	struct ScriptCallbacks
+	{
+		IPawnScript* script;
+		int onVerify;
+		int onEnable;
+		int onDisable;
+		int onLoaded;
+	};
+
+	TOTPDispatch::ScriptList<ScriptCallbacks> scriptCallbacks_;
+
+	// Call a callback in the side scripts that define it, then in the main script.
+	template <class... Args>
+	void callScripts(int ScriptCallbacks::*callback, Args... args)
+	{
+		if (!pawn_)
+			return;
+
+		scriptCallbacks_.call(&ScriptCallbacks::script, pawn_->mainScript(),
+			[callback](const ScriptCallbacks& callbacks)
+			{
+				return callbacks.*callback >= 0;
+			},
+			[callback, args...](const ScriptCallbacks& callbacks)
+			{
+				callbacks.script->CallChecked(callbacks.*callback, DefaultReturnValue_False, args...);
+			});
+	}
+
+	// Taken by reset() and put back when the next script loads.
+	TOTPVerify::GmxSnapshot<VerifyHost, IPlayer> snapshot_ { VerifyHost { this } };
+
+	// From totp.restore_on_gmx.
+	bool restoreOnGmx_ = true;
+
+	// Opened on first use from totp.account_store, so servers that do not use it get no file.
+	TOTPStore::AccountStore accountStore_;
+	std::string accountStorePath_;
+	bool accountStoreFailed_ = false;
+
+	// How often journaled changes are synced, from totp.journal_interval_ms.
+	std::chrono::milliseconds journalInterval_ { TOTPJournal::DEFAULT_COMMIT_INTERVAL };
+
+	// Seals secrets handed to scripts and the account store, keyed from totp.master_key.
+	TOTPSeal::Sealer sealer_;
+
+	// Scratch space for loadAccounts, kept to avoid allocating per call.
+	std::vector<TOTPStore::Entry> loadEntries_;
+	std::vector<TOTPSeal::OpenRequest> loadOpens_;
+
+	// Where accounts are kept, from totp.account_backend.
+	enum class AccountBackend
+	{
+		File,
+		SQLite
+	};
+
+	AccountBackend accountBackend_ = AccountBackend::File;
+
+	// Opened on first use from totp.account_database when the backend is sqlite.
+	TOTPSQLite::AccountDatabase accountDatabase_;
+	std::string accountDatabasePath_;
+	bool accountDatabaseFailed_ = false;
+
+	// Results of loadAccountAsync against the file store, delivered on the next tick so both
+	// backends report the same way.
+	struct LoadResult
+	{
+		uint64_t ticket;
+		int playerID;
+		bool success;
+	};
+
+	std::vector<LoadResult> loadResults_;
+	std::vector<LoadResult> deliveredLoads_;
+
+	// The account store, or null if it cannot be opened or the backend is not the file store.
+	TOTPStore::AccountStore* accountStore();
+
+	// The account database, or null if it cannot be opened or the backend is not sqlite.
+	TOTPSQLite::AccountDatabase* accountDatabase();
+
+	// Whether the configured backend can be used.
+	bool hasAccountBackend();
+
+	// Add, replace or remove an account in whichever backend is configured.
+	bool storeAccount(std::string_view account, const TOTPStore::Entry& entry);
+	bool removeAccount(std::string_view account);
+
+	// Enable TOTP for a player with an account's settings and plain secret, and bind them to it.
+	bool applyAccount(IPlayer& player, std::string_view account, const TOTPUtils::Params& params, std::string_view secret);
+
+	// Store the player's state under an account, or remove the account if TOTP is disabled.
+	bool writeAccount(std::string_view account, TOTPExtension& data);
+
+	// Deliver a finished loadAccountAsync to subscribers and scripts.
+	void notifyLoaded(IPlayer& player, bool success);
+
+	// Keep the account the player is bound to in step with a change to their state.
+	void saveBoundAccount(TOTPExtension& data);
+
+	// Players only get an extension once they first use TOTP.
+	TOTPExtension* attachExtension(IPlayer& player);
 
 public:
 	std::optional<std::string> generateSecret(IPlayer& player) override;
 
+	std::optional<std::string> generateSecret(IPlayer& player, size_t length) override;
+
+	std::optional<std::vector<std::string>> generateSecrets(size_t count, size_t length) override;
+
 	bool enableTOTP(IPlayer& player, const std::string& secret) override;
 
 	bool disableTOTP(IPlayer& player) override;
 
-	bool verifyCode(IPlayer& player, const std::string& code) override;
+	bool setSettings(IPlayer& player, const TOTPSettings& settings) override;
+
+	TOTPVerifyResult verifyCode(IPlayer& player, StringView code) override;
+
+	void verifyCodes(Span<TOTPVerifyRequest> requests) override;
+
+	bool isAddressThrottled(StringView address) override;
+
+	bool verifyCodeAsync(IPlayer& player, StringView code) override;
+
+	bool loadAccount(IPlayer& player, StringView account) override;
+
+	bool loadAccountAsync(IPlayer& player, StringView account) override;
+
+	void loadAccounts(Span<TOTPLoadRequest> requests) override;
+
+	bool saveAccount(IPlayer& player, StringView account) override;
+
+	bool deleteAccount(StringView account) override;
+
+	TOTPSeal::Sealer& sealer() { return sealer_; }
 
 	bool isEnabled(IPlayer& player) override;
 
 	bool isVerified(IPlayer& player) override;
 
+	bool isVerifyPending(IPlayer& player) override;
+
+	Span<const uint64_t> getEnabledMask() override;
+
+	Span<const uint64_t> getVerifiedMask() override;
+
 	IEventDispatcher<TOTPEventHandler>& getEventDispatcher() override;
 
 	StringView componentName() const override;
@@ -50,6 +210,8 @@ public:
 
 	void onLoad(ICore* c) override;
 
+	void provideConfiguration(ILogger& logger, IEarlyConfig& config, bool defaults) override;
+
 	void onInit(IComponentList* components) override;
 
 	void onReady() override;
@@ -60,7 +222,8 @@ public:
 
 	void reset() override;
 
-	void onPlayerConnect(IPlayer& player) override;
+	void onTick(Microseconds elapsed, TimePoint now) override;
+
 	void onAmxLoad(IPawnScript& script) override;
 
 	void onAmxUnload(IPawnScript& script) override;
@@ -0,0 +1,114 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-cpu.hpp"
+#include <cstdint>
+
+#if defined(TOTP_ARCH_X86)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#elif defined(TOTP_ARCH_ARM64)
+	#if defined(_WIN32)
+		#define WIN32_LEAN_AND_MEAN
+		#include <windows.h>
+	#elif defined(__linux__)
+		#include <sys/auxv.h>
+	#endif
+#endif
+
+namespace
+{
+#if defined(TOTP_ARCH_X86)
+	void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+	{
+#if defined(_MSC_VER)
+		int out[4];
+		__cpuidex(out, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (int i = 0; i < 4; i++)
+			regs[i] = static_cast<uint32_t>(out[i]);
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	uint64_t xgetbv()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+	}
+#endif
+
+	TOTPCpu::Features detect()
+	{
+		TOTPCpu::Features result;
+
+#if defined(TOTP_ARCH_X86)
+		uint32_t regs[4];
+		cpuid(0, 0, regs);
+		uint32_t maxLeaf = regs[0];
+		if (maxLeaf < 1)
+			return result;
+
+		cpuid(1, 0, regs);
+		result.sse2 = (regs[3] & (1u << 26)) != 0;
+		result.ssse3 = (regs[2] & (1u << 9)) != 0;
+		result.sse41 = (regs[2] & (1u << 19)) != 0;
+
+		bool osxsave = (regs[2] & (1u << 27)) != 0;
+		if (maxLeaf < 7)
+			return result;
+
+		cpuid(7, 0, regs);
+		result.sha = (regs[1] & (1u << 29)) != 0;
+
+		// The OS has to save the wider registers on context switch before we may use them.
+		if (!osxsave)
+			return result;
+
+		uint64_t xcr0 = xgetbv();
+		bool avxState = (xcr0 & 0x06) == 0x06;
+		bool avx512State = (xcr0 & 0xE6) == 0xE6;
+
+		result.avx2 = avxState && (regs[1] & (1u << 5)) != 0;
+		result.avx512f = avx512State && (regs[1] & (1u << 16)) != 0;
+#elif defined(TOTP_ARCH_ARM64)
+#if defined(_WIN32)
+		bool crypto = IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+		result.armSha1 = crypto;
+		result.armSha2 = crypto;
+#elif defined(__APPLE__)
+		result.armSha1 = true;
+		result.armSha2 = true;
+#elif defined(__linux__)
+		// HWCAP_SHA1 and HWCAP_SHA2 from <asm/hwcap.h>.
+		unsigned long hwcap = getauxval(AT_HWCAP);
+		result.armSha1 = (hwcap & (1ul << 5)) != 0;
+		result.armSha2 = (hwcap & (1ul << 6)) != 0;
+#endif
+#endif
+
+		return result;
+	}
+}
+
+namespace TOTPCpu
+{
+	const Features& features()
+	{
+		static const Features detected = detect();
+		return detected;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define TOTP_ARCH_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define TOTP_ARCH_ARM64 1
+#endif
+
+namespace TOTPCpu
+{
+	// Instruction set extensions that are both supported by the CPU and enabled by the OS.
+	struct Features
+	{
+		bool sse2 = false;
+		bool ssse3 = false;
+		bool sse41 = false;
+		bool avx2 = false;
+		bool avx512f = false;
+		bool sha = false;
+
+		bool armSha1 = false;
+		bool armSha2 = false;
+	};
+
+	// Detected once on first use.
+	const Features& features();
+}
@@ -0,0 +1,113 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Compiled with the ARMv8 crypto extensions enabled; only called after HWCAP detection.
+
+#include "totp-crypto-kernels.hpp"
+
+#if defined(TOTP_ARCH_ARM64)
+#include <arm_neon.h>
+
+namespace
+{
+	const uint32_t SHA1_K[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+	const uint32_t SHA256_K[64] = {
+		0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+		0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+		0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+		0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+		0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+		0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+		0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+		0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+	};
+
+	inline uint32x4_t loadMessage(const uint8_t* data)
+	{
+		return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data)));
+	}
+}
+
+namespace TOTPCrypto::Kernels
+{
+	void sha1BlocksARMv8(uint32_t state[5], const uint8_t* data, size_t count)
+	{
+		uint32x4_t abcd = vld1q_u32(state);
+		uint32_t e0 = state[4];
+
+		for (; count > 0; count--, data += 64)
+		{
+			uint32x4_t abcdSaved = abcd;
+			uint32_t eSaved = e0;
+
+			uint32x4_t w[4];
+			for (int i = 0; i < 4; i++)
+				w[i] = loadMessage(data + 16 * i);
+
+			// Twenty groups of four rounds; w[] holds the last sixteen schedule words.
+			for (int g = 0; g < 20; g++)
+			{
+				if (g >= 4)
+					w[g % 4] = vsha1su1q_u32(vsha1su0q_u32(w[g % 4], w[(g + 1) % 4], w[(g + 2) % 4]), w[(g + 3) % 4]);
+
+				uint32x4_t wk = vaddq_u32(w[g % 4], vdupq_n_u32(SHA1_K[g / 5]));
+				uint32_t e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+
+				if (g < 5)
+					abcd = vsha1cq_u32(abcd, e0, wk);
+				else if (g < 10 || g >= 15)
+					abcd = vsha1pq_u32(abcd, e0, wk);
+				else
+					abcd = vsha1mq_u32(abcd, e0, wk);
+
+				e0 = e1;
+			}
+
+			abcd = vaddq_u32(abcd, abcdSaved);
+			e0 += eSaved;
+		}
+
+		vst1q_u32(state, abcd);
+		state[4] = e0;
+	}
+
+	void sha256BlocksARMv8(uint32_t state[8], const uint8_t* data, size_t count)
+	{
+		uint32x4_t state0 = vld1q_u32(state);
+		uint32x4_t state1 = vld1q_u32(state + 4);
+
+		for (; count > 0; count--, data += 64)
+		{
+			uint32x4_t saved0 = state0;
+			uint32x4_t saved1 = state1;
+
+			uint32x4_t w[4];
+			for (int i = 0; i < 4; i++)
+				w[i] = loadMessage(data + 16 * i);
+
+			for (int g = 0; g < 16; g++)
+			{
+				if (g >= 4)
+					w[g % 4] = vsha256su1q_u32(vsha256su0q_u32(w[g % 4], w[(g + 1) % 4]), w[(g + 2) % 4], w[(g + 3) % 4]);
+
+				uint32x4_t wk = vaddq_u32(w[g % 4], vld1q_u32(SHA256_K + 4 * g));
+				uint32x4_t previous = state0;
+				state0 = vsha256hq_u32(state0, state1, wk);
+				state1 = vsha256h2q_u32(state1, previous, wk);
+			}
+
+			state0 = vaddq_u32(state0, saved0);
+			state1 = vaddq_u32(state1, saved1);
+		}
+
+		vst1q_u32(state, state0);
+		vst1q_u32(state + 4, state1);
+	}
+}
+#endif
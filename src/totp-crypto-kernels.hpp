@@ -0,0 +1,27 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Hardware block functions. Each lives in a translation unit built with the matching
+// instruction set flags and must only be called after TOTPCpu reports support.
+
+#include "totp-cpu.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace TOTPCrypto::Kernels
+{
+#if defined(TOTP_ARCH_X86)
+	void sha1BlocksSHANI(uint32_t state[5], const uint8_t* data, size_t count);
+	void sha256BlocksSHANI(uint32_t state[8], const uint8_t* data, size_t count);
+#elif defined(TOTP_ARCH_ARM64)
+	void sha1BlocksARMv8(uint32_t state[5], const uint8_t* data, size_t count);
+	void sha256BlocksARMv8(uint32_t state[8], const uint8_t* data, size_t count);
+#endif
+}
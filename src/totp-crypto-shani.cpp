@@ -0,0 +1,149 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Compiled with SHA and SSE4.1 enabled; only called after CPU detection.
+
+#include "totp-crypto-kernels.hpp"
+
+#if defined(TOTP_ARCH_X86)
+#include <immintrin.h>
+
+namespace
+{
+	alignas(16) const uint32_t SHA256_K[64] = {
+		0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+		0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+		0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+		0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+		0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+		0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+		0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+		0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+	};
+
+	struct SHA1Rounds
+	{
+		__m128i abcd;
+		__m128i e[2];
+		__m128i msg[4];
+
+		// Four rounds plus the message schedule work that overlaps with them.
+		template <int G>
+		void group()
+		{
+			__m128i& current = msg[G % 4];
+			if constexpr (G == 0)
+				e[0] = _mm_add_epi32(e[0], current);
+			else
+				e[G % 2] = _mm_sha1nexte_epu32(e[G % 2], current);
+
+			e[(G + 1) % 2] = abcd;
+			if constexpr (G >= 3 && G <= 18)
+				msg[(G + 1) % 4] = _mm_sha1msg2_epu32(msg[(G + 1) % 4], current);
+			abcd = _mm_sha1rnds4_epu32(abcd, e[G % 2], G / 5);
+			if constexpr (G >= 1 && G <= 16)
+				msg[(G + 3) % 4] = _mm_sha1msg1_epu32(msg[(G + 3) % 4], current);
+			if constexpr (G >= 2 && G <= 17)
+				msg[(G + 2) % 4] = _mm_xor_si128(msg[(G + 2) % 4], current);
+		}
+	};
+
+	struct SHA256Rounds
+	{
+		__m128i state0;
+		__m128i state1;
+		__m128i msg[4];
+
+		template <int G>
+		void group()
+		{
+			__m128i& current = msg[G % 4];
+			__m128i wk = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i*>(SHA256_K + 4 * G)));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+			if constexpr (G >= 3 && G <= 14)
+			{
+				__m128i& next = msg[(G + 1) % 4];
+				next = _mm_add_epi32(next, _mm_alignr_epi8(current, msg[(G + 3) % 4], 4));
+				next = _mm_sha256msg2_epu32(next, current);
+			}
+			wk = _mm_shuffle_epi32(wk, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+			if constexpr (G >= 1 && G <= 12)
+				msg[(G + 3) % 4] = _mm_sha256msg1_epu32(msg[(G + 3) % 4], current);
+		}
+	};
+}
+
+namespace TOTPCrypto::Kernels
+{
+	void sha1BlocksSHANI(uint32_t state[5], const uint8_t* data, size_t count)
+	{
+		const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+
+		SHA1Rounds r;
+		r.abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+		__m128i e = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+		for (; count > 0; count--, data += 64)
+		{
+			__m128i abcdSaved = r.abcd;
+			__m128i eSaved = e;
+
+			for (int i = 0; i < 4; i++)
+				r.msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), mask);
+
+			r.e[0] = e;
+			r.group<0>();  r.group<1>();  r.group<2>();  r.group<3>();  r.group<4>();
+			r.group<5>();  r.group<6>();  r.group<7>();  r.group<8>();  r.group<9>();
+			r.group<10>(); r.group<11>(); r.group<12>(); r.group<13>(); r.group<14>();
+			r.group<15>(); r.group<16>(); r.group<17>(); r.group<18>(); r.group<19>();
+
+			e = _mm_sha1nexte_epu32(r.e[0], eSaved);
+			r.abcd = _mm_add_epi32(r.abcd, abcdSaved);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(r.abcd, 0x1B));
+		state[4] = static_cast<uint32_t>(_mm_extract_epi32(e, 3));
+	}
+
+	void sha256BlocksSHANI(uint32_t state[8], const uint8_t* data, size_t count)
+	{
+		const __m128i mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+		// The SHA extensions keep the state as ABEF/CDGH.
+		__m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+		__m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+
+		SHA256Rounds r;
+		r.state0 = _mm_alignr_epi8(cdab, efgh, 8);
+		r.state1 = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+		for (; count > 0; count--, data += 64)
+		{
+			__m128i abefSaved = r.state0;
+			__m128i cdghSaved = r.state1;
+
+			for (int i = 0; i < 4; i++)
+				r.msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), mask);
+
+			r.group<0>();  r.group<1>();  r.group<2>();  r.group<3>();
+			r.group<4>();  r.group<5>();  r.group<6>();  r.group<7>();
+			r.group<8>();  r.group<9>();  r.group<10>(); r.group<11>();
+			r.group<12>(); r.group<13>(); r.group<14>(); r.group<15>();
+
+			r.state0 = _mm_add_epi32(r.state0, abefSaved);
+			r.state1 = _mm_add_epi32(r.state1, cdghSaved);
+		}
+
+		__m128i feba = _mm_shuffle_epi32(r.state0, 0x1B);
+		__m128i dchg = _mm_shuffle_epi32(r.state1, 0xB1);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+	}
+}
+#endif
@@ -0,0 +1,494 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-crypto.hpp"
+#include "totp-crypto-kernels.hpp"
+#include <algorithm>
+
+#if defined(TOTP_USE_OPENSSL)
+	// SHA1_Transform and friends are deprecated in OpenSSL 3 but remain the
+	// cheapest way to run OpenSSL's tuned block functions on our own state.
+	#define OPENSSL_SUPPRESS_DEPRECATED
+	#include <openssl/rand.h>
+	#include <openssl/sha.h>
+#elif defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include <bcrypt.h>
+#else
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#if defined(__linux__)
+		#include <sys/syscall.h>
+	#endif
+#endif
+
+namespace
+{
+	inline uint32_t rotl(uint32_t value, int bits)
+	{
+		return (value << bits) | (value >> (32 - bits));
+	}
+
+	inline uint32_t rotr(uint32_t value, int bits)
+	{
+		return (value >> bits) | (value << (32 - bits));
+	}
+
+	inline uint64_t rotr64(uint64_t value, int bits)
+	{
+		return (value >> bits) | (value << (64 - bits));
+	}
+
+	inline uint32_t loadBE32(const uint8_t* input)
+	{
+		return (static_cast<uint32_t>(input[0]) << 24)
+		     | (static_cast<uint32_t>(input[1]) << 16)
+		     | (static_cast<uint32_t>(input[2]) << 8)
+		     | static_cast<uint32_t>(input[3]);
+	}
+
+	inline uint64_t loadBE64(const uint8_t* input)
+	{
+		return (static_cast<uint64_t>(loadBE32(input)) << 32) | loadBE32(input + 4);
+	}
+
+	constexpr uint32_t SHA256_K[64] = {
+		0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+		0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+		0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+		0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+		0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+		0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+		0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+		0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+	};
+
+	constexpr uint64_t SHA512_K[80] = {
+		0x428A2F98D728AE22, 0x7137449123EF65CD, 0xB5C0FBCFEC4D3B2F, 0xE9B5DBA58189DBBC,
+		0x3956C25BF348B538, 0x59F111F1B605D019, 0x923F82A4AF194F9B, 0xAB1C5ED5DA6D8118,
+		0xD807AA98A3030242, 0x12835B0145706FBE, 0x243185BE4EE4B28C, 0x550C7DC3D5FFB4E2,
+		0x72BE5D74F27B896F, 0x80DEB1FE3B1696B1, 0x9BDC06A725C71235, 0xC19BF174CF692694,
+		0xE49B69C19EF14AD2, 0xEFBE4786384F25E3, 0x0FC19DC68B8CD5B5, 0x240CA1CC77AC9C65,
+		0x2DE92C6F592B0275, 0x4A7484AA6EA6E483, 0x5CB0A9DCBD41FBD4, 0x76F988DA831153B5,
+		0x983E5152EE66DFAB, 0xA831C66D2DB43210, 0xB00327C898FB213F, 0xBF597FC7BEEF0EE4,
+		0xC6E00BF33DA88FC2, 0xD5A79147930AA725, 0x06CA6351E003826F, 0x142929670A0E6E70,
+		0x27B70A8546D22FFC, 0x2E1B21385C26C926, 0x4D2C6DFC5AC42AED, 0x53380D139D95B3DF,
+		0x650A73548BAF63DE, 0x766A0ABB3C77B2A8, 0x81C2C92E47EDAEE6, 0x92722C851482353B,
+		0xA2BFE8A14CF10364, 0xA81A664BBC423001, 0xC24B8B70D0F89791, 0xC76C51A30654BE30,
+		0xD192E819D6EF5218, 0xD69906245565A910, 0xF40E35855771202A, 0x106AA07032BBD1B8,
+		0x19A4C116B8D2D0C8, 0x1E376C085141AB53, 0x2748774CDF8EEB99, 0x34B0BCB5E19B48A8,
+		0x391C0CB3C5C95A63, 0x4ED8AA4AE3418ACB, 0x5B9CCA4F7763E373, 0x682E6FF3D6B2B8A3,
+		0x748F82EE5DEFB2FC, 0x78A5636F43172F60, 0x84C87814A1F0AB72, 0x8CC702081A6439EC,
+		0x90BEFFFA23631E28, 0xA4506CEBDE82BDE9, 0xBEF9A3F7B2C67915, 0xC67178F2E372532B,
+		0xCA273ECEEA26619C, 0xD186B8C721C0C207, 0xEADA7DD6CDE0EB1E, 0xF57D4F7FEE6ED178,
+		0x06F067AA72176FBA, 0x0A637DC5A2C898A6, 0x113F9804BEF90DAE, 0x1B710B35131C471B,
+		0x28DB77F523047D84, 0x32CAAB7B40C72493, 0x3C9EBE0A15C9BEBC, 0x431D67C49C100D4C,
+		0x4CC5D4BECB3E42B6, 0x597F299CFC657E2A, 0x5FCB6FAB3AD6FAEC, 0x6C44198C4A475817,
+	};
+
+	void sha1BlocksPortable(uint32_t state[5], const uint8_t* data, size_t count)
+	{
+		for (; count > 0; count--, data += 64)
+		{
+			uint32_t w[80];
+			for (int t = 0; t < 16; t++)
+				w[t] = loadBE32(data + 4 * t);
+			for (int t = 16; t < 80; t++)
+				w[t] = rotl(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+
+			uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+			for (int t = 0; t < 80; t++)
+			{
+				uint32_t f, k;
+				if (t < 20)
+				{
+					f = d ^ (b & (c ^ d));
+					k = 0x5A827999;
+				}
+				else if (t < 40)
+				{
+					f = b ^ c ^ d;
+					k = 0x6ED9EBA1;
+				}
+				else if (t < 60)
+				{
+					f = (b & c) | (d & (b | c));
+					k = 0x8F1BBCDC;
+				}
+				else
+				{
+					f = b ^ c ^ d;
+					k = 0xCA62C1D6;
+				}
+
+				uint32_t temp = rotl(a, 5) + f + e + k + w[t];
+				e = d;
+				d = c;
+				c = rotl(b, 30);
+				b = a;
+				a = temp;
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+		}
+	}
+
+	void sha256BlocksPortable(uint32_t state[8], const uint8_t* data, size_t count)
+	{
+		for (; count > 0; count--, data += 64)
+		{
+			uint32_t w[64];
+			for (int t = 0; t < 16; t++)
+				w[t] = loadBE32(data + 4 * t);
+			for (int t = 16; t < 64; t++)
+			{
+				uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+				uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+				w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+			}
+
+			uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+			uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+			for (int t = 0; t < 64; t++)
+			{
+				uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+				uint32_t ch = g ^ (e & (f ^ g));
+				uint32_t temp1 = h + s1 + ch + SHA256_K[t] + w[t];
+				uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+				uint32_t maj = (a & b) | (c & (a | b));
+				uint32_t temp2 = s0 + maj;
+
+				h = g;
+				g = f;
+				f = e;
+				e = d + temp1;
+				d = c;
+				c = b;
+				b = a;
+				a = temp1 + temp2;
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+			state[5] += f;
+			state[6] += g;
+			state[7] += h;
+		}
+	}
+
+#if !defined(TOTP_USE_OPENSSL)
+	void sha512BlocksPortable(uint64_t state[8], const uint8_t* data, size_t count)
+	{
+		for (; count > 0; count--, data += 128)
+		{
+			uint64_t w[80];
+			for (int t = 0; t < 16; t++)
+				w[t] = loadBE64(data + 8 * t);
+			for (int t = 16; t < 80; t++)
+			{
+				uint64_t s0 = rotr64(w[t - 15], 1) ^ rotr64(w[t - 15], 8) ^ (w[t - 15] >> 7);
+				uint64_t s1 = rotr64(w[t - 2], 19) ^ rotr64(w[t - 2], 61) ^ (w[t - 2] >> 6);
+				w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+			}
+
+			uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+			uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+			for (int t = 0; t < 80; t++)
+			{
+				uint64_t s1 = rotr64(e, 14) ^ rotr64(e, 18) ^ rotr64(e, 41);
+				uint64_t ch = g ^ (e & (f ^ g));
+				uint64_t temp1 = h + s1 + ch + SHA512_K[t] + w[t];
+				uint64_t s0 = rotr64(a, 28) ^ rotr64(a, 34) ^ rotr64(a, 39);
+				uint64_t maj = (a & b) | (c & (a | b));
+				uint64_t temp2 = s0 + maj;
+
+				h = g;
+				g = f;
+				f = e;
+				e = d + temp1;
+				d = c;
+				c = b;
+				b = a;
+				a = temp1 + temp2;
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+			state[5] += f;
+			state[6] += g;
+			state[7] += h;
+		}
+	}
+#endif
+
+#if defined(TOTP_USE_OPENSSL)
+	void sha1BlocksOpenSSL(uint32_t state[5], const uint8_t* data, size_t count)
+	{
+		SHA_CTX ctx;
+		ctx.h0 = state[0];
+		ctx.h1 = state[1];
+		ctx.h2 = state[2];
+		ctx.h3 = state[3];
+		ctx.h4 = state[4];
+
+		for (; count > 0; count--, data += 64)
+			SHA1_Transform(&ctx, data);
+
+		state[0] = ctx.h0;
+		state[1] = ctx.h1;
+		state[2] = ctx.h2;
+		state[3] = ctx.h3;
+		state[4] = ctx.h4;
+	}
+
+	void sha256BlocksOpenSSL(uint32_t state[8], const uint8_t* data, size_t count)
+	{
+		SHA256_CTX ctx;
+		for (int i = 0; i < 8; i++)
+			ctx.h[i] = state[i];
+
+		for (; count > 0; count--, data += 64)
+			SHA256_Transform(&ctx, data);
+
+		for (int i = 0; i < 8; i++)
+			state[i] = ctx.h[i];
+	}
+
+	void sha512BlocksOpenSSL(uint64_t state[8], const uint8_t* data, size_t count)
+	{
+		SHA512_CTX ctx;
+		for (int i = 0; i < 8; i++)
+			ctx.h[i] = state[i];
+
+		for (; count > 0; count--, data += 128)
+			SHA512_Transform(&ctx, data);
+
+		for (int i = 0; i < 8; i++)
+			state[i] = ctx.h[i];
+	}
+#endif
+
+	using SHA1Blocks = void (*)(uint32_t*, const uint8_t*, size_t);
+	using SHA256Blocks = void (*)(uint32_t*, const uint8_t*, size_t);
+	using SHA512Blocks = void (*)(uint64_t*, const uint8_t*, size_t);
+
+	// Nothing we can detect beats OpenSSL's SHA-512 assembly, so it is not part of the CPU dispatch.
+#if defined(TOTP_USE_OPENSSL)
+	const SHA512Blocks sha512Blocks = sha512BlocksOpenSSL;
+#else
+	const SHA512Blocks sha512Blocks = sha512BlocksPortable;
+#endif
+
+	struct Backend
+	{
+		const char* name;
+		SHA1Blocks sha1;
+		SHA256Blocks sha256;
+	};
+
+	Backend select()
+	{
+		const TOTPCpu::Features& cpu = TOTPCpu::features();
+		(void)cpu;
+
+#if defined(TOTP_ARCH_X86)
+		if (cpu.sha && cpu.ssse3 && cpu.sse41)
+			return { "sha-ni", TOTPCrypto::Kernels::sha1BlocksSHANI, TOTPCrypto::Kernels::sha256BlocksSHANI };
+#elif defined(TOTP_ARCH_ARM64)
+		if (cpu.armSha1 && cpu.armSha2)
+			return { "armv8-crypto", TOTPCrypto::Kernels::sha1BlocksARMv8, TOTPCrypto::Kernels::sha256BlocksARMv8 };
+#endif
+
+#if defined(TOTP_USE_OPENSSL)
+		return { "openssl", sha1BlocksOpenSSL, sha256BlocksOpenSSL };
+#endif
+		return { "portable", sha1BlocksPortable, sha256BlocksPortable };
+	}
+
+	const Backend& backend()
+	{
+		static const Backend selected = select();
+		return selected;
+	}
+
+	constexpr size_t RANDOM_POOL_SIZE = 4096;
+
+	struct RandomPool
+	{
+		uint8_t bytes[RANDOM_POOL_SIZE];
+		size_t available = 0;
+
+		~RandomPool()
+		{
+			std::memset(bytes, 0, sizeof(bytes));
+		}
+	};
+
+	thread_local RandomPool randomPool;
+
+#if !defined(TOTP_USE_OPENSSL) && !defined(_WIN32)
+	bool readUrandom(uint8_t* output, size_t length)
+	{
+		int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return false;
+
+		while (length > 0)
+		{
+			ssize_t got = read(fd, output, length);
+			if (got < 0 && errno == EINTR)
+				continue;
+			if (got <= 0)
+			{
+				close(fd);
+				return false;
+			}
+
+			output += got;
+			length -= static_cast<size_t>(got);
+		}
+
+		close(fd);
+		return true;
+	}
+#endif
+}
+
+namespace TOTPCrypto
+{
+	void SHA1::init(Word state[STATE_WORDS])
+	{
+		state[0] = 0x67452301;
+		state[1] = 0xEFCDAB89;
+		state[2] = 0x98BADCFE;
+		state[3] = 0x10325476;
+		state[4] = 0xC3D2E1F0;
+	}
+
+	void SHA1::blocks(Word state[STATE_WORDS], const uint8_t* data, size_t count)
+	{
+		if (count > 0)
+			backend().sha1(state, data, count);
+	}
+
+	void SHA256::init(Word state[STATE_WORDS])
+	{
+		state[0] = 0x6A09E667;
+		state[1] = 0xBB67AE85;
+		state[2] = 0x3C6EF372;
+		state[3] = 0xA54FF53A;
+		state[4] = 0x510E527F;
+		state[5] = 0x9B05688C;
+		state[6] = 0x1F83D9AB;
+		state[7] = 0x5BE0CD19;
+	}
+
+	void SHA256::blocks(Word state[STATE_WORDS], const uint8_t* data, size_t count)
+	{
+		if (count > 0)
+			backend().sha256(state, data, count);
+	}
+
+	void SHA512::init(Word state[STATE_WORDS])
+	{
+		state[0] = 0x6A09E667F3BCC908;
+		state[1] = 0xBB67AE8584CAA73B;
+		state[2] = 0x3C6EF372FE94F82B;
+		state[3] = 0xA54FF53A5F1D36F1;
+		state[4] = 0x510E527FADE682D1;
+		state[5] = 0x9B05688C2B3E6C1F;
+		state[6] = 0x1F83D9ABFB41BD6B;
+		state[7] = 0x5BE0CD19137E2179;
+	}
+
+	void SHA512::blocks(Word state[STATE_WORDS], const uint8_t* data, size_t count)
+	{
+		if (count > 0)
+			sha512Blocks(state, data, count);
+	}
+
+	const char* backendName()
+	{
+		return backend().name;
+	}
+
+	bool randomBytes(uint8_t* output, size_t length)
+	{
+#if defined(TOTP_USE_OPENSSL)
+		return RAND_bytes(output, static_cast<int>(length)) == 1;
+#elif defined(_WIN32)
+		return BCryptGenRandom(nullptr, output, static_cast<ULONG>(length), BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#else
+#if defined(__linux__) && defined(SYS_getrandom)
+		// Called through syscall() so older glibc builds still link; falls back to /dev/urandom on old kernels.
+		while (length > 0)
+		{
+			long got = syscall(SYS_getrandom, output, length, 0);
+			if (got < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno == ENOSYS)
+					return readUrandom(output, length);
+				return false;
+			}
+
+			output += got;
+			length -= static_cast<size_t>(got);
+		}
+		return true;
+#else
+		return readUrandom(output, length);
+#endif
+#endif
+	}
+
+	bool pooledRandomBytes(uint8_t* output, size_t length)
+	{
+		if (length >= RANDOM_POOL_SIZE)
+			return randomBytes(output, length);
+
+		RandomPool& pool = randomPool;
+		while (length > 0)
+		{
+			if (pool.available == 0)
+			{
+				if (!randomBytes(pool.bytes, RANDOM_POOL_SIZE))
+					return false;
+				pool.available = RANDOM_POOL_SIZE;
+			}
+
+			size_t take = std::min(length, pool.available);
+			uint8_t* source = pool.bytes + RANDOM_POOL_SIZE - pool.available;
+			std::memcpy(output, source, take);
+			std::memset(source, 0, take);
+
+			pool.available -= take;
+			output += take;
+			length -= take;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Small crypto layer covering what TOTP needs: SHA-1/SHA-256/SHA-512, HMAC and a CSPRNG.
+// The SHA-1/SHA-256 block functions are picked once at load time from SHA-NI, the ARMv8
+// crypto extensions, OpenSSL (when built with it) or the portable code, in that order.
+// SHA-512 uses OpenSSL when available and the portable code otherwise.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace TOTPCrypto
+{
+	struct SHA1
+	{
+		using Word = uint32_t;
+		static constexpr size_t STATE_WORDS = 5;
+		static constexpr size_t BLOCK_SIZE = 64;
+		static constexpr size_t DIGEST_SIZE = 20;
+		static constexpr size_t LENGTH_SIZE = 8;
+
+		static void init(Word state[STATE_WORDS]);
+		static void blocks(Word state[STATE_WORDS], const uint8_t* data, size_t count);
+	};
+
+	struct SHA256
+	{
+		using Word = uint32_t;
+		static constexpr size_t STATE_WORDS = 8;
+		static constexpr size_t BLOCK_SIZE = 64;
+		static constexpr size_t DIGEST_SIZE = 32;
+		static constexpr size_t LENGTH_SIZE = 8;
+
+		static void init(Word state[STATE_WORDS]);
+		static void blocks(Word state[STATE_WORDS], const uint8_t* data, size_t count);
+	};
+
+	struct SHA512
+	{
+		using Word = uint64_t;
+		static constexpr size_t STATE_WORDS = 8;
+		static constexpr size_t BLOCK_SIZE = 128;
+		static constexpr size_t DIGEST_SIZE = 64;
+		static constexpr size_t LENGTH_SIZE = 16;
+
+		static void init(Word state[STATE_WORDS]);
+		static void blocks(Word state[STATE_WORDS], const uint8_t* data, size_t count);
+	};
+
+	// Chaining state of both HMAC passes with the key pads already absorbed.
+	template <class Hash>
+	struct HMACState
+	{
+		typename Hash::Word inner[Hash::STATE_WORDS];
+		typename Hash::Word outer[Hash::STATE_WORDS];
+	};
+
+	// Name of the SHA kernel selected for this CPU, for the load banner.
+	const char* backendName();
+
+	// Fill the buffer from the system CSPRNG (or OpenSSL's DRBG when built with it).
+	bool randomBytes(uint8_t* output, size_t length);
+
+	// Same source, served from a per-thread buffer that is refilled 4 KiB at a time so small
+	// requests do not each pay for a syscall. Bytes are wiped from the buffer once handed out.
+	bool pooledRandomBytes(uint8_t* output, size_t length);
+
+	namespace Detail
+	{
+		template <class Word>
+		inline void storeBE(uint8_t* output, Word value)
+		{
+			for (size_t i = 0; i < sizeof(Word); i++)
+				output[i] = static_cast<uint8_t>(value >> (8 * (sizeof(Word) - 1 - i)));
+		}
+
+		// Hash the final, partial block of a message of totalLength bytes.
+		template <class Hash>
+		inline void finish(typename Hash::Word state[Hash::STATE_WORDS], const uint8_t* tail, size_t tailLength, uint64_t totalLength)
+		{
+			uint8_t block[Hash::BLOCK_SIZE * 2] = {};
+			std::memcpy(block, tail, tailLength);
+			block[tailLength] = 0x80;
+
+			size_t blocks = tailLength + 1 + Hash::LENGTH_SIZE <= Hash::BLOCK_SIZE ? 1 : 2;
+			storeBE<uint64_t>(block + blocks * Hash::BLOCK_SIZE - 8, totalLength * 8);
+			Hash::blocks(state, block, blocks);
+		}
+
+		template <class Hash>
+		inline void output(const typename Hash::Word state[Hash::STATE_WORDS], uint8_t* digest)
+		{
+			constexpr size_t WORD_SIZE = sizeof(typename Hash::Word);
+			for (size_t i = 0; i * WORD_SIZE < Hash::DIGEST_SIZE; i++)
+				storeBE(digest + i * WORD_SIZE, state[i]);
+		}
+	}
+
+	// One-shot hash of an arbitrary message.
+	template <class Hash>
+	inline void digest(const uint8_t* data, size_t length, uint8_t* output)
+	{
+		typename Hash::Word state[Hash::STATE_WORDS];
+		Hash::init(state);
+
+		size_t whole = length / Hash::BLOCK_SIZE;
+		Hash::blocks(state, data, whole);
+		Detail::finish<Hash>(state, data + whole * Hash::BLOCK_SIZE, length - whole * Hash::BLOCK_SIZE, length);
+		Detail::output<Hash>(state, output);
+	}
+
+	// Absorb the ipad/opad of a key. Keys longer than a block are hashed first, as RFC 2104 requires.
+	template <class Hash>
+	inline void hmacInit(HMACState<Hash>& hmac, const uint8_t* key, size_t length)
+	{
+		uint8_t pad[Hash::BLOCK_SIZE] = {};
+		if (length > Hash::BLOCK_SIZE)
+			digest<Hash>(key, length, pad);
+		else
+			std::memcpy(pad, key, length);
+
+		for (uint8_t& byte : pad)
+			byte ^= 0x36;
+		Hash::init(hmac.inner);
+		Hash::blocks(hmac.inner, pad, 1);
+
+		for (uint8_t& byte : pad)
+			byte ^= 0x36 ^ 0x5C;
+		Hash::init(hmac.outer);
+		Hash::blocks(hmac.outer, pad, 1);
+
+		std::memset(pad, 0, sizeof(pad));
+	}
+
+	// HMAC of a short message (one that fits in a single padded block, like a TOTP counter).
+	// Costs exactly one compression per pass.
+	template <class Hash>
+	inline void hmacShort(const HMACState<Hash>& hmac, const uint8_t* message, size_t length, uint8_t* output)
+	{
+		static_assert(Hash::DIGEST_SIZE + 1 + Hash::LENGTH_SIZE <= Hash::BLOCK_SIZE, "digest must fit in one block");
+
+		typename Hash::Word state[Hash::STATE_WORDS];
+		uint8_t inner[Hash::DIGEST_SIZE];
+
+		std::memcpy(state, hmac.inner, sizeof(state));
+		Detail::finish<Hash>(state, message, length, Hash::BLOCK_SIZE + length);
+		Detail::output<Hash>(state, inner);
+
+		std::memcpy(state, hmac.outer, sizeof(state));
+		Detail::finish<Hash>(state, inner, sizeof(inner), Hash::BLOCK_SIZE + sizeof(inner));
+		Detail::output<Hash>(state, output);
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace TOTPDispatch
+{
+	// Loaded scripts in load order, each entry numbered when it is added. Script is what
+	// Entry::*key points at and identifies a script while it is loaded.
+	template <class Entry>
+	class ScriptList
+	{
+	public:
+		void add(const Entry& entry)
+		{
+			entries_.push_back({ entry, ++generation_ });
+		}
+
+		template <class Script>
+		void remove(Script* Entry::*key, const Script* script)
+		{
+			entries_.erase(
+				std::remove_if(entries_.begin(), entries_.end(), [key, script](const Loaded& loaded)
+				{
+					return loaded.entry.*key == script;
+				}),
+				entries_.end());
+		}
+
+		void clear() { entries_.clear(); }
+
+		bool empty() const { return entries_.empty(); }
+
+		// Call function(entry) for every script whose entry wants(entry), in load order, and the
+		// one for last (if any) after all others. A callback may load or unload scripts, so each
+		// entry is found again by its number before it is called, without copying the list: a script
+		// unloaded meanwhile is skipped without skipping the one after it, and one loaded
+		// meanwhile, even at the address of one that left, is not called for an event that
+		// happened before it was there. Callbacks may also dispatch again.
+		template <class Script, class Wants, class Function>
+		void call(Script* Entry::*key, const Script* last, Wants wants, Function function) const
+		{
+			const uint64_t end = generation_ + 1;
+			uint64_t after = 0;
+
+			while (const Loaded* loaded = next(after, end))
+			{
+				after = loaded->generation;
+				if (loaded->entry.*key == last || !wants(loaded->entry))
+					continue;
+
+				// The list may be reallocated by the call.
+				const Entry entry = loaded->entry;
+				function(entry);
+			}
+
+			if (!last)
+				return;
+
+			for (after = 0; const Loaded* loaded = next(after, end); after = loaded->generation)
+			{
+				if (loaded->entry.*key == last)
+				{
+					if (wants(loaded->entry))
+					{
+						const Entry entry = loaded->entry;
+						function(entry);
+					}
+					break;
+				}
+			}
+		}
+
+	private:
+		struct Loaded
+		{
+			Entry entry;
+			uint64_t generation;
+		};
+
+		std::vector<Loaded> entries_;
+		uint64_t generation_ = 0;
+
+		// The first entry numbered after after and before end. Numbers rise through the list.
+		const Loaded* next(uint64_t after, uint64_t end) const
+		{
+			auto found = std::upper_bound(entries_.begin(), entries_.end(), after, [](uint64_t generation, const Loaded& loaded)
+			{
+				return generation < loaded.generation;
+			});
+			return found != entries_.end() && found->generation < end ? &*found : nullptr;
+		}
+	};
+}
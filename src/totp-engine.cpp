@@ -0,0 +1,53 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-engine.hpp"
+#include "totp-base32.hpp"
+#include <cstring>
+
+namespace TOTPEngine
+{
+	bool isValidSecret(std::string_view secret)
+	{
+		return secret.length() >= TOTPUtils::MIN_SECRET_LENGTH
+			&& secret.length() <= TOTPUtils::MAX_SECRET_LENGTH
+			&& TOTPBase32::isValid(secret);
+	}
+
+	uint64_t currentTimestamp()
+	{
+		auto nowSystem = std::chrono::system_clock::now();
+		return std::chrono::duration_cast<std::chrono::seconds>(
+			nowSystem.time_since_epoch()
+		).count();
+	}
+
+	size_t resolveSecret(TOTPSeal::Sealer& sealer, std::string_view input, char (&secret)[TOTPUtils::MAX_SECRET_LENGTH])
+	{
+		if (TOTPSeal::isSealed(input))
+			return sealer.open(input, secret, sizeof(secret));
+
+		if (input.length() > sizeof(secret))
+			return 0;
+
+		std::memcpy(secret, input.data(), input.length());
+		return input.length();
+	}
+
+	size_t exportSecret(TOTPSeal::Sealer& sealer, std::string_view secret, char* output, size_t size)
+	{
+		if (sealer.isEnabled())
+			return sealer.seal(secret, output, size);
+
+		if (secret.length() > size)
+			return 0;
+
+		std::memcpy(output, secret.data(), secret.length());
+		return secret.length();
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// The rules both front-ends share: what a valid secret is, when an attempt may go ahead, how it
+// is checked and what a result changes. The open.mp component keeps player state in
+// TOTPExtension and the SA-MP plugin in PlayerDataManager; each passes it in through a type with
+// the accessors used below, so there is one verify path for both.
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include "totp-utils.hpp"
+#include "totp-async.hpp"
+#include "totp-seal.hpp"
+
+namespace TOTPEngine
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int MAX_FAILED_ATTEMPTS = 3;
+	constexpr int RATE_LIMIT_SECONDS = 60;
+
+	// Length and alphabet check for a secret about to be enabled.
+	bool isValidSecret(std::string_view secret);
+
+	// Current Unix time in seconds.
+	uint64_t currentTimestamp();
+
+	// The base32 secret behind input, which is either the secret itself or its sealed form.
+	// Returns the length written to secret, or 0 if input is too long or does not open.
+	size_t resolveSecret(TOTPSeal::Sealer& sealer, std::string_view input, char (&secret)[TOTPUtils::MAX_SECRET_LENGTH]);
+
+	// The form a secret is handed out in: sealed if a master key is set, as is otherwise.
+	// Returns the length written to output, or 0 if it does not fit.
+	size_t exportSecret(TOTPSeal::Sealer& sealer, std::string_view secret, char* output, size_t size);
+
+	template <class State>
+	void enable(State& state, std::string_view secret)
+	{
+		state.setSecret(secret);
+		state.setEnabled(true);
+		state.setVerified(false);
+		state.resetFailedAttempts();
+	}
+
+	template <class State>
+	void disable(State& state)
+	{
+		state.setEnabled(false);
+		state.setVerified(false);
+		state.setSecret(std::string_view());
+	}
+
+	// Whether an attempt may be checked. Records it for rate limiting if so.
+	template <class State>
+	bool beginVerify(State& state, std::string_view code, Clock::time_point now)
+	{
+		if (!state.isEnabled() || !state.hasSecret())
+			return false;
+
+		if (code.length() != static_cast<size_t>(state.getParams().digits))
+			return false;
+
+		// One attempt at a time, otherwise queued attempts could outrun the rate limit.
+		if (state.getPendingTicket() != 0)
+			return false;
+
+		if (state.getFailedAttempts() >= MAX_FAILED_ATTEMPTS)
+		{
+			auto timeSinceLastAttempt = std::chrono::duration_cast<std::chrono::seconds>(
+				now - state.getLastAttempt()
+			).count();
+
+			if (timeSinceLastAttempt < RATE_LIMIT_SECONDS)
+				return false;
+			else
+				state.resetFailedAttempts();
+		}
+
+		state.setLastAttempt(now);
+		return true;
+	}
+
+	template <class State>
+	bool verify(State& state, std::string_view code, uint64_t timestamp)
+	{
+		return TOTPUtils::verifyTOTP(state.getKey(), state.getCodeCache(), code, timestamp);
+	}
+
+	template <class State>
+	void finishVerify(State& state, bool success)
+	{
+		if (success)
+		{
+			state.setVerified(true);
+			state.resetFailedAttempts();
+		}
+		else
+		{
+			state.incrementFailedAttempts();
+		}
+	}
+
+	// Hand an attempt that passed beginVerify to a worker. The job gets copies, so the state can
+	// change while it runs; completeJob then notices and drops the result.
+	template <class State>
+	void submitJob(TOTPAsync::VerifyPool& pool, State& state, int playerID, uint64_t ticket, std::string_view code, uint64_t timestamp)
+	{
+		TOTPAsync::VerifyJob* job = pool.acquire();
+		job->ticket = ticket;
+		job->playerID = playerID;
+		job->key = state.getKey();
+		job->cache = state.getCodeCache();
+		std::memcpy(job->code, code.data(), code.length());
+		job->codeLength = code.length();
+		job->timestamp = timestamp;
+
+		state.setPendingTicket(ticket);
+		pool.submit(job);
+	}
+
+	// Apply a finished job. Returns false if the state moved on since it was submitted.
+	template <class State>
+	bool completeJob(State& state, const TOTPAsync::VerifyJob& job)
+	{
+		if (state.getPendingTicket() != job.ticket)
+			return false;
+
+		state.setPendingTicket(0);
+		state.getCodeCache() = job.cache;
+		finishVerify(state, job.success);
+		return true;
+	}
+}
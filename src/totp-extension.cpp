@@ -7,50 +7,217 @@
  */
 
 #include "totp-extension.hpp"
+#include <algorithm>
 #include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace
+{
+	TOTPUtils::Params toParams(const TOTPSettings& settings)
+	{
+		return { static_cast<TOTPUtils::Algorithm>(settings.algorithm), settings.digits, settings.period };
+	}
+
+	// Like the pool below, these outlive the component since players can be freed after it.
+	struct PlayerStates
+	{
+		PlayerMask enabled;
+		PlayerMask verified;
+
+		PlayerStates()
+		{
+			enabled.resize(PLAYER_POOL_SIZE);
+			verified.resize(PLAYER_POOL_SIZE);
+		}
+	};
+
+	PlayerStates& playerStates()
+	{
+		static PlayerStates states;
+		return states;
+	}
+}
+
+// Extensions are carved out of slabs and recycled through a free list, so players connecting
+// and leaving do not reach the allocator once the pool has grown to the server's peak. The
+// pool lives until the library is unloaded, as players can still be freed after the component.
+class TOTPExtensionPool
+{
+private:
+	static constexpr size_t SLAB_SIZE = 64;
+
+	union Slot
+	{
+		Slot* next;
+		alignas(TOTPExtension) unsigned char storage[sizeof(TOTPExtension)];
+	};
+
+	std::vector<std::unique_ptr<Slot[]>> slabs_;
+	Slot* free_ = nullptr;
+
+public:
+	static TOTPExtensionPool& get()
+	{
+		static TOTPExtensionPool pool;
+		return pool;
+	}
+
+	TOTPExtension* acquire(int playerID)
+	{
+		if (!free_)
+		{
+			slabs_.emplace_back(new Slot[SLAB_SIZE]);
+			Slot* slab = slabs_.back().get();
+			for (size_t i = 0; i < SLAB_SIZE; i++)
+			{
+				slab[i].next = free_;
+				free_ = &slab[i];
+			}
+		}
+
+		Slot* slot = free_;
+		free_ = slot->next;
+		return new (slot->storage) TOTPExtension(playerID);
+	}
+
+	void release(TOTPExtension* extension)
+	{
+		extension->~TOTPExtension();
+		Slot* slot = reinterpret_cast<Slot*>(extension);
+		slot->next = free_;
+		free_ = slot;
+	}
+};
+
+TOTPExtension::~TOTPExtension()
+{
+	std::memset(secret_, 0, sizeof(secret_));
+	key_.clear();
+	setEnabled(false);
+}
+
+TOTPExtension* TOTPExtension::create(int playerID)
+{
+	return TOTPExtensionPool::get().acquire(playerID);
+}
+
+const PlayerMask& TOTPExtension::enabledPlayers()
+{
+	return playerStates().enabled;
+}
+
+const PlayerMask& TOTPExtension::verifiedPlayers()
+{
+	return playerStates().verified;
+}
 
 bool TOTPExtension::isEnabled() const
 {
-	return enabled_;
+	return playerStates().enabled.test(playerID_);
 }
 
 bool TOTPExtension::isVerified() const
 {
-	return verified_;
+	return playerStates().verified.test(playerID_);
 }
 
 void TOTPExtension::setEnabled(bool enabled)
 {
-	enabled_ = enabled;
+	PlayerStates& states = playerStates();
+	states.enabled.assign(playerID_, enabled);
 	if (!enabled)
-		verified_ = false;
+		states.verified.assign(playerID_, false);
 }
 
 void TOTPExtension::setVerified(bool verified)
 {
-	verified_ = verified;
+	playerStates().verified.assign(playerID_, verified);
 }
 
 bool TOTPExtension::hasSecret() const
 {
-	return !secret_.empty();
+	return secretLength_ != 0;
 }
 
 void TOTPExtension::setSecret(const char* secret)
 {
-	if (secret && std::strlen(secret) <= TOTP_SECRET_LENGTH)
+	setSecret(secret ? std::string_view(secret) : std::string_view());
+}
+
+void TOTPExtension::setSecret(std::string_view secret)
+{
+	size_t length = secret.length();
+	if (length != 0 && length <= TOTP_SECRET_LENGTH)
 	{
-		secret_ = secret;
+		if (length == secretLength_ && std::memcmp(secret_, secret.data(), length) == 0 && !key_.empty())
+			return;
+
+		// The source may be our own buffer.
+		std::memmove(secret_, secret.data(), length);
+		std::memset(secret_ + length, 0, sizeof(secret_) - length);
+		secretLength_ = length;
+		if (!TOTPUtils::prepareKey(std::string_view(secret_, secretLength_), toParams(settings_), key_))
+		{
+			std::memset(secret_, 0, sizeof(secret_));
+			secretLength_ = 0;
+		}
 	}
 	else
 	{
-		secret_.clear();
+		std::memset(secret_, 0, sizeof(secret_));
+		secretLength_ = 0;
+		key_.clear();
 	}
+	codes_.clear();
+	pendingTicket_ = 0;
 }
 
 const char* TOTPExtension::getSecret() const
 {
-	return secret_.c_str();
+	return secret_;
+}
+
+const TOTPUtils::TOTPKey& TOTPExtension::getKey() const
+{
+	return key_;
+}
+
+TOTPUtils::CodeCache& TOTPExtension::getCodeCache()
+{
+	return codes_;
+}
+
+uint64_t TOTPExtension::getPendingTicket() const
+{
+	return pendingTicket_;
+}
+
+void TOTPExtension::setPendingTicket(uint64_t ticket)
+{
+	pendingTicket_ = ticket;
+}
+
+uint64_t TOTPExtension::getPendingLoad() const
+{
+	return pendingLoad_;
+}
+
+void TOTPExtension::setPendingLoad(uint64_t ticket)
+{
+	pendingLoad_ = ticket;
+}
+
+std::string_view TOTPExtension::getAccount() const
+{
+	return std::string_view(account_, accountLength_);
+}
+
+void TOTPExtension::setAccount(std::string_view account)
+{
+	accountLength_ = std::min(account.length(), sizeof(account_));
+	std::memcpy(account_, account.data(), accountLength_);
 }
 
 int TOTPExtension::getFailedAttempts() const
@@ -68,6 +235,11 @@ void TOTPExtension::resetFailedAttempts()
 	failedAttempts_ = 0;
 }
 
+void TOTPExtension::setFailedAttempts(int attempts)
+{
+	failedAttempts_ = attempts;
+}
+
 TimePoint TOTPExtension::getLastAttempt() const
 {
 	return lastAttempt_;
@@ -78,14 +250,44 @@ void TOTPExtension::setLastAttempt(TimePoint time)
 	lastAttempt_ = time;
 }
 
+TOTPUtils::Params TOTPExtension::getParams() const
+{
+	return toParams(settings_);
+}
+
+TOTPSettings TOTPExtension::getSettings() const
+{
+	return settings_;
+}
+
+bool TOTPExtension::setSettings(const TOTPSettings& settings)
+{
+	TOTPUtils::Params params = toParams(settings);
+	if (!TOTPUtils::validParams(params))
+		return false;
+
+	settings_ = settings;
+	if (secretLength_ != 0 && !TOTPUtils::prepareKey(std::string_view(secret_, secretLength_), params, key_))
+	{
+		std::memset(secret_, 0, sizeof(secret_));
+		secretLength_ = 0;
+	}
+	codes_.clear();
+	pendingTicket_ = 0;
+
+	return true;
+}
+
 void TOTPExtension::freeExtension()
 {
-	delete this;
+	TOTPExtensionPool::get().release(this);
 }
 
 void TOTPExtension::reset()
 {
-	verified_ = false;
+	setVerified(false);
+	pendingTicket_ = 0;
+	pendingLoad_ = 0;
 	failedAttempts_ = 0;
 	lastAttempt_ = TimePoint::min();
 }
@@ -9,30 +9,59 @@
  */
 
 #include <sdk.hpp>
-#include <string>
 #include "totp-interface.hpp"
+#include "totp-utils.hpp"
+#include "totp-player-mask.hpp"
+#include "totp-store.hpp"
 
 using namespace Impl;
 
+class TOTPExtensionPool;
+
 class TOTPExtension final
 	: public ITOTPExtension
 {
 private:
-	bool enabled_;
-	bool verified_;
-	std::string secret_;
+	friend class TOTPExtensionPool;
+
+	// Enabled and verified flags live in the shared masks, under this ID.
+	int playerID_;
+	char secret_[TOTP_SECRET_LENGTH + 1];
+	size_t secretLength_;
+	TOTPSettings settings_;
+	TOTPUtils::TOTPKey key_;
+	TOTPUtils::CodeCache codes_;
+	char account_[TOTPStore::MAX_ACCOUNT_LENGTH];
+	size_t accountLength_;
+	uint64_t pendingTicket_;
+	uint64_t pendingLoad_;
 	int failedAttempts_;
 	TimePoint lastAttempt_;
 
-public:
-	TOTPExtension()
-		: enabled_(false)
-		, verified_(false)
+	// Extensions only come from the pool; see create().
+	explicit TOTPExtension(int playerID)
+		: playerID_(playerID)
+		, secret_()
+		, secretLength_(0)
+		, account_()
+		, accountLength_(0)
+		, pendingTicket_(0)
+		, pendingLoad_(0)
 		, failedAttempts_(0)
 		, lastAttempt_(TimePoint::min())
 	{
 	}
 
+	~TOTPExtension();
+
+public:
+	// Take an extension from the pool for a player. freeExtension hands it back.
+	static TOTPExtension* create(int playerID);
+
+	// Flags of every player with an extension, for bulk queries.
+	static const PlayerMask& enabledPlayers();
+	static const PlayerMask& verifiedPlayers();
+
 	bool isEnabled() const override;
 
 	bool isVerified() const override;
@@ -45,18 +74,51 @@ public:
 
 	void setSecret(const char* secret) override;
 
+	void setSecret(std::string_view secret);
+
 	const char* getSecret() const override;
 
+	// Decoded secret with its HMAC state, rebuilt whenever the secret changes.
+	const TOTPUtils::TOTPKey& getKey() const;
+
+	// Expected codes for the current window, cleared together with the key.
+	TOTPUtils::CodeCache& getCodeCache();
+
+	// Ticket of the asynchronous verification in flight, or 0. Cleared when the key changes
+	// so a result computed with the old key is dropped.
+	uint64_t getPendingTicket() const;
+
+	void setPendingTicket(uint64_t ticket);
+
+	// Ticket of the account load in flight, or 0.
+	uint64_t getPendingLoad() const;
+
+	void setPendingLoad(uint64_t ticket);
+
+	// Account the player was last loaded from or saved to in the account store. Later changes
+	// to their TOTP state are saved to it too.
+	std::string_view getAccount() const;
+
+	void setAccount(std::string_view account);
+
 	int getFailedAttempts() const override;
 
 	void incrementFailedAttempts() override;
 
 	void resetFailedAttempts() override;
 
+	void setFailedAttempts(int attempts);
+
 	TimePoint getLastAttempt() const override;
 
 	void setLastAttempt(TimePoint time) override;
 
+	TOTPSettings getSettings() const override;
+
+	TOTPUtils::Params getParams() const;
+
+	bool setSettings(const TOTPSettings& settings) override;
+
 	void freeExtension() override;
 
 	void reset() override;
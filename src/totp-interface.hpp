@@ -11,15 +11,44 @@
 #include <sdk.hpp>
 #include <string>
 #include <optional>
+#include <vector>
 
-// Maximum length for a base32 encoded secret (16 characters = 80 bits)
-constexpr size_t TOTP_SECRET_LENGTH = 16;
+// Maximum length for a base32 encoded secret (64 characters = 320 bits)
+constexpr size_t TOTP_SECRET_LENGTH = 64;
+
+// HMAC algorithm used to derive codes (RFC 6238 section 1.2).
+enum class TOTPAlgorithm : uint8_t
+{
+	SHA1 = 0,
+	SHA256 = 1,
+	SHA512 = 2,
+};
+
+// What ITOTPComponent::verifyCode did with a code.
+enum class TOTPVerifyResult : uint8_t
+{
+	Failed = 0,
+	Verified = 1,
+	// The tick's verification budget was used up; the result arrives through onTOTPVerify on a later tick.
+	Deferred = 2,
+};
+
+// Per-player code parameters. The defaults are what every authenticator app assumes;
+// digits may be 6 to 8 and the period 1 to 3600 seconds.
+struct TOTPSettings
+{
+	TOTPAlgorithm algorithm = TOTPAlgorithm::SHA1;
+	int digits = 6;
+	int period = 30;
+};
 
 // If this data is to be used in other components only share an ABI stable base class.
+// Attached the first time a player uses TOTP, so players who never did have none.
 struct ITOTPExtension : IExtension
 {
 	// Visit https://open.mp/uid to generate a new unique ID (different to the component UID).
-	PROVIDE_EXT_UID(0x213BD4923106B488);
+	// Generate a new one whenever the methods below change, so older callers fail to query it.
+	PROVIDE_EXT_UID(0x6D83B84CB1CDF6D7);
 
 	virtual bool isEnabled() const = 0;
 
@@ -44,38 +73,112 @@ struct ITOTPExtension : IExtension
 	virtual TimePoint getLastAttempt() const = 0;
 
 	virtual void setLastAttempt(TimePoint time) = 0;
+
+	virtual TOTPSettings getSettings() const = 0;
+
+	// Returns false and keeps the current settings if they are out of range.
+	virtual bool setSettings(const TOTPSettings& settings) = 0;
 };
 
 // If other components want to subscribe to our TOTP event they must implement this interface.
 struct TOTPEventHandler
 {
 	// Called when a player attempts to verify a TOTP code.
-	virtual void onTOTPVerify(IPlayer& player, bool success, const std::string& code) = 0;
+	virtual void onTOTPVerify(IPlayer& player, bool success, StringView code) = 0;
 
 	// Called when a player enables TOTP.
 	virtual void onTOTPEnabled(IPlayer& player) = 0;
 
 	// Called when a player disables TOTP.
 	virtual void onTOTPDisabled(IPlayer& player) = 0;
+
+	// Called when a load queued by loadAccountAsync finishes, on the main thread.
+	virtual void onTOTPLoaded(IPlayer& player, bool success) { }
+};
+
+// One entry of a batch verification passed to ITOTPComponent::verifyCodes.
+struct TOTPVerifyRequest
+{
+	IPlayer* player;
+	StringView code;
+	// Filled in by the component.
+	bool success;
+};
+
+// One entry of a batch load passed to ITOTPComponent::loadAccounts.
+struct TOTPLoadRequest
+{
+	IPlayer* player;
+	StringView account;
+	// Filled in by the component.
+	bool success;
 };
 
 // If this data is to be used in other components only share an ABI stable base class.
 struct ITOTPComponent : IComponent
 {
 	// Visit https://open.mp/uid to generate a new unique ID (different to the extension UID).
-	PROVIDE_UID(0x5572409DBD24A8BB);
+	// Generate a new one whenever the methods below change, so older callers fail to query it.
+	PROVIDE_UID(0x463BD9DC80C26C75);
 
 	// Generate a new random secret for a player.
 	virtual std::optional<std::string> generateSecret(IPlayer& player) = 0;
 
-	// Enable TOTP for a player with a given secret.
+	// Generate a random secret of a given length in base32 characters (up to TOTP_SECRET_LENGTH).
+	virtual std::optional<std::string> generateSecret(IPlayer& player, size_t length) = 0;
+
+	// Generate many secrets at once, e.g. when moving existing accounts to mandatory 2FA.
+	virtual std::optional<std::vector<std::string>> generateSecrets(size_t count, size_t length) = 0;
+
+	// Enable TOTP for a player with a given secret, either base32 or sealed under totp.master_key.
 	virtual bool enableTOTP(IPlayer& player, const std::string& secret) = 0;
 
 	// Disable TOTP for a player.
 	virtual bool disableTOTP(IPlayer& player) = 0;
 
-	// Verify a TOTP code for a player.
-	virtual bool verifyCode(IPlayer& player, const std::string& code) = 0;
+	// Change the algorithm, number of digits and period used for a player's codes.
+	virtual bool setSettings(IPlayer& player, const TOTPSettings& settings) = 0;
+
+	// Verify a TOTP code for a player. Deferred is returned instead of a result when the
+	// server's per-tick verification budget is used up.
+	virtual TOTPVerifyResult verifyCode(IPlayer& player, StringView code) = 0;
+
+	// Verify codes for many players at once, e.g. when a restart brings everyone back together.
+	// The HMAC work for all requests is done in a few multi-buffer passes; rate limiting,
+	// events and script callbacks behave exactly as with verifyCode.
+	virtual void verifyCodes(Span<TOTPVerifyRequest> requests) = 0;
+
+	// Queue a code to be checked on a worker thread. Returns false if the attempt is rejected
+	// up front (rate limited, wrong length, or another attempt still in flight). The result is
+	// delivered on a later tick through onTOTPVerify and OnPlayerTOTPVerify, on the main thread.
+	virtual bool verifyCodeAsync(IPlayer& player, StringView code) = 0;
+
+	// Check if failed attempts from an IP address have used up its allowance. Unlike the
+	// per-player counter, this is kept across reconnects and gamemode restarts.
+	virtual bool isAddressThrottled(StringView address) = 0;
+
+	// Enable TOTP for a player with the secret and settings stored for an account in the
+	// server's own account store. Returns false if the account has nothing stored. Always
+	// false with the SQLite backend, which is only read off the main thread; use loadAccountAsync.
+	virtual bool loadAccount(IPlayer& player, StringView account) = 0;
+
+	// Queue loadAccount, for stores that are not read on the main thread. The result is
+	// delivered on a later tick through onTOTPLoaded and OnPlayerTOTPLoaded. Returns false if
+	// the load could not be queued.
+	virtual bool loadAccountAsync(IPlayer& player, StringView account) = 0;
+
+	// loadAccount for many players at once, such as everyone still online after a restart.
+	// Accounts are looked up first and their sealed secrets opened together afterwards. Like
+	// loadAccount, this only reads the account store file.
+	virtual void loadAccounts(Span<TOTPLoadRequest> requests) = 0;
+
+	// Store a player's secret and settings under an account, or remove the account if the
+	// player does not have TOTP enabled.
+	virtual bool saveAccount(IPlayer& player, StringView account) = 0;
+
+	// Remove an account from the store. Returns false if it was not stored; with the SQLite
+	// backend, only if the removal could not be queued.
+	virtual bool deleteAccount(StringView account) = 0;
 
 	// Check if a player has TOTP enabled.
 	virtual bool isEnabled(IPlayer& player) = 0;
@@ -83,6 +186,16 @@ struct ITOTPComponent : IComponent
 	// Check if a player is verified (logged in with 2FA).
 	virtual bool isVerified(IPlayer& player) = 0;
 
+	// Check if a player has an attempt queued by verifyCode or verifyCodeAsync whose result
+	// has not been delivered yet.
+	virtual bool isVerifyPending(IPlayer& player) = 0;
+
+	// Enabled and verified flags of every player slot, for checking everyone at once: player N
+	// is bit N % 64 of word N / 64. Kept up to date by the component; read it on the main thread.
+	virtual Span<const uint64_t> getEnabledMask() = 0;
+
+	virtual Span<const uint64_t> getVerifiedMask() = 0;
+
 	// A way for other components to look up and subscribe to this component's events.
 	virtual IEventDispatcher<TOTPEventHandler>& getEventDispatcher() = 0;
 };
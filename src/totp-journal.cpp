@@ -0,0 +1,266 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-journal.hpp"
+#include <array>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Each record is its payload length, the CRC-32 of the payload, then the payload.
+	constexpr size_t FRAME_HEADER = 8;
+	constexpr size_t MAX_RECORD = 4096;
+
+	// Past this the writer checkpoints and starts the log over.
+	constexpr size_t COMPACT_BYTES = 1024 * 1024;
+
+	const std::array<uint32_t, 256>& crcTable()
+	{
+		static const std::array<uint32_t, 256> table = []
+		{
+			std::array<uint32_t, 256> result {};
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++)
+					crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+				result[i] = crc;
+			}
+			return result;
+		}();
+		return table;
+	}
+
+	uint32_t crc32(const unsigned char* data, size_t length)
+	{
+		const std::array<uint32_t, 256>& table = crcTable();
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < length; i++)
+			crc = (crc >> 8) ^ table[(crc ^ data[i]) & 0xFF];
+		return ~crc;
+	}
+
+	void putU32(unsigned char* out, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			out[i] = static_cast<unsigned char>(value >> (i * 8));
+	}
+
+	uint32_t getU32(const unsigned char* in)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++)
+			value |= static_cast<uint32_t>(in[i]) << (i * 8);
+		return value;
+	}
+
+	bool syncFile(std::FILE* file)
+	{
+		if (std::fflush(file) != 0)
+			return false;
+#ifdef _WIN32
+		return _commit(_fileno(file)) == 0;
+#else
+		return fsync(fileno(file)) == 0;
+#endif
+	}
+}
+
+namespace TOTPJournal
+{
+	Journal::~Journal()
+	{
+		close();
+	}
+
+	size_t Journal::replay(const std::string& path, const Replay& replay)
+	{
+		std::FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file)
+			return 0;
+
+		size_t count = 0;
+		unsigned char header[FRAME_HEADER];
+		std::vector<unsigned char> payload;
+		while (std::fread(header, 1, FRAME_HEADER, file) == FRAME_HEADER)
+		{
+			uint32_t length = getU32(header);
+			if (length == 0 || length > MAX_RECORD)
+				break;
+
+			payload.resize(length);
+			if (std::fread(payload.data(), 1, length, file) != length)
+				break;
+
+			if (crc32(payload.data(), length) != getU32(header + 4))
+				break;
+
+			replay(payload.data(), length);
+			count++;
+		}
+
+		std::memset(payload.data(), 0, payload.size());
+		std::fclose(file);
+		return count;
+	}
+
+	bool Journal::open(const std::string& path, std::chrono::milliseconds interval, Checkpoint checkpoint)
+	{
+		close();
+
+		file_ = std::fopen(path.c_str(), "wb");
+		if (!file_)
+			return false;
+		syncFile(file_);
+
+		path_ = path;
+		fileBytes_ = 0;
+		interval_ = interval;
+		checkpoint_ = std::move(checkpoint);
+		stopping_ = false;
+		writer_ = std::thread(&Journal::run, this);
+		return true;
+	}
+
+	void Journal::close()
+	{
+		if (writer_.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			wake_.notify_one();
+			writer_.join();
+		}
+
+		if (file_)
+		{
+			std::fclose(file_);
+			file_ = nullptr;
+		}
+		checkpoint_ = nullptr;
+	}
+
+	bool Journal::takeError(std::string& message)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (error_.empty())
+			return false;
+
+		message.swap(error_);
+		error_.clear();
+		return true;
+	}
+
+	void Journal::reportError(const char* what)
+	{
+		char message[512];
+		std::snprintf(message, sizeof(message), "%s %s; changes are checkpointed every commit until it can be written again", what, path_.c_str());
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		error_ = message;
+	}
+
+	void Journal::append(const unsigned char* data, size_t length)
+	{
+		if (length == 0 || length > MAX_RECORD)
+			return;
+
+		unsigned char header[FRAME_HEADER];
+		putU32(header, static_cast<uint32_t>(length));
+		putU32(header + 4, crc32(data, length));
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_.insert(pending_.end(), header, header + FRAME_HEADER);
+		pending_.insert(pending_.end(), data, data + length);
+	}
+
+	void Journal::run()
+	{
+		std::vector<unsigned char> buffer;
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!stopping_)
+		{
+			wake_.wait_for(lock, interval_, [this] { return stopping_; });
+
+			// Swap rather than copy, so the main thread waits for the lock at most this long.
+			buffer.swap(pending_);
+			lock.unlock();
+			commit(buffer);
+			if (fileBytes_ >= COMPACT_BYTES)
+				compact();
+			lock.lock();
+		}
+
+		buffer.swap(pending_);
+		lock.unlock();
+		commit(buffer);
+
+		// A clean shutdown leaves an empty log behind.
+		compact();
+	}
+
+	void Journal::commit(std::vector<unsigned char>& buffer)
+	{
+		if (buffer.empty())
+			return;
+
+		if (file_ && std::fwrite(buffer.data(), 1, buffer.size(), file_) == buffer.size() && syncFile(file_))
+		{
+			fileBytes_ += buffer.size();
+			writeFailed_ = false;
+		}
+		else
+		{
+			if (!writeFailed_)
+				reportError("Could not write the journal");
+			writeFailed_ = true;
+
+			// The records may be torn in the file or not there at all. They were applied before
+			// they were queued, so a checkpoint makes them durable all the same, and starting the
+			// log over drops the torn tail.
+			compact();
+		}
+
+		// Records carry secrets.
+		std::memset(buffer.data(), 0, buffer.size());
+		buffer.clear();
+	}
+
+	void Journal::compact()
+	{
+		// Everything in the file was applied before it was queued, so once the checkpoint has
+		// made the applied state durable the file is no longer needed. Records queued since are
+		// still in pending_ and land in the new file.
+		if (checkpoint_)
+			checkpoint_();
+
+		// freopen closes the old stream even when it fails, so there is nothing to keep.
+		std::FILE* file = file_ ? std::freopen(path_.c_str(), "wb", file_) : std::fopen(path_.c_str(), "wb");
+		if (!file)
+		{
+			// Until the file can be opened again, every commit checkpoints instead.
+			if (!writeFailed_)
+				reportError("Could not start the journal over at");
+			writeFailed_ = true;
+			file_ = nullptr;
+			return;
+		}
+
+		file_ = file;
+		syncFile(file_);
+		fileBytes_ = 0;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Append-only log of changes with a checksum per record. The main thread only copies records
+// into a buffer; a writer thread appends the buffer and syncs it once per commit interval, so
+// a crash loses at most one interval. Once the log grows past a threshold the writer asks the
+// owner to checkpoint (make everything applied so far durable elsewhere) and starts it over.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TOTPJournal
+{
+	constexpr std::chrono::milliseconds DEFAULT_COMMIT_INTERVAL { 100 };
+
+	class Journal
+	{
+	public:
+		using Checkpoint = std::function<void()>;
+		using Replay = std::function<void(const unsigned char* data, size_t length)>;
+
+		Journal() = default;
+		Journal(const Journal&) = delete;
+		Journal& operator=(const Journal&) = delete;
+		~Journal();
+
+		// Call replay for every intact record in the file, oldest first. A torn or corrupt
+		// record ends the log. Returns the number of records replayed.
+		static size_t replay(const std::string& path, const Replay& replay);
+
+		// Start a new, empty log at path and the writer thread. checkpoint runs on the writer.
+		bool open(const std::string& path, std::chrono::milliseconds interval, Checkpoint checkpoint);
+
+		// Write out what is buffered, checkpoint and stop the writer.
+		void close();
+
+		bool isOpen() const { return writer_.joinable(); }
+
+		// Queue a record. Never touches the file.
+		void append(const unsigned char* data, size_t length);
+
+		// The last write error since the previous call, if any. The writer keeps going without
+		// the file by checkpointing every commit, so nothing is lost, only slower to keep.
+		bool takeError(std::string& message);
+
+	private:
+		std::string path_;
+		std::FILE* file_ = nullptr;
+		size_t fileBytes_ = 0;
+		std::chrono::milliseconds interval_ { DEFAULT_COMMIT_INTERVAL };
+		Checkpoint checkpoint_;
+
+		std::thread writer_;
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		bool stopping_ = false;
+
+		// Framed records waiting for the writer. Guarded by mutex_.
+		std::vector<unsigned char> pending_;
+
+		// Guarded by mutex_.
+		std::string error_;
+
+		// Set from a failed write until one succeeds, so an outage is reported once. Writer
+		// thread only.
+		bool writeFailed_ = false;
+
+		void run();
+
+		// Append and sync everything queued so far. Writer thread only.
+		void commit(std::vector<unsigned char>& buffer);
+
+		// Checkpoint, then empty the file, or open it again if it was lost. Writer thread only.
+		void compact();
+
+		void reportError(const char* what);
+	};
+}
@@ -0,0 +1,206 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-limiter.hpp"
+#include "totp-crypto.hpp"
+#include <algorithm>
+
+namespace
+{
+	uint64_t mix(uint64_t x)
+	{
+		x ^= x >> 30;
+		x *= 0xBF58476D1CE4E5B9ull;
+		x ^= x >> 27;
+		x *= 0x94D049BB133111EBull;
+		x ^= x >> 31;
+		return x;
+	}
+}
+
+namespace TOTPLimiter
+{
+	Limiter::Limiter(Policy policy)
+		: policy_(policy)
+		, seed_(0)
+		, epoch_(Clock::now())
+	{
+		// A random seed keeps clients from picking addresses that collide on purpose.
+		uint8_t bytes[sizeof(seed_)];
+		if (TOTPCrypto::randomBytes(bytes, sizeof(bytes)))
+		{
+			for (uint8_t byte : bytes)
+				seed_ = (seed_ << 8) | byte;
+		}
+		clear();
+	}
+
+	void Limiter::clear()
+	{
+		for (Slot& slot : slots_)
+			slot = { 0, 0.0f, 0 };
+		for (auto& row : sketch_)
+			row.fill(0);
+		sketchDecayed_ = 0;
+	}
+
+	uint64_t Limiter::hash(std::string_view key) const
+	{
+		uint64_t h = seed_ ^ 0xCBF29CE484222325ull;
+		for (char c : key)
+			h = (h ^ static_cast<uint8_t>(c)) * 0x100000001B3ull;
+		h = mix(h);
+		return h != 0 ? h : 1;
+	}
+
+	uint32_t Limiter::seconds(Clock::time_point now) const
+	{
+		return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(now - epoch_).count());
+	}
+
+	float Limiter::refilled(const Slot& slot, uint32_t now) const
+	{
+		uint32_t elapsed = now > slot.updated ? now - slot.updated : 0;
+		float tokens = slot.tokens + static_cast<float>(elapsed) * policy_.refillPerSecond;
+		return std::min(tokens, policy_.burst);
+	}
+
+	Limiter::Slot* Limiter::find(uint64_t hash)
+	{
+		for (size_t i = 0; i < MAX_PROBE; i++)
+		{
+			Slot& slot = slots_[(hash + i) & (TABLE_SIZE - 1)];
+			if (slot.hash == hash)
+				return &slot;
+			if (slot.hash == 0)
+				return nullptr;
+		}
+		return nullptr;
+	}
+
+	Limiter::Slot& Limiter::insert(uint64_t hash, uint32_t now)
+	{
+		// Take the first empty slot, otherwise push out the key with the most failures left and
+		// hand whatever it still owes to the sketch. Slots are only ever overwritten, never
+		// emptied, so probe chains stay unbroken.
+		Slot* victim = nullptr;
+		float victimTokens = -1.0f;
+		for (size_t i = 0; i < MAX_PROBE; i++)
+		{
+			Slot& slot = slots_[(hash + i) & (TABLE_SIZE - 1)];
+			if (slot.hash == 0)
+			{
+				victim = &slot;
+				break;
+			}
+
+			float tokens = refilled(slot, now);
+			if (tokens > victimTokens)
+			{
+				victim = &slot;
+				victimTokens = tokens;
+			}
+		}
+
+		if (victim->hash != 0)
+		{
+			// One-off failures are not worth a place; repeat offenders are.
+			float owed = policy_.burst - victimTokens;
+			if (owed >= policy_.burst / 2.0f)
+				remember(victim->hash, static_cast<uint16_t>(owed));
+		}
+
+		// The sketch carries over failures the key collected before it was pushed out.
+		float remembered = static_cast<float>(estimate(hash));
+		*victim = { hash, std::max(policy_.burst - remembered, 0.0f), now };
+		return *victim;
+	}
+
+	uint16_t Limiter::estimate(uint64_t hash) const
+	{
+		uint16_t count = UINT16_MAX;
+		for (size_t row = 0; row < SKETCH_DEPTH; row++)
+		{
+			size_t column = (hash >> (16 * row)) & (SKETCH_WIDTH - 1);
+			count = std::min(count, sketch_[row][column]);
+		}
+		return count;
+	}
+
+	void Limiter::remember(uint64_t hash, uint16_t failures)
+	{
+		// Conservative update: only raise counters to the new estimate, which keeps keys that
+		// share a counter from inflating each other.
+		uint32_t target = std::min<uint32_t>(estimate(hash) + failures, UINT16_MAX);
+		for (size_t row = 0; row < SKETCH_DEPTH; row++)
+		{
+			uint16_t& count = sketch_[row][(hash >> (16 * row)) & (SKETCH_WIDTH - 1)];
+			count = std::max(count, static_cast<uint16_t>(target));
+		}
+	}
+
+	void Limiter::decaySketch(uint32_t now)
+	{
+		if (now < sketchDecayed_ + SKETCH_DECAY_SECONDS)
+			return;
+
+		// Sixteen halvings empty every counter.
+		uint32_t periods = (now - sketchDecayed_) / SKETCH_DECAY_SECONDS;
+		int shift = static_cast<int>(std::min<uint32_t>(periods, 16));
+		for (auto& row : sketch_)
+		{
+			for (uint16_t& count : row)
+				count = static_cast<uint16_t>(count >> shift);
+		}
+		sketchDecayed_ += periods * SKETCH_DECAY_SECONDS;
+	}
+
+	bool Limiter::throttled(std::string_view key, Clock::time_point now)
+	{
+		uint32_t time = seconds(now);
+		decaySketch(time);
+
+		// Keys outside the table get one attempt; their bucket then starts from the sketch. Judging
+		// them on the sketch alone would lock out everyone once a large flood fills it.
+		Slot* slot = find(hash(key));
+		return slot && refilled(*slot, time) < 1.0f;
+	}
+
+	void Limiter::recordFailure(std::string_view key, Clock::time_point now)
+	{
+		uint32_t time = seconds(now);
+		decaySketch(time);
+
+		uint64_t h = hash(key);
+		Slot* slot = find(h);
+		if (!slot)
+			slot = &insert(h, time);
+
+		slot->tokens = std::max(refilled(*slot, time) - 1.0f, 0.0f);
+		slot->updated = time;
+	}
+
+	bool ConnectionLimiter::throttled(std::string_view address, std::string_view serial, Clock::time_point now)
+	{
+		return (!address.empty() && address_.throttled(address, now))
+			|| (!serial.empty() && serial_.throttled(serial, now));
+	}
+
+	void ConnectionLimiter::recordFailure(std::string_view address, std::string_view serial, Clock::time_point now)
+	{
+		if (!address.empty())
+			address_.recordFailure(address, now);
+		if (!serial.empty())
+			serial_.recordFailure(serial, now);
+	}
+
+	bool ConnectionLimiter::addressThrottled(std::string_view address, Clock::time_point now)
+	{
+		return address_.throttled(address, now);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Failed-attempt limiter keyed by an arbitrary string (an IP address or a client serial).
+// Memory is fixed: a small open-addressing table holds a token bucket per recently seen key,
+// and a count-min sketch remembers what keys pushed out of the table still owed, so a flood
+// from more sources than the table holds cannot buy a repeat offender a fresh bucket.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+namespace TOTPLimiter
+{
+	struct Policy
+	{
+		// Failures allowed in a burst.
+		float burst;
+		// Failures forgiven per second.
+		float refillPerSecond;
+	};
+
+	// Failures allowed per address and per client serial, across reconnects. Addresses get more
+	// room since players can share one; both earn an attempt back every minute.
+	constexpr Policy ADDRESS_POLICY { 10.0f, 1.0f / 60.0f };
+	constexpr Policy SERIAL_POLICY { 5.0f, 1.0f / 60.0f };
+
+	class Limiter
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		explicit Limiter(Policy policy);
+
+		// True if the key has no failures left. Does not insert the key.
+		bool throttled(std::string_view key, Clock::time_point now);
+
+		void recordFailure(std::string_view key, Clock::time_point now);
+
+		void clear();
+
+	private:
+		static constexpr size_t TABLE_SIZE = 4096;
+		static constexpr size_t MAX_PROBE = 8;
+		static constexpr size_t SKETCH_DEPTH = 4;
+		static constexpr size_t SKETCH_WIDTH = 2048;
+		// Sketch counters are halved this often, so old floods are forgotten.
+		static constexpr uint32_t SKETCH_DECAY_SECONDS = 60;
+
+		struct Slot
+		{
+			// Keyed hash of the key; 0 marks an empty slot.
+			uint64_t hash;
+			float tokens;
+			// Seconds since epoch_ of the last refill.
+			uint32_t updated;
+		};
+
+		Policy policy_;
+		uint64_t seed_;
+		Clock::time_point epoch_;
+		uint32_t sketchDecayed_ = 0;
+		std::array<Slot, TABLE_SIZE> slots_;
+		std::array<std::array<uint16_t, SKETCH_WIDTH>, SKETCH_DEPTH> sketch_;
+
+		uint64_t hash(std::string_view key) const;
+		uint32_t seconds(Clock::time_point now) const;
+		float refilled(const Slot& slot, uint32_t now) const;
+		Slot* find(uint64_t hash);
+		Slot& insert(uint64_t hash, uint32_t now);
+		uint16_t estimate(uint64_t hash) const;
+		void remember(uint64_t hash, uint16_t failures);
+		void decaySketch(uint32_t now);
+	};
+
+	// What both front-ends check on top of a player's own counter, which reconnecting resets:
+	// failures per address and per client serial. An empty address or serial is not limited.
+	class ConnectionLimiter
+	{
+	public:
+		using Clock = Limiter::Clock;
+
+		bool throttled(std::string_view address, std::string_view serial, Clock::time_point now);
+
+		void recordFailure(std::string_view address, std::string_view serial, Clock::time_point now);
+
+		bool addressThrottled(std::string_view address, Clock::time_point now);
+
+	private:
+		Limiter address_ { ADDRESS_POLICY };
+		Limiter serial_ { SERIAL_POLICY };
+	};
+}
@@ -0,0 +1,623 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// neufox-2fa-loadtest: simulates a server full of players logging in, to size the verify path
+// for restart storms without a live server.
+//
+//   neufox-2fa-loadtest [--players N] [--ticks N] [--mode sync|batch|async] [--invalid PERCENT]
+//                       [--ramp TICKS] [--typing TICKS] [--tick-ms MS] [--pace] [--hash-budget N]
+//                       [--budget-us N] [--scripts N] [--gmx-every TICKS] [--players-per-address N]
+//                       [--seed N]
+//
+// Players connect (all at once unless --ramp spreads them out), are enabled with their secret,
+// type a code within --typing ticks (--typing 1 has everyone submit together), retry when it is
+// wrong, play for a while, then leave and come back. Every --gmx-every ticks the gamemode
+// restarts. Reported are the main-thread time per tick and verifications per second of it.
+//
+// Codes go through TOTPVerify::Verifier, the code behind TOTPComponent::verifyCode, verifyCodes,
+// verifyCodeAsync and the verify part of onTick, with a host standing in for the server: its
+// player pool is an array and its players carry a TOTPExtension, a name, an address and a serial.
+// The limiters, tick budget, deferral queue, batches and workers are the component's own, and a
+// gmx goes through the component's TOTPVerify::GmxSnapshot. Each result is dispatched to an event
+// subscriber and, through TOTPDispatch as the component does, to OnPlayerTOTPVerify in --scripts
+// scripts, whose bodies only count the call.
+//
+// The component itself is not loaded: ICore, IPlayer and the Pawn component are far larger than
+// what the verify path uses, so they are what the host replaces. Config parsing, the Pawn
+// natives, enabling and the account store are not exercised. Built only with -DBUILD_BENCHMARKS=ON.
+
+#include "totp-verify.hpp"
+#include "totp-dispatch.hpp"
+#include "totp-crypto.hpp"
+#include <Impl/events_impl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	enum class Mode
+	{
+		Sync,
+		Batch,
+		Async
+	};
+
+	struct Options
+	{
+		size_t players = PLAYER_POOL_SIZE;
+		uint32_t ticks = 4000;
+		Mode mode = Mode::Sync;
+		double invalidRate = 0.1;
+		uint32_t ramp = 0;
+		uint32_t typing = 1000;
+		int tickMs = 5;
+		bool pace = false;
+		int hashBudget = 0;
+		int budgetUs = 0;
+		size_t scripts = 2;
+		uint32_t gmxEvery = 0;
+		size_t playersPerAddress = 1;
+		uint32_t seed = 1;
+	};
+
+	enum class Phase
+	{
+		Offline,
+		// Connected and enabled, about to type a code.
+		Typing,
+		// A code is queued or with a worker.
+		Pending,
+		Playing
+	};
+
+	struct Player
+	{
+		int id;
+		Phase phase = Phase::Offline;
+		// Tick of the player's next action.
+		uint32_t wake = 0;
+		TOTPExtension* data = nullptr;
+		std::string secret;
+		std::string name;
+		std::string serial;
+		char address[16];
+	};
+
+	struct Counters
+	{
+		uint64_t connects = 0;
+		uint64_t disconnects = 0;
+		uint64_t submitted = 0;
+		uint64_t checked = 0;
+		uint64_t verified = 0;
+		uint64_t failed = 0;
+		uint64_t rejected = 0;
+		uint64_t deferred = 0;
+		uint64_t dropped = 0;
+		size_t maxDeferred = 0;
+		uint64_t hashes = 0;
+		uint64_t gmx = 0;
+		double slowestGmx = 0;
+	};
+
+	class Simulation;
+
+	// The server as the verify path sees it: a pool of players with their extension, address
+	// and serial, and somewhere to deliver results.
+	struct LoadHost
+	{
+		Simulation* simulation;
+
+		Player* findPlayer(int id);
+		TOTPExtension* extensionOf(Player& player) { return player.data; }
+		int playerID(Player& player) { return player.id; }
+		bool addressOf(Player& player, char (&address)[TOTPVerify::ADDRESS_LENGTH]);
+		std::string_view serialOf(Player& player) { return player.serial; }
+		std::string_view nameOf(Player& player) { return player.name; }
+		void notifyVerify(Player& player, bool success, std::string_view code);
+	};
+
+	// A subscriber to verification events, as another component would be.
+	struct VerifyEventHandler
+	{
+		virtual void onVerify(int playerID, bool success) = 0;
+	};
+
+	struct CountingHandler final : public VerifyEventHandler
+	{
+		uint64_t calls = 0;
+
+		void onVerify(int playerID, bool success) override
+		{
+			(void)playerID;
+			(void)success;
+			calls++;
+		}
+	};
+
+	// A loaded script that defines OnPlayerTOTPVerify.
+	struct LoadScript
+	{
+		uint64_t calls = 0;
+	};
+
+	struct ScriptCallbacks
+	{
+		LoadScript* script;
+		int onVerify;
+	};
+
+	class Simulation
+	{
+	public:
+		explicit Simulation(const Options& options)
+			: options_(options)
+			, random_(options.seed)
+			, scripts_(std::max<size_t>(options.scripts, 1))
+		{
+			players_.resize(options.players);
+			for (size_t i = 0; i < players_.size(); i++)
+			{
+				Player& player = players_[i];
+				player.id = static_cast<int>(i);
+				player.secret = *TOTPUtils::generateSecret(TOTPUtils::RECOMMENDED_SECRET_LENGTH);
+				player.name = "Player_" + std::to_string(i);
+				player.serial = "SERIAL-" + std::to_string(i);
+				size_t address = i / std::max<size_t>(options.playersPerAddress, 1);
+				std::snprintf(player.address, sizeof(player.address), "10.%u.%u.%u",
+					static_cast<unsigned>((address >> 16) & 0xFF), static_cast<unsigned>((address >> 8) & 0xFF), static_cast<unsigned>(address & 0xFF));
+				player.wake = options.ramp ? between(0, options.ramp) : 0;
+			}
+
+			verifier_.setTickBudget(std::chrono::microseconds(options.budgetUs), options.hashBudget);
+			events_.addEventHandler(&handler_);
+
+			// The last one is the gamemode, which the component calls after the side scripts.
+			for (LoadScript& script : scripts_)
+				scriptCallbacks_.add({ &script, 0 });
+		}
+
+		~Simulation()
+		{
+			verifier_.stop();
+			for (Player& player : players_)
+			{
+				if (player.data)
+					player.data->freeExtension();
+			}
+		}
+
+		// Runs one tick and returns the main-thread time it took, in microseconds.
+		double tick(uint32_t now)
+		{
+			auto start = Clock::now();
+			now_ = now;
+
+			if (options_.gmxEvery && now && now % options_.gmxEvery == 0)
+				gmx();
+
+			verifier_.onTick();
+
+			for (Player& player : players_)
+			{
+				if (player.wake != now)
+					continue;
+
+				switch (player.phase)
+				{
+				case Phase::Offline:
+					connect(player);
+					break;
+				case Phase::Typing:
+					attempt(player);
+					break;
+				case Phase::Playing:
+					disconnect(player);
+					break;
+				case Phase::Pending:
+					break;
+				}
+			}
+
+			if (options_.mode == Mode::Batch)
+				runBatch();
+
+			counters_.hashes += static_cast<uint64_t>(verifier_.tickHashes());
+			counters_.maxDeferred = std::max(counters_.maxDeferred, verifier_.deferred());
+			return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		}
+
+		const Counters& counters() const { return counters_; }
+		size_t inFlight() const { return verifier_.inFlight(); }
+
+		// Calls the subscriber and the scripts received, which should match checks.
+		uint64_t eventCalls() const { return handler_.calls; }
+
+		uint64_t scriptCalls() const
+		{
+			uint64_t calls = 0;
+			for (const LoadScript& script : scripts_)
+				calls += script.calls;
+			return calls;
+		}
+
+		Player* findPlayer(int id)
+		{
+			return id >= 0 && static_cast<size_t>(id) < players_.size() ? &players_[id] : nullptr;
+		}
+
+		// What the component does with a checked attempt: the event, then the scripts.
+		void notifyVerify(Player& player, bool success)
+		{
+			events_.dispatch(&VerifyEventHandler::onVerify, player.id, success);
+
+			scriptCallbacks_.call(&ScriptCallbacks::script, &scripts_.back(),
+				[](const ScriptCallbacks& callbacks)
+				{
+					return callbacks.onVerify >= 0;
+				},
+				[](const ScriptCallbacks& callbacks)
+				{
+					callbacks.script->calls++;
+				});
+
+			record(player, success);
+		}
+
+	private:
+		// One entry of a batch, shaped like TOTPVerifyRequest.
+		struct BatchEntry
+		{
+			Player* player;
+			std::string code;
+			bool success;
+		};
+
+		Options options_;
+		std::mt19937 random_;
+		std::vector<Player> players_;
+		Counters counters_;
+		uint32_t now_ = 0;
+
+		TOTPVerify::Verifier<LoadHost, Player> verifier_ { LoadHost { this } };
+		TOTPVerify::GmxSnapshot<LoadHost, Player> snapshot_ { LoadHost { this } };
+		DefaultEventDispatcher<VerifyEventHandler> events_;
+		CountingHandler handler_;
+		std::vector<LoadScript> scripts_;
+		TOTPDispatch::ScriptList<ScriptCallbacks> scriptCallbacks_;
+
+		std::vector<BatchEntry> batch_;
+
+		uint32_t between(uint32_t low, uint32_t high)
+		{
+			return std::uniform_int_distribution<uint32_t>(low, high)(random_);
+		}
+
+		bool chance(double probability)
+		{
+			return std::uniform_real_distribution<double>(0.0, 1.0)(random_) < probability;
+		}
+
+		// Delays in ticks, assuming the default 5 ms tick: seconds to type a code, minutes of play.
+		uint32_t typingDelay() { return between(std::max(options_.typing / 5, 1u), std::max(options_.typing, 1u)); }
+		uint32_t sessionLength() { return between(2000, 40000); }
+		uint32_t reconnectDelay() { return between(100, 2000); }
+
+		void connect(Player& player)
+		{
+			counters_.connects++;
+			player.data = TOTPExtension::create(player.id);
+			TOTPEngine::enable(*player.data, player.secret);
+			player.phase = Phase::Typing;
+			player.wake = now_ + typingDelay();
+		}
+
+		void disconnect(Player& player)
+		{
+			counters_.disconnects++;
+			player.data->freeExtension();
+			player.data = nullptr;
+			player.phase = Phase::Offline;
+			player.wake = now_ + reconnectDelay();
+		}
+
+		void attempt(Player& player)
+		{
+			counters_.submitted++;
+			uint64_t timestamp = TOTPEngine::currentTimestamp();
+			std::string code = TOTPUtils::generateTOTP(player.data->getKey(), timestamp);
+			if (chance(options_.invalidRate))
+				code[0] = code[0] == '9' ? '0' : static_cast<char>(code[0] + 1);
+
+			// Left as it is by anything the verifier turns away without a result.
+			player.phase = Phase::Pending;
+
+			switch (options_.mode)
+			{
+			case Mode::Sync:
+			{
+				TOTPVerifyResult result = verifier_.verifyCode(player, code);
+				if (result == TOTPVerifyResult::Deferred)
+					counters_.deferred++;
+				else if (result == TOTPVerifyResult::Failed && player.phase == Phase::Pending)
+					reject(player);
+				break;
+			}
+
+			case Mode::Batch:
+				batch_.push_back({ &player, code, false });
+				break;
+
+			case Mode::Async:
+				if (!verifier_.verifyCodeAsync(player, code))
+					reject(player);
+				break;
+			}
+		}
+
+		// Rate limited: the player waits and tries again.
+		void reject(Player& player)
+		{
+			counters_.rejected++;
+			player.phase = Phase::Typing;
+			player.wake = now_ + typingDelay();
+		}
+
+		void runBatch()
+		{
+			if (batch_.empty())
+				return;
+
+			verifier_.verifyCodes(batch_.data(), batch_.size());
+
+			for (BatchEntry& entry : batch_)
+			{
+				if (entry.player->phase == Phase::Pending)
+					reject(*entry.player);
+			}
+			batch_.clear();
+		}
+
+		void record(Player& player, bool success)
+		{
+			counters_.checked++;
+			if (success)
+			{
+				counters_.verified++;
+				player.phase = Phase::Playing;
+				player.wake = now_ + sessionLength();
+				return;
+			}
+
+			counters_.failed++;
+			player.phase = Phase::Typing;
+			player.wake = now_ + typingDelay();
+		}
+
+		// The component's reset() and the restore when the next script loads, back to back as on
+		// a gmx, through the same GmxSnapshot. Queued and asynchronous attempts are left to be
+		// dropped by their tickets, as there.
+		void gmx()
+		{
+			auto start = Clock::now();
+			counters_.gmx++;
+
+			snapshot_.clear();
+			for (Player& player : players_)
+				snapshot_.reset(player, true);
+			snapshot_.restore();
+
+			for (Player& player : players_)
+			{
+				if (!player.data)
+					continue;
+
+				// Whatever was in flight is dropped; the new gamemode asks for a code again.
+				if (player.phase == Phase::Pending)
+				{
+					counters_.dropped++;
+					player.phase = Phase::Typing;
+					player.wake = now_ + typingDelay();
+				}
+			}
+
+			double elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+			counters_.slowestGmx = std::max(counters_.slowestGmx, elapsed);
+		}
+	};
+
+	Player* LoadHost::findPlayer(int id)
+	{
+		return simulation->findPlayer(id);
+	}
+
+	bool LoadHost::addressOf(Player& player, char (&address)[TOTPVerify::ADDRESS_LENGTH])
+	{
+		std::memcpy(address, player.address, sizeof(player.address));
+		return true;
+	}
+
+	void LoadHost::notifyVerify(Player& player, bool success, std::string_view code)
+	{
+		(void)code;
+		simulation->notifyVerify(player, success);
+	}
+
+	double percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+			return 0.0;
+		size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	const char* modeName(Mode mode)
+	{
+		switch (mode)
+		{
+		case Mode::Batch:
+			return "batch";
+		case Mode::Async:
+			return "async";
+		default:
+			return "sync";
+		}
+	}
+
+	bool parseMode(std::string_view text, Mode& mode)
+	{
+		if (text == "sync")
+			mode = Mode::Sync;
+		else if (text == "batch")
+			mode = Mode::Batch;
+		else if (text == "async")
+			mode = Mode::Async;
+		else
+			return false;
+		return true;
+	}
+
+	void usage()
+	{
+		std::fprintf(stderr,
+			"usage: neufox-2fa-loadtest [--players N] [--ticks N] [--mode sync|batch|async] [--invalid PERCENT]\n"
+			"                           [--ramp TICKS] [--typing TICKS] [--tick-ms MS] [--pace] [--hash-budget N]\n"
+			"                           [--budget-us N] [--scripts N] [--gmx-every TICKS] [--players-per-address N]\n"
+			"                           [--seed N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		const char* value = hasValue ? argv[i + 1] : "";
+		bool ok = true;
+
+		if (arg == "--pace")
+		{
+			options.pace = true;
+			continue;
+		}
+
+		if (!hasValue)
+			ok = false;
+		else if (arg == "--players")
+			options.players = std::strtoul(value, nullptr, 10);
+		else if (arg == "--ticks")
+			options.ticks = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		else if (arg == "--mode")
+			ok = parseMode(value, options.mode);
+		else if (arg == "--invalid")
+			options.invalidRate = std::atof(value) / 100.0;
+		else if (arg == "--ramp")
+			options.ramp = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		else if (arg == "--typing")
+			options.typing = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		else if (arg == "--tick-ms")
+			options.tickMs = std::atoi(value);
+		else if (arg == "--hash-budget")
+			options.hashBudget = std::max(std::atoi(value), 0);
+		else if (arg == "--budget-us")
+			options.budgetUs = std::max(std::atoi(value), 0);
+		else if (arg == "--scripts")
+			options.scripts = std::strtoul(value, nullptr, 10);
+		else if (arg == "--gmx-every")
+			options.gmxEvery = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		else if (arg == "--players-per-address")
+			options.playersPerAddress = std::strtoul(value, nullptr, 10);
+		else if (arg == "--seed")
+			options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			usage();
+			return 1;
+		}
+		i++;
+	}
+
+	if (options.players == 0 || options.players > PLAYER_POOL_SIZE || options.ticks == 0 || options.tickMs <= 0 || options.scripts == 0)
+	{
+		std::fprintf(stderr, "error: --players must be 1 to %d, --ticks, --tick-ms and --scripts positive\n", PLAYER_POOL_SIZE);
+		return 1;
+	}
+
+	std::printf("players %zu, ticks %u (%d ms), mode %s, invalid %.0f%%, ramp %u, typing %u, budget %d hashes %d us, scripts %zu, gmx every %u, crypto backend %s\n",
+		options.players, options.ticks, options.tickMs, modeName(options.mode), options.invalidRate * 100.0, options.ramp, options.typing,
+		options.hashBudget, options.budgetUs, options.scripts, options.gmxEvery, TOTPCrypto::backendName());
+
+	// Unpaced ticks take microseconds, so workers would only ever see the first few.
+	if (options.mode == Mode::Async && !options.pace)
+		std::printf("note: asynchronous results arrive on later ticks; add --pace for real tick timing\n");
+
+	Simulation simulation(options);
+	std::vector<double> tickTimes;
+	tickTimes.reserve(options.ticks);
+
+	auto tickLength = std::chrono::milliseconds(options.tickMs);
+	auto nextTick = Clock::now();
+	for (uint32_t now = 0; now < options.ticks; now++)
+	{
+		tickTimes.push_back(simulation.tick(now));
+
+		if (options.pace)
+		{
+			nextTick += tickLength;
+			std::this_thread::sleep_until(nextTick);
+		}
+	}
+
+	double total = 0;
+	size_t overrun = 0;
+	for (double time : tickTimes)
+	{
+		total += time;
+		if (time > options.tickMs * 1000.0)
+			overrun++;
+	}
+
+	std::vector<double> sorted = tickTimes;
+	std::sort(sorted.begin(), sorted.end());
+
+	const Counters& counters = simulation.counters();
+	std::printf("tick time (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  (first tick %.1f)\n",
+		percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99), percentile(sorted, 0.999), sorted.back(), tickTimes.front());
+	std::printf("ticks over %d ms: %zu of %zu\n", options.tickMs, overrun, tickTimes.size());
+	std::printf("attempts: %llu submitted, %llu checked (%llu verified, %llu failed), %llu rate limited, %llu deferred (queue peak %zu), %zu still pending\n",
+		static_cast<unsigned long long>(counters.submitted), static_cast<unsigned long long>(counters.checked),
+		static_cast<unsigned long long>(counters.verified), static_cast<unsigned long long>(counters.failed),
+		static_cast<unsigned long long>(counters.rejected), static_cast<unsigned long long>(counters.deferred),
+		counters.maxDeferred, simulation.inFlight());
+	std::printf("sessions: %llu connects, %llu disconnects, %llu gmx (slowest %.1f us, %llu attempts in flight dropped)\n",
+		static_cast<unsigned long long>(counters.connects), static_cast<unsigned long long>(counters.disconnects),
+		static_cast<unsigned long long>(counters.gmx), counters.slowestGmx, static_cast<unsigned long long>(counters.dropped));
+	std::printf("callbacks: %llu events, %llu script calls\n",
+		static_cast<unsigned long long>(simulation.eventCalls()), static_cast<unsigned long long>(simulation.scriptCalls()));
+	if (total > 0)
+	{
+		std::printf("throughput: %.0f checks/s, %.0f HMACs/s of main-thread time (%.1f ms total)\n",
+			static_cast<double>(counters.checked) * 1e6 / total, static_cast<double>(counters.hashes) * 1e6 / total, total / 1000.0);
+	}
+	return 0;
+}
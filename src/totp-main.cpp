@@ -8,7 +8,13 @@
 
 #include "totp-plugin.hpp"
 #include "totp-player-data.hpp"
+#include "totp-dispatch.hpp"
 #include "version.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 // ============================================================================
 // Global variables for SA-MP plugin mode
@@ -18,13 +24,90 @@ void* pAMXFunctions = nullptr;
 logprintf_t logprintf = nullptr;
 bool isPluginMode = false;
 
+namespace
+{
+	const char* const CALLBACK_NAMES[PLUGIN_CALLBACK_COUNT] = {
+		"OnPlayerTOTPVerify",
+		"OnPlayerTOTPEnable",
+		"OnPlayerTOTPDisable",
+		"OnPlayerTOTPLoaded",
+	};
+
+	// A loaded script with the public index of each callback, or -1 where it does not define it.
+	// Resolved once in AmxLoad, so calling a callback never looks a name up.
+	struct Script
+	{
+		AMX* amx;
+		int publics[PLUGIN_CALLBACK_COUNT];
+	};
+
+	// Loaded scripts, in load order.
+	TOTPDispatch::ScriptList<Script> scripts;
+
+	void callPublic(PluginCallback callback, const cell* args, size_t count)
+	{
+		scripts.call(&Script::amx, static_cast<const AMX*>(nullptr),
+			[callback](const Script& script)
+			{
+				return script.publics[callback] >= 0;
+			},
+			[callback, args, count](const Script& script)
+			{
+				// Arguments are pushed last to first.
+				for (size_t arg = count; arg-- > 0;)
+					amx_Push(script.amx, args[arg]);
+
+				cell result;
+				amx_Exec(script.amx, &result, script.publics[callback]);
+			});
+	}
+
+	// The plugin API does not expose server settings, so read them from server.cfg like the
+	// server does. Returns the first word after the key, or an empty string.
+	std::string readServerSetting(const std::string& name)
+	{
+		std::ifstream config("server.cfg");
+		std::string line;
+		while (std::getline(config, line))
+		{
+			std::istringstream words(line);
+			std::string key;
+			std::string value;
+			if (words >> key && key == name && words >> value)
+				return value;
+		}
+		return std::string();
+	}
+
+	size_t readMaxPlayers()
+	{
+		std::istringstream setting(readServerSetting("maxplayers"));
+		int value;
+		if (setting >> value && value > 0)
+			return std::min(static_cast<size_t>(value), DEFAULT_MAX_PLAYERS);
+		return DEFAULT_MAX_PLAYERS;
+	}
+}
+
+void CallPluginCallback(PluginCallback callback, int playerid)
+{
+	cell args[] = { playerid };
+	callPublic(callback, args, 1);
+}
+
+void CallPluginCallback(PluginCallback callback, int playerid, bool success)
+{
+	cell args[] = { playerid, success };
+	callPublic(callback, args, 2);
+}
+
 // ============================================================================
 // SA-MP Plugin Exports
 // ============================================================================
 
 PLUGIN_EXPORT unsigned int PLUGIN_CALL Supports()
 {
-	return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES;
+	return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES | SUPPORTS_PROCESS_TICK;
 }
 
 PLUGIN_EXPORT bool PLUGIN_CALL Load(void** ppData)
@@ -33,10 +116,18 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void** ppData)
 	logprintf = reinterpret_cast<logprintf_t>(ppData[PLUGIN_DATA_LOGPRINTF]);
 	isPluginMode = true;
 
+	PlayerDataManager::Get().Resize(readMaxPlayers());
+
+	std::string masterKey = readServerSetting("totp_master_key");
+	if (!SetPluginMasterKey(masterKey))
+		logprintf("[TOTP] totp_master_key must be 64 hex digits and needs an OpenSSL build; secrets are not sealed");
+	std::fill(masterKey.begin(), masterKey.end(), '\0');
+
 	logprintf(" ");
 	logprintf(" =======================================");
 	logprintf("  neufox-2fa v%s loaded successfully", PLUGIN_VERSION);
 	logprintf("  TOTP 2FA Authentication Plugin");
+	logprintf("  Player slots: %u", static_cast<unsigned>(PlayerDataManager::Get().Capacity()));
 	logprintf(" =======================================");
 	logprintf(" ");
 
@@ -45,6 +136,7 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void** ppData)
 
 PLUGIN_EXPORT void PLUGIN_CALL Unload()
 {
+	StopPluginVerifications();
 	PlayerDataManager::Destroy();
 
 	logprintf(" ");
@@ -54,14 +146,31 @@ PLUGIN_EXPORT void PLUGIN_CALL Unload()
 
 PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX* amx)
 {
+	Script script;
+	script.amx = amx;
+	for (int i = 0; i < PLUGIN_CALLBACK_COUNT; i++)
+	{
+		if (amx_FindPublic(amx, CALLBACK_NAMES[i], &script.publics[i]) != AMX_ERR_NONE)
+			script.publics[i] = -1;
+	}
+	scripts.add(script);
+
 	return amx_Register(amx, native_list, -1);
 }
 
 PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX* amx)
 {
+	scripts.remove(&Script::amx, amx);
 	return AMX_ERR_NONE;
 }
 
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick()
+{
+	ProcessPluginDisconnects();
+	ProcessPluginVerifications();
+	ProcessPluginLoads();
+}
+
 // ============================================================================
 // open.mp Component Entry Point
 // ============================================================================
@@ -10,12 +10,184 @@
 #include "totp-plugin.hpp"
 #include "totp-player-data.hpp"
 #include "totp-utils.hpp"
+#include "totp-engine.hpp"
+#include "totp-store.hpp"
+#include "totp-limiter.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <vector>
 
-// Rate limiting constants
-constexpr int MAX_FAILED_ATTEMPTS = 3;
-constexpr int RATE_LIMIT_SECONDS = 60;
+namespace
+{
+	// Asynchronous verifications in plugin mode; results are applied from ProcessTick.
+	TOTPAsync::VerifyPool verifyPool;
+	uint64_t nextTicket = 0;
+
+	// Results of TOTP_LoadAccountAsync, delivered on the next tick as in the component.
+	struct LoadResult
+	{
+		int playerid;
+		bool success;
+	};
+
+	std::vector<LoadResult> loadResults;
+	std::vector<LoadResult> deliveredLoads;
+
+	// Players who disconnected since the last tick, cleared in ProcessPluginDisconnects.
+	std::vector<int> leavingPlayers;
+
+	// Forget everything about a slot, including any verification or load still to be delivered
+	// to it, so none of it reaches whoever takes the slot next.
+	void clearPlayer(int playerid)
+	{
+		PlayerDataManager::Get().ResetPlayer(playerid);
+		loadResults.erase(
+			std::remove_if(loadResults.begin(), loadResults.end(), [playerid](const LoadResult& result)
+			{
+				return result.playerid == playerid;
+			}),
+			loadResults.end());
+	}
+
+	// Failures per address and serial, kept across reconnects as in the component. Built on
+	// first use, since it seeds its hashing from the CSPRNG.
+	TOTPLimiter::ConnectionLimiter& connectionLimiter()
+	{
+		static TOTPLimiter::ConnectionLimiter limiter;
+		return limiter;
+	}
+
+	// Validates the attempt and applies rate limiting, by address and serial first.
+	bool beginVerify(PlayerDataManager& players, int playerid, std::string_view code)
+	{
+		auto now = TOTPEngine::Clock::now();
+		if (connectionLimiter().throttled(players.GetAddress(playerid), players.GetSerial(playerid), now))
+			return false;
+
+		auto slot = players.GetSlot(playerid);
+		return TOTPEngine::beginVerify(slot, code, now);
+	}
+
+	void recordFailure(PlayerDataManager& players, int playerid)
+	{
+		connectionLimiter().recordFailure(players.GetAddress(playerid), players.GetSerial(playerid), TOTPEngine::Clock::now());
+	}
+
+	// Keyed from totp_master_key in server.cfg.
+	TOTPSeal::Sealer sealer;
+
+	// Plugin mode has no config file of its own, so the account store has a fixed path.
+	constexpr const char* ACCOUNT_STORE_PATH = "scriptfiles/totp-accounts.dat";
+	TOTPStore::AccountStore accountStore;
+	bool accountStoreFailed = false;
+
+	TOTPStore::AccountStore* openAccountStore()
+	{
+		if (accountStore.isOpen())
+			return &accountStore;
+
+		if (accountStoreFailed)
+			return nullptr;
+
+		if (!accountStore.open(ACCOUNT_STORE_PATH))
+		{
+			accountStoreFailed = true;
+			logprintf("[TOTP] Could not open account store %s", ACCOUNT_STORE_PATH);
+			return nullptr;
+		}
+		return &accountStore;
+	}
+
+	// Store the player's state under an account, or remove the account if TOTP is disabled.
+	bool writeAccount(TOTPStore::AccountStore& store, std::string_view account, PlayerDataManager& players, int playerid)
+	{
+		if (!players.IsEnabled(playerid) || !players.HasSecret(playerid))
+		{
+			store.remove(account);
+			return true;
+		}
+
+		TOTPStore::Entry entry;
+		entry.secretLength = TOTPEngine::exportSecret(sealer, players.GetSecret(playerid), entry.secret, sizeof(entry.secret));
+		entry.params = players.GetParams(playerid);
+		if (entry.secretLength == 0)
+			return false;
+
+		bool saved = store.store(account, entry);
+		entry.clear();
+		return saved;
+	}
+
+	// Keep the account the player is bound to in step with a change to their state.
+	void saveBoundAccount(PlayerDataManager& players, int playerid)
+	{
+		std::string_view account = players.GetAccount(playerid);
+		if (account.empty())
+			return;
+
+		if (TOTPStore::AccountStore* store = openAccountStore())
+			writeAccount(*store, account, players, playerid);
+	}
+
+	// One spare character so an over-long name is rejected instead of truncated.
+	using AccountBuffer = char[TOTPStore::MAX_ACCOUNT_LENGTH + 2];
+
+	std::string_view getAccount(AMX* amx, cell param, AccountBuffer& buffer)
+	{
+		cell* addr;
+		amx_GetAddr(amx, param, &addr);
+		amx_GetString(buffer, addr, 0, sizeof(buffer));
+		return std::string_view(buffer, strlen(buffer));
+	}
+
+	// State flags written by TOTP_GetStates.
+	constexpr cell STATE_ENABLED = 1;
+	constexpr cell STATE_VERIFIED = 2;
+
+	// Copy a mask into a Pawn array, 32 players per cell. Returns the number of cells written.
+	template <class Output>
+	size_t writeMask(const PlayerMask& mask, Output&& output, size_t size)
+	{
+		const std::vector<uint64_t>& words = mask.words();
+		size_t cells = std::min(size, (mask.size() + 31) / 32);
+		for (size_t i = 0; i < cells; i++)
+			output[i] = static_cast<cell>(static_cast<uint32_t>(words[i / 2] >> (i % 2 * 32)));
+		return cells;
+	}
+
+	// Write the IDs of players who are enabled but not verified. Returns the number written.
+	template <class Output>
+	size_t writeUnverified(const PlayerMask& enabled, const PlayerMask& verified, Output&& output, size_t size)
+	{
+		const std::vector<uint64_t>& enabledWords = enabled.words();
+		const std::vector<uint64_t>& verifiedWords = verified.words();
+		size_t count = 0;
+		for (size_t i = 0; i < enabledWords.size() && count < size; i++)
+		{
+			uint64_t bits = enabledWords[i] & ~verifiedWords[i];
+			for (size_t bit = 0; bits != 0 && count < size; bit++, bits >>= 1)
+			{
+				if (bits & 1)
+					output[count++] = static_cast<cell>(i * 64 + bit);
+			}
+		}
+		return count;
+	}
+
+	// Write the state flags of every player ID. Returns the number of cells written.
+	template <class Output>
+	size_t writeStates(const PlayerMask& enabled, const PlayerMask& verified, Output&& output, size_t size)
+	{
+		size_t cells = std::min(size, enabled.size());
+		for (size_t i = 0; i < cells; i++)
+		{
+			int playerid = static_cast<int>(i);
+			output[i] = (enabled.test(playerid) ? STATE_ENABLED : 0) | (verified.test(playerid) ? STATE_VERIFIED : 0);
+		}
+		return cells;
+	}
+}
 
 // ============================================================================
 // SA-MP Native Implementations
@@ -26,8 +198,7 @@ cell AMX_NATIVE_CALL n_TOTP_GenerateSecret(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data)
+	if (!PlayerDataManager::Get().IsValid(playerid))
 		return 0;
 
 	auto secret = TOTPUtils::generateSecret();
@@ -41,36 +212,88 @@ cell AMX_NATIVE_CALL n_TOTP_GenerateSecret(AMX* amx, const cell* params)
 	return 1;
 }
 
+// native bool:TOTP_GenerateSecretEx(playerid, length, output[], size = sizeof(output));
+cell AMX_NATIVE_CALL n_TOTP_GenerateSecretEx(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+
+	if (!PlayerDataManager::Get().IsValid(playerid) || params[2] <= 0)
+		return 0;
+
+	auto secret = TOTPUtils::generateSecret(static_cast<size_t>(params[2]));
+	if (!secret)
+		return 0;
+
+	cell* addr;
+	amx_GetAddr(amx, params[3], &addr);
+	amx_SetString(addr, secret->c_str(), 0, 0, static_cast<size_t>(params[4]));
+
+	return 1;
+}
+
+// native TOTP_GenerateSecrets(count, length, output[], size = sizeof(output));
+cell AMX_NATIVE_CALL n_TOTP_GenerateSecrets(AMX* amx, const cell* params)
+{
+	if (params[1] <= 0 || params[2] <= 0 || params[2] > static_cast<cell>(TOTPUtils::MAX_SECRET_LENGTH))
+		return 0;
+
+	size_t length = static_cast<size_t>(params[2]);
+	size_t stride = length + 1;
+	size_t count = std::min(static_cast<size_t>(params[1]), static_cast<size_t>(params[4]) / stride);
+
+	if (count == 0)
+		return 0;
+
+	// One run of random characters for all of them, split into terminated strings below.
+	std::vector<char> secrets(count * length);
+	if (!TOTPUtils::generateSecrets(count, length, secrets.data()))
+		return 0;
+
+	cell* addr;
+	amx_GetAddr(amx, params[3], &addr);
+	for (size_t i = 0; i < count; i++, addr += stride)
+	{
+		for (size_t j = 0; j < length; j++)
+			addr[j] = secrets[i * length + j];
+		addr[length] = '\0';
+	}
+
+	std::memset(secrets.data(), 0, secrets.size());
+	return static_cast<cell>(count);
+}
+
 // native bool:TOTP_Enable(playerid, const secret[]);
 cell AMX_NATIVE_CALL n_TOTP_Enable(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data)
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
 		return 0;
 
-	char secret[TOTP_SECRET_LENGTH_SAMP + 1];
+	// Base32 or sealed. One spare character so an over-long secret is rejected instead of truncated.
+	char input[TOTPSeal::MAX_SEALED_LENGTH + 2];
 	cell* addr;
 	amx_GetAddr(amx, params[2], &addr);
-	amx_GetString(secret, addr, 0, sizeof(secret));
+	amx_GetString(input, addr, 0, sizeof(input));
 
-	size_t secretLen = strlen(secret);
-	if (secretLen < 10 || secretLen > TOTP_SECRET_LENGTH_SAMP)
-		return 0;
-
-	for (size_t i = 0; i < secretLen; i++)
+	char secret[TOTPUtils::MAX_SECRET_LENGTH];
+	std::string_view view(secret, TOTPEngine::resolveSecret(sealer, std::string_view(input, strlen(input)), secret));
+	bool valid = TOTPEngine::isValidSecret(view);
+	if (valid)
 	{
-		char c = secret[i];
-		if (!((c >= 'A' && c <= 'Z') || (c >= '2' && c <= '7') || (c >= 'a' && c <= 'z')))
-			return 0;
+		auto slot = players.GetSlot(playerid);
+		TOTPEngine::enable(slot, view);
 	}
+	std::memset(input, 0, sizeof(input));
+	std::memset(secret, 0, sizeof(secret));
 
-	data->setSecret(secret);
-	data->enabled = true;
-	data->verified = false;
-	data->failedAttempts = 0;
+	if (!valid)
+		return 0;
 
+	saveBoundAccount(players, playerid);
+
+	CallPluginCallback(PLUGIN_CALLBACK_ENABLE, playerid);
 	return 1;
 }
 
@@ -79,13 +302,56 @@ cell AMX_NATIVE_CALL n_TOTP_Disable(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data)
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
+		return 0;
+
+	auto slot = players.GetSlot(playerid);
+	TOTPEngine::disable(slot);
+	saveBoundAccount(players, playerid);
+
+	CallPluginCallback(PLUGIN_CALLBACK_DISABLE, playerid);
+	return 1;
+}
+
+// native bool:TOTP_SetSettings(playerid, TOTP_ALGORITHM:algorithm = TOTP_ALGORITHM_SHA1, digits = 6, period = 30);
+cell AMX_NATIVE_CALL n_TOTP_SetSettings(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid) || params[2] < 0 || params[2] > static_cast<cell>(TOTPUtils::Algorithm::SHA512))
+		return 0;
+
+	TOTPUtils::Params settings;
+	settings.algorithm = static_cast<TOTPUtils::Algorithm>(params[2]);
+	settings.digits = static_cast<int>(params[3]);
+	settings.period = static_cast<int>(params[4]);
+
+	if (!players.SetParams(playerid, settings))
+		return 0;
+
+	saveBoundAccount(players, playerid);
+	return 1;
+}
+
+// native bool:TOTP_GetSettings(playerid, &TOTP_ALGORITHM:algorithm, &digits, &period);
+cell AMX_NATIVE_CALL n_TOTP_GetSettings(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
 		return 0;
 
-	data->enabled = false;
-	data->verified = false;
-	data->setSecret("");
+	const TOTPUtils::Params& settings = players.GetParams(playerid);
+	cell* addr;
+	amx_GetAddr(amx, params[2], &addr);
+	*addr = static_cast<cell>(settings.algorithm);
+	amx_GetAddr(amx, params[3], &addr);
+	*addr = settings.digits;
+	amx_GetAddr(amx, params[4], &addr);
+	*addr = settings.period;
 
 	return 1;
 }
@@ -95,52 +361,233 @@ cell AMX_NATIVE_CALL n_TOTP_Verify(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data || !data->enabled || !data->hasSecret())
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
+		return 0;
+
+	char code[16];
+	cell* addr;
+	amx_GetAddr(amx, params[2], &addr);
+	amx_GetString(code, addr, 0, sizeof(code));
+	std::string_view view(code, strlen(code));
+
+	if (!beginVerify(players, playerid, view))
+		return 0;
+
+	auto slot = players.GetSlot(playerid);
+	bool success = TOTPEngine::verify(slot, view, TOTPEngine::currentTimestamp());
+	TOTPEngine::finishVerify(slot, success);
+	if (!success)
+		recordFailure(players, playerid);
+
+	CallPluginCallback(PLUGIN_CALLBACK_VERIFY, playerid, success);
+	return success ? 1 : 0;
+}
+
+// native bool:TOTP_VerifyAsync(playerid, const code[]);
+cell AMX_NATIVE_CALL n_TOTP_VerifyAsync(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
 		return 0;
 
 	char code[16];
 	cell* addr;
 	amx_GetAddr(amx, params[2], &addr);
 	amx_GetString(code, addr, 0, sizeof(code));
+	std::string_view view(code, strlen(code));
 
-	if (strlen(code) != 6)
+	if (!beginVerify(players, playerid, view))
 		return 0;
 
-	auto now = std::chrono::steady_clock::now();
+	auto slot = players.GetSlot(playerid);
+	TOTPEngine::submitJob(verifyPool, slot, playerid, ++nextTicket, view, TOTPEngine::currentTimestamp());
+	return 1;
+}
+
+void ProcessPluginDisconnects()
+{
+	for (int playerid : leavingPlayers)
+		clearPlayer(playerid);
+	leavingPlayers.clear();
+}
 
-	if (data->failedAttempts >= MAX_FAILED_ATTEMPTS)
+void ProcessPluginVerifications()
+{
+	PlayerDataManager& players = PlayerDataManager::Get();
+	verifyPool.drain([&players](TOTPAsync::VerifyJob& job)
 	{
-		auto timeSinceLastAttempt = std::chrono::duration_cast<std::chrono::seconds>(
-			now - data->lastAttempt
-		).count();
+		if (!players.IsValid(job.playerID))
+			return;
+
+		// The player left, or their secret or settings changed while the job was running.
+		auto slot = players.GetSlot(job.playerID);
+		if (!TOTPEngine::completeJob(slot, job))
+			return;
+
+		if (!job.success)
+			recordFailure(players, job.playerID);
+
+		CallPluginCallback(PLUGIN_CALLBACK_VERIFY, job.playerID, job.success);
+	});
+}
+
+void StopPluginVerifications()
+{
+	verifyPool.stop();
+}
 
-		if (timeSinceLastAttempt < RATE_LIMIT_SECONDS)
-			return 0;
-		else
-			data->failedAttempts = 0;
+void ProcessPluginLoads()
+{
+	// Swapped out first, as a callback may queue another load.
+	deliveredLoads.swap(loadResults);
+	for (const LoadResult& result : deliveredLoads)
+		CallPluginCallback(PLUGIN_CALLBACK_LOADED, result.playerid, result.success);
+	deliveredLoads.clear();
+
+	std::string storeError;
+	if (accountStore.takeError(storeError))
+		logprintf("[TOTP] Account store: %s", storeError.c_str());
+}
+
+bool SetPluginMasterKey(std::string_view hex)
+{
+	return sealer.setKey(hex);
+}
+
+// native bool:TOTP_LoadAccount(playerid, const account[]);
+cell AMX_NATIVE_CALL n_TOTP_LoadAccount(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+
+	PlayerDataManager& players = PlayerDataManager::Get();
+	TOTPStore::AccountStore* store = openAccountStore();
+	if (!players.IsValid(playerid) || !store)
+		return 0;
+
+	AccountBuffer account;
+	std::string_view name = getAccount(amx, params[2], account);
+	TOTPStore::Entry entry;
+	if (!store->find(name, entry))
+		return 0;
+
+	char secret[TOTPUtils::MAX_SECRET_LENGTH];
+	std::string_view view(secret, TOTPEngine::resolveSecret(sealer, entry.getSecret(), secret));
+	bool loaded = TOTPEngine::isValidSecret(view) && players.SetParams(playerid, entry.params);
+	if (loaded)
+	{
+		auto slot = players.GetSlot(playerid);
+		TOTPEngine::enable(slot, view);
+		players.SetAccount(playerid, name);
 	}
 
-	data->lastAttempt = now;
+	std::memset(secret, 0, sizeof(secret));
+	entry.clear();
+	return loaded ? 1 : 0;
+}
+
+// native bool:TOTP_LoadAccountAsync(playerid, const account[]);
+// Plugin mode only has the account store file, which is read in place; the result still
+// arrives on the next tick so scripts work the same with either front-end.
+cell AMX_NATIVE_CALL n_TOTP_LoadAccountAsync(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+	if (!PlayerDataManager::Get().IsValid(playerid) || !openAccountStore())
+		return 0;
+
+	loadResults.push_back({ playerid, n_TOTP_LoadAccount(amx, params) != 0 });
+	return 1;
+}
+
+// native bool:TOTP_SaveAccount(playerid, const account[]);
+cell AMX_NATIVE_CALL n_TOTP_SaveAccount(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+
+	PlayerDataManager& players = PlayerDataManager::Get();
+	TOTPStore::AccountStore* store = openAccountStore();
+	if (!players.IsValid(playerid) || !store)
+		return 0;
+
+	AccountBuffer account;
+	std::string_view name = getAccount(amx, params[2], account);
+	if (name.empty() || name.length() > TOTPStore::MAX_ACCOUNT_LENGTH || !writeAccount(*store, name, players, playerid))
+		return 0;
+
+	players.SetAccount(playerid, name);
+	return 1;
+}
+
+// native bool:TOTP_DeleteAccount(const account[]);
+cell AMX_NATIVE_CALL n_TOTP_DeleteAccount(AMX* amx, const cell* params)
+{
+	TOTPStore::AccountStore* store = openAccountStore();
+	if (!store)
+		return 0;
+
+	AccountBuffer account;
+	return store->remove(getAccount(amx, params[1], account)) ? 1 : 0;
+}
 
-	auto nowSystem = std::chrono::system_clock::now();
-	uint64_t timestamp = std::chrono::duration_cast<std::chrono::seconds>(
-		nowSystem.time_since_epoch()
-	).count();
+// native TOTP_Internal_OnConnect(playerid, const ip[] = "", const serial[] = "");
+// Called by the include's OnPlayerConnect hook, since plugins are not told about connections.
+// Nothing is reset here: SA-MP calls OnPlayerConnect again for everyone online after a gmx,
+// and their state is kept. Only a slot whose last player left this tick is cleared early.
+// The address and serial are what failures are limited by; scripts built against an older
+// include do not pass them.
+cell AMX_NATIVE_CALL n_TOTP_Internal_OnConnect(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
 
-	bool success = TOTPUtils::verifyTOTP(data->secret, code, timestamp);
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
+		return 0;
 
-	if (success)
+	auto leaving = std::find(leavingPlayers.begin(), leavingPlayers.end(), playerid);
+	if (leaving != leavingPlayers.end())
 	{
-		data->verified = true;
-		data->failedAttempts = 0;
+		leavingPlayers.erase(leaving);
+		clearPlayer(playerid);
 	}
-	else
+
+	if (params[0] >= static_cast<cell>(3 * sizeof(cell)))
 	{
-		data->failedAttempts++;
+		char address[MAX_ADDRESS_LENGTH + 1];
+		char serial[MAX_SERIAL_LENGTH + 1];
+		cell* addr;
+		amx_GetAddr(amx, params[2], &addr);
+		amx_GetString(address, addr, 0, sizeof(address));
+		amx_GetAddr(amx, params[3], &addr);
+		amx_GetString(serial, addr, 0, sizeof(serial));
+		players.SetConnection(playerid, address, serial);
 	}
+	return 1;
+}
 
-	return success ? 1 : 0;
+// native TOTP_Internal_OnDisconnect(playerid);
+// Called by the hook in every script, filterscripts first, so the slot is only marked here and
+// cleared on the next tick, once the gamemode has also seen the player leave.
+cell AMX_NATIVE_CALL n_TOTP_Internal_OnDisconnect(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+	if (!PlayerDataManager::Get().IsValid(playerid))
+		return 0;
+
+	if (std::find(leavingPlayers.begin(), leavingPlayers.end(), playerid) == leavingPlayers.end())
+		leavingPlayers.push_back(playerid);
+	return 1;
+}
+
+// native bool:TOTP_IsIPThrottled(const ip[]);
+cell AMX_NATIVE_CALL n_TOTP_IsIPThrottled(AMX* amx, const cell* params)
+{
+	char address[MAX_ADDRESS_LENGTH + 1];
+	cell* addr;
+	amx_GetAddr(amx, params[1], &addr);
+	amx_GetString(address, addr, 0, sizeof(address));
+	return connectionLimiter().addressThrottled(address, TOTPEngine::Clock::now()) ? 1 : 0;
 }
 
 // native bool:TOTP_IsEnabled(playerid);
@@ -148,11 +595,11 @@ cell AMX_NATIVE_CALL n_TOTP_IsEnabled(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data)
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
 		return 0;
 
-	return data->enabled ? 1 : 0;
+	return players.IsEnabled(playerid) ? 1 : 0;
 }
 
 // native bool:TOTP_IsVerified(playerid);
@@ -160,11 +607,37 @@ cell AMX_NATIVE_CALL n_TOTP_IsVerified(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data)
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
 		return 0;
 
-	return data->verified ? 1 : 0;
+	return players.IsVerified(playerid) ? 1 : 0;
+}
+
+// native TOTP_GetVerifiedMask(mask[], size = sizeof(mask));
+cell AMX_NATIVE_CALL n_TOTP_GetVerifiedMask(AMX* amx, const cell* params)
+{
+	cell* addr;
+	amx_GetAddr(amx, params[1], &addr);
+	return static_cast<cell>(writeMask(PlayerDataManager::Get().GetVerifiedMask(), addr, static_cast<size_t>(params[2])));
+}
+
+// native TOTP_GetUnverifiedPlayers(output[], size = sizeof(output));
+cell AMX_NATIVE_CALL n_TOTP_GetUnverifiedPlayers(AMX* amx, const cell* params)
+{
+	PlayerDataManager& players = PlayerDataManager::Get();
+	cell* addr;
+	amx_GetAddr(amx, params[1], &addr);
+	return static_cast<cell>(writeUnverified(players.GetEnabledMask(), players.GetVerifiedMask(), addr, static_cast<size_t>(params[2])));
+}
+
+// native TOTP_GetStates(output[], size = sizeof(output));
+cell AMX_NATIVE_CALL n_TOTP_GetStates(AMX* amx, const cell* params)
+{
+	PlayerDataManager& players = PlayerDataManager::Get();
+	cell* addr;
+	amx_GetAddr(amx, params[1], &addr);
+	return static_cast<cell>(writeStates(players.GetEnabledMask(), players.GetVerifiedMask(), addr, static_cast<size_t>(params[2])));
 }
 
 // native bool:TOTP_GetSecret(playerid, output[], size = sizeof(output));
@@ -172,27 +645,45 @@ cell AMX_NATIVE_CALL n_TOTP_GetSecret(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data || !data->hasSecret())
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid) || !players.HasSecret(playerid))
+		return 0;
+
+	// Sealed if totp_master_key is set.
+	char secret[TOTPSeal::MAX_SEALED_LENGTH + 1] = {};
+	if (TOTPEngine::exportSecret(sealer, players.GetSecret(playerid), secret, sizeof(secret) - 1) == 0)
 		return 0;
 
 	cell* addr;
 	amx_GetAddr(amx, params[2], &addr);
-	amx_SetString(addr, data->secret.c_str(), 0, 0, static_cast<size_t>(params[3]));
+	amx_SetString(addr, secret, 0, 0, static_cast<size_t>(params[3]));
+	std::memset(secret, 0, sizeof(secret));
 
 	return 1;
 }
 
+// native bool:TOTP_IsVerifyPending(playerid);
+cell AMX_NATIVE_CALL n_TOTP_IsVerifyPending(AMX* amx, const cell* params)
+{
+	int playerid = static_cast<int>(params[1]);
+
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
+		return 0;
+
+	return players.GetPendingTicket(playerid) != 0 ? 1 : 0;
+}
+
 // native TOTP_GetFailedAttempts(playerid);
 cell AMX_NATIVE_CALL n_TOTP_GetFailedAttempts(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data)
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
 		return 0;
 
-	return data->failedAttempts;
+	return players.GetFailedAttempts(playerid);
 }
 
 // native TOTP_ResetVerification(playerid);
@@ -200,11 +691,11 @@ cell AMX_NATIVE_CALL n_TOTP_ResetVerification(AMX* amx, const cell* params)
 {
 	int playerid = static_cast<int>(params[1]);
 
-	PlayerTOTPData* data = PlayerDataManager::Get().GetPlayer(playerid);
-	if (!data)
+	PlayerDataManager& players = PlayerDataManager::Get();
+	if (!players.IsValid(playerid))
 		return 0;
 
-	data->verified = false;
+	players.SetVerified(playerid, false);
 	return 1;
 }
 
@@ -214,14 +705,30 @@ cell AMX_NATIVE_CALL n_TOTP_ResetVerification(AMX* amx, const cell* params)
 
 extern "C" const AMX_NATIVE_INFO native_list[] = {
 	{"TOTP_GenerateSecret", n_TOTP_GenerateSecret},
+	{"TOTP_GenerateSecretEx", n_TOTP_GenerateSecretEx},
+	{"TOTP_GenerateSecrets", n_TOTP_GenerateSecrets},
 	{"TOTP_Enable", n_TOTP_Enable},
 	{"TOTP_Disable", n_TOTP_Disable},
+	{"TOTP_SetSettings", n_TOTP_SetSettings},
+	{"TOTP_GetSettings", n_TOTP_GetSettings},
 	{"TOTP_Verify", n_TOTP_Verify},
+	{"TOTP_VerifyAsync", n_TOTP_VerifyAsync},
+	{"TOTP_IsIPThrottled", n_TOTP_IsIPThrottled},
 	{"TOTP_IsEnabled", n_TOTP_IsEnabled},
 	{"TOTP_IsVerified", n_TOTP_IsVerified},
+	{"TOTP_GetVerifiedMask", n_TOTP_GetVerifiedMask},
+	{"TOTP_GetUnverifiedPlayers", n_TOTP_GetUnverifiedPlayers},
+	{"TOTP_GetStates", n_TOTP_GetStates},
 	{"TOTP_GetSecret", n_TOTP_GetSecret},
+	{"TOTP_IsVerifyPending", n_TOTP_IsVerifyPending},
 	{"TOTP_GetFailedAttempts", n_TOTP_GetFailedAttempts},
 	{"TOTP_ResetVerification", n_TOTP_ResetVerification},
+	{"TOTP_LoadAccount", n_TOTP_LoadAccount},
+	{"TOTP_LoadAccountAsync", n_TOTP_LoadAccountAsync},
+	{"TOTP_SaveAccount", n_TOTP_SaveAccount},
+	{"TOTP_DeleteAccount", n_TOTP_DeleteAccount},
+	{"TOTP_Internal_OnConnect", n_TOTP_Internal_OnConnect},
+	{"TOTP_Internal_OnDisconnect", n_TOTP_Internal_OnDisconnect},
 	{NULL, NULL}
 };
 
@@ -250,6 +757,55 @@ SCRIPT_API(TOTP_GenerateSecret, bool(IPlayer& player, String& output))
 	return false;
 }
 
+// Generate a secret of a given length (RFC 4226 recommends at least 32 characters)
+// native bool:TOTP_GenerateSecretEx(playerid, length, output[], size = sizeof(output));
+SCRIPT_API(TOTP_GenerateSecretEx, bool(IPlayer& player, int length, String& output))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		if (length <= 0)
+			return false;
+
+		auto secret = totp->generateSecret(player, static_cast<size_t>(length));
+		if (secret)
+		{
+			output = *secret;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Generate many secrets into one array, each taking length + 1 cells
+// native TOTP_GenerateSecrets(count, length, output[], size = sizeof(output));
+SCRIPT_API(TOTP_GenerateSecrets, int(int count, int length, DynamicArray<int>& output))
+{
+	if (count <= 0 || length <= 0 || length > static_cast<int>(TOTP_SECRET_LENGTH))
+		return 0;
+
+	size_t stride = static_cast<size_t>(length) + 1;
+	size_t total = std::min(static_cast<size_t>(count), output.size() / stride);
+
+	if (total == 0)
+		return 0;
+
+	// One run of random characters for all of them, split into terminated strings below.
+	size_t secretLength = static_cast<size_t>(length);
+	std::vector<char> secrets(total * secretLength);
+	if (!TOTPUtils::generateSecrets(total, secretLength, secrets.data()))
+		return 0;
+
+	for (size_t i = 0; i < total; i++)
+	{
+		for (size_t j = 0; j < secretLength; j++)
+			output[i * stride + j] = secrets[i * secretLength + j];
+		output[i * stride + secretLength] = '\0';
+	}
+
+	std::memset(secrets.data(), 0, secrets.size());
+	return static_cast<int>(total);
+}
+
 // Enable TOTP 2FA for a player with a given secret
 // native bool:TOTP_Enable(playerid, const secret[]);
 SCRIPT_API(TOTP_Enable, bool(IPlayer& player, String const& secret))
@@ -272,13 +828,68 @@ SCRIPT_API(TOTP_Disable, bool(IPlayer& player))
 	return false;
 }
 
+// Set the algorithm, code length and period used for a player's codes
+// native bool:TOTP_SetSettings(playerid, TOTP_ALGORITHM:algorithm = TOTP_ALGORITHM_SHA1, digits = 6, period = 30);
+SCRIPT_API(TOTP_SetSettings, bool(IPlayer& player, int algorithm, int digits, int period))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		if (algorithm < 0 || algorithm > static_cast<int>(TOTPAlgorithm::SHA512))
+			return false;
+
+		TOTPSettings settings;
+		settings.algorithm = static_cast<TOTPAlgorithm>(algorithm);
+		settings.digits = digits;
+		settings.period = period;
+		return totp->setSettings(player, settings);
+	}
+	return false;
+}
+
+// Get the algorithm, code length and period used for a player's codes
+// native bool:TOTP_GetSettings(playerid, &TOTP_ALGORITHM:algorithm, &digits, &period);
+SCRIPT_API(TOTP_GetSettings, bool(IPlayer& player, int& algorithm, int& digits, int& period))
+{
+	// Players who never used TOTP have no extension yet and are on the defaults.
+	TOTPSettings settings;
+	if (auto data = queryExtension<ITOTPExtension>(player))
+		settings = data->getSettings();
+
+	algorithm = static_cast<int>(settings.algorithm);
+	digits = settings.digits;
+	period = settings.period;
+	return true;
+}
+
 // Verify a TOTP code for a player
 // native bool:TOTP_Verify(playerid, const code[]);
 SCRIPT_API(TOTP_Verify, bool(IPlayer& player, String const& code))
 {
 	if (auto totp = TOTPComponent::getInstance())
 	{
-		return totp->verifyCode(player, code.data());
+		return totp->verifyCode(player, StringView(code.data(), code.length())) == TOTPVerifyResult::Verified;
+	}
+	return false;
+}
+
+// Queue a TOTP code to be checked off the main thread; OnPlayerTOTPVerify gets the result
+// native bool:TOTP_VerifyAsync(playerid, const code[]);
+SCRIPT_API(TOTP_VerifyAsync, bool(IPlayer& player, String const& code))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		return totp->verifyCodeAsync(player, StringView(code.data(), code.length()));
+	}
+	return false;
+}
+
+// Check if failed attempts from an IP address are being throttled
+// native bool:TOTP_IsIPThrottled(const ip[]);
+SCRIPT_API(TOTP_IsIPThrottled, bool(String const& ip))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		return totp->isAddressThrottled(StringView(ip.data(), ip.length()));
 	}
 	return false;
 }
@@ -305,17 +916,53 @@ SCRIPT_API(TOTP_IsVerified, bool(IPlayer& player))
 	return false;
 }
 
-// Get the player's TOTP secret (for display/storage)
+// Get the verified flag of every player, 32 players per cell
+// native TOTP_GetVerifiedMask(mask[], size = sizeof(mask));
+SCRIPT_API(TOTP_GetVerifiedMask, int(DynamicArray<int>& mask))
+{
+	return static_cast<int>(writeMask(TOTPExtension::verifiedPlayers(), mask, mask.size()));
+}
+
+// Get the IDs of players who have TOTP enabled but have not verified
+// native TOTP_GetUnverifiedPlayers(output[], size = sizeof(output));
+SCRIPT_API(TOTP_GetUnverifiedPlayers, int(DynamicArray<int>& output))
+{
+	return static_cast<int>(writeUnverified(TOTPExtension::enabledPlayers(), TOTPExtension::verifiedPlayers(), output, output.size()));
+}
+
+// Get the TOTP_STATE flags of every player, indexed by player ID
+// native TOTP_GetStates(output[], size = sizeof(output));
+SCRIPT_API(TOTP_GetStates, int(DynamicArray<int>& output))
+{
+	return static_cast<int>(writeStates(TOTPExtension::enabledPlayers(), TOTPExtension::verifiedPlayers(), output, output.size()));
+}
+
+// Get the player's TOTP secret (for display/storage), sealed if totp.master_key is set
 // native bool:TOTP_GetSecret(playerid, output[], size = sizeof(output));
 SCRIPT_API(TOTP_GetSecret, bool(IPlayer& player, String& output))
 {
-	if (auto data = queryExtension<ITOTPExtension>(player))
+	auto totp = TOTPComponent::getInstance();
+	auto data = queryExtension<ITOTPExtension>(player);
+	if (!totp || !data || !data->hasSecret())
+		return false;
+
+	char secret[TOTPSeal::MAX_SEALED_LENGTH];
+	size_t length = TOTPEngine::exportSecret(totp->sealer(), data->getSecret(), secret, sizeof(secret));
+	if (length == 0)
+		return false;
+
+	output.assign(secret, length);
+	std::memset(secret, 0, sizeof(secret));
+	return true;
+}
+
+// Check if a code is still queued, so a false from TOTP_Verify can be told apart from a wrong code
+// native bool:TOTP_IsVerifyPending(playerid);
+SCRIPT_API(TOTP_IsVerifyPending, bool(IPlayer& player))
+{
+	if (auto totp = TOTPComponent::getInstance())
 	{
-		if (data->hasSecret())
-		{
-			output = data->getSecret();
-			return true;
-		}
+		return totp->isVerifyPending(player);
 	}
 	return false;
 }
@@ -336,11 +983,65 @@ SCRIPT_API(TOTP_GetFailedAttempts, int(IPlayer& player))
 SCRIPT_API(TOTP_ResetVerification, bool(IPlayer& player))
 {
 	if (auto data = queryExtension<ITOTPExtension>(player))
-	{
 		data->setVerified(false);
-		return true;
+	return true;
+}
+
+// Enable TOTP for a player from the secret and settings stored for an account
+// native bool:TOTP_LoadAccount(playerid, const account[]);
+SCRIPT_API(TOTP_LoadAccount, bool(IPlayer& player, String const& account))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		return totp->loadAccount(player, StringView(account.data(), account.length()));
+	}
+	return false;
+}
+
+// Queue loading an account; OnPlayerTOTPLoaded reports the result
+// native bool:TOTP_LoadAccountAsync(playerid, const account[]);
+SCRIPT_API(TOTP_LoadAccountAsync, bool(IPlayer& player, String const& account))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		return totp->loadAccountAsync(player, StringView(account.data(), account.length()));
 	}
 	return false;
 }
 
+// Store a player's secret and settings under an account, or remove it if TOTP is disabled
+// native bool:TOTP_SaveAccount(playerid, const account[]);
+SCRIPT_API(TOTP_SaveAccount, bool(IPlayer& player, String const& account))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		return totp->saveAccount(player, StringView(account.data(), account.length()));
+	}
+	return false;
+}
+
+// Remove an account from the store
+// native bool:TOTP_DeleteAccount(const account[]);
+SCRIPT_API(TOTP_DeleteAccount, bool(String const& account))
+{
+	if (auto totp = TOTPComponent::getInstance())
+	{
+		return totp->deleteAccount(StringView(account.data(), account.length()));
+	}
+	return false;
+}
+
+// The component follows connections itself; these only exist for the include's hooks.
+// native TOTP_Internal_OnConnect(playerid, const ip[] = "", const serial[] = "");
+SCRIPT_API(TOTP_Internal_OnConnect, bool(IPlayer& player, String const& ip, String const& serial))
+{
+	return true;
+}
+
+// native TOTP_Internal_OnDisconnect(playerid);
+SCRIPT_API(TOTP_Internal_OnDisconnect, bool(IPlayer& player))
+{
+	return true;
+}
+
 #endif // SAMP_PLUGIN_BUILD
@@ -7,5 +7,156 @@
  */
 
 #include "totp-player-data.hpp"
+#include <algorithm>
+#include <cstring>
 
 PlayerDataManager* PlayerDataManager::instance_ = nullptr;
+
+PlayerDataManager::PlayerDataManager()
+{
+	Resize(DEFAULT_MAX_PLAYERS);
+}
+
+void PlayerDataManager::Resize(size_t maxPlayers)
+{
+	if (maxPlayers == capacity_)
+		return;
+
+	// Secrets being dropped are wiped before their memory is released.
+	ResetAll();
+
+	capacity_ = maxPlayers;
+	enabled_.resize(maxPlayers);
+	verified_.resize(maxPlayers);
+	secrets_.resize(maxPlayers);
+	secretLengths_.resize(maxPlayers);
+	params_.resize(maxPlayers);
+	keys_.resize(maxPlayers);
+	codes_.resize(maxPlayers);
+	failedAttempts_.resize(maxPlayers);
+	lastAttempts_.resize(maxPlayers);
+	pendingTickets_.resize(maxPlayers);
+	accounts_.resize(maxPlayers);
+	accountLengths_.resize(maxPlayers);
+	addresses_.resize(maxPlayers);
+	addressLengths_.resize(maxPlayers);
+	serials_.resize(maxPlayers);
+	serialLengths_.resize(maxPlayers);
+
+	ResetAll();
+}
+
+void PlayerDataManager::ResetPlayer(int playerid)
+{
+	if (!IsValid(playerid))
+		return;
+
+	enabled_.assign(playerid, false);
+	verified_.assign(playerid, false);
+	secrets_[playerid].fill(0);
+	secretLengths_[playerid] = 0;
+	params_[playerid] = {};
+	keys_[playerid].clear();
+	codes_[playerid].clear();
+	failedAttempts_[playerid] = 0;
+	lastAttempts_[playerid] = Clock::time_point::min();
+	pendingTickets_[playerid] = 0;
+	accounts_[playerid].fill(0);
+	accountLengths_[playerid] = 0;
+	addresses_[playerid].fill(0);
+	addressLengths_[playerid] = 0;
+	serials_[playerid].fill(0);
+	serialLengths_[playerid] = 0;
+}
+
+void PlayerDataManager::ResetAll()
+{
+	enabled_.clear();
+	verified_.clear();
+	if (capacity_ == 0)
+		return;
+
+	std::memset(secrets_.data(), 0, secrets_.size() * sizeof(secrets_[0]));
+	std::memset(secretLengths_.data(), 0, secretLengths_.size());
+	std::memset(failedAttempts_.data(), 0, failedAttempts_.size() * sizeof(int));
+	std::memset(pendingTickets_.data(), 0, pendingTickets_.size() * sizeof(uint64_t));
+	std::memset(accounts_.data(), 0, accounts_.size() * sizeof(accounts_[0]));
+	std::memset(accountLengths_.data(), 0, accountLengths_.size());
+	std::memset(addresses_.data(), 0, addresses_.size() * sizeof(addresses_[0]));
+	std::memset(addressLengths_.data(), 0, addressLengths_.size());
+	std::memset(serials_.data(), 0, serials_.size() * sizeof(serials_[0]));
+	std::memset(serialLengths_.data(), 0, serialLengths_.size());
+	std::fill(params_.begin(), params_.end(), TOTPUtils::Params {});
+	std::fill(lastAttempts_.begin(), lastAttempts_.end(), Clock::time_point::min());
+	for (TOTPUtils::TOTPKey& key : keys_)
+		key.clear();
+	for (TOTPUtils::CodeCache& cache : codes_)
+		cache.clear();
+}
+
+void PlayerDataManager::SetEnabled(int playerid, bool enabled)
+{
+	enabled_.assign(playerid, enabled);
+	if (!enabled)
+		verified_.assign(playerid, false);
+}
+
+void PlayerDataManager::prepareKey(int playerid)
+{
+	codes_[playerid].clear();
+	pendingTickets_[playerid] = 0;
+	if (secretLengths_[playerid] == 0)
+	{
+		keys_[playerid].clear();
+		return;
+	}
+
+	if (!TOTPUtils::prepareKey(GetSecret(playerid), params_[playerid], keys_[playerid]))
+	{
+		secrets_[playerid].fill(0);
+		secretLengths_[playerid] = 0;
+	}
+}
+
+void PlayerDataManager::SetSecret(int playerid, std::string_view secret)
+{
+	secret = secret.substr(0, TOTP_SECRET_LENGTH_SAMP);
+	if (secret == GetSecret(playerid) && !keys_[playerid].empty())
+		return;
+
+	secrets_[playerid].fill(0);
+	std::memcpy(secrets_[playerid].data(), secret.data(), secret.length());
+	secretLengths_[playerid] = static_cast<uint8_t>(secret.length());
+	prepareKey(playerid);
+}
+
+bool PlayerDataManager::SetParams(int playerid, const TOTPUtils::Params& params)
+{
+	if (!TOTPUtils::validParams(params))
+		return false;
+
+	params_[playerid] = params;
+	prepareKey(playerid);
+	return true;
+}
+
+void PlayerDataManager::SetAccount(int playerid, std::string_view account)
+{
+	account = account.substr(0, TOTPStore::MAX_ACCOUNT_LENGTH);
+	accounts_[playerid].fill(0);
+	std::memcpy(accounts_[playerid].data(), account.data(), account.length());
+	accountLengths_[playerid] = static_cast<uint8_t>(account.length());
+}
+
+void PlayerDataManager::SetConnection(int playerid, std::string_view address, std::string_view serial)
+{
+	address = address.substr(0, MAX_ADDRESS_LENGTH);
+	addresses_[playerid].fill(0);
+	std::memcpy(addresses_[playerid].data(), address.data(), address.length());
+	addressLengths_[playerid] = static_cast<uint8_t>(address.length());
+
+	serial = serial.substr(0, MAX_SERIAL_LENGTH);
+	serials_[playerid].fill(0);
+	std::memcpy(serials_[playerid].data(), serial.data(), serial.length());
+	serialLengths_[playerid] = static_cast<uint8_t>(serial.length());
+}
@@ -8,64 +8,59 @@
  *  The original code is copyright (c) 2025, itsneufox.
  */
 
+#include <array>
 #include <chrono>
-#include <string>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "totp-utils.hpp"
+#include "totp-player-mask.hpp"
+#include "totp-store.hpp"
 
-constexpr size_t TOTP_SECRET_LENGTH_SAMP = 16;
-constexpr int MAX_PLAYERS = 1000;
+constexpr size_t TOTP_SECRET_LENGTH_SAMP = TOTPUtils::MAX_SECRET_LENGTH;
 
-struct PlayerTOTPData
-{
-	bool enabled;
-	bool verified;
-	std::string secret;
-	int failedAttempts;
-	std::chrono::steady_clock::time_point lastAttempt;
-
-	PlayerTOTPData()
-		: enabled(false)
-		, verified(false)
-		, failedAttempts(0)
-		, lastAttempt(std::chrono::steady_clock::time_point::min())
-	{
-	}
-
-	void reset()
-	{
-		enabled = false;
-		verified = false;
-		secret.clear();
-		failedAttempts = 0;
-		lastAttempt = std::chrono::steady_clock::time_point::min();
-	}
+// Longest address and client serial kept per player; longer ones are truncated.
+constexpr size_t MAX_ADDRESS_LENGTH = 64;
+constexpr size_t MAX_SERIAL_LENGTH = 64;
 
-	bool hasSecret() const
-	{
-		return !secret.empty();
-	}
-
-	void setSecret(const char* newSecret)
-	{
-		if (newSecret)
-		{
-			secret = newSecret;
-			if (secret.length() > TOTP_SECRET_LENGTH_SAMP)
-				secret.resize(TOTP_SECRET_LENGTH_SAMP);
-		}
-		else
-		{
-			secret.clear();
-		}
-	}
-};
+// Slots used until the server's real player limit is known; SA-MP never allows more.
+constexpr size_t DEFAULT_MAX_PLAYERS = 1000;
 
+// Per-player state for plugin mode, stored as one array per field. Every array is allocated
+// when the store is sized, so nothing here allocates per player, flags for all players sit in
+// a few words, and resetting everyone is a handful of fills.
 class PlayerDataManager
 {
+public:
+	using Clock = std::chrono::steady_clock;
+
 private:
-	PlayerTOTPData players_[MAX_PLAYERS];
 	static PlayerDataManager* instance_;
 
-	PlayerDataManager() = default;
+	size_t capacity_ = 0;
+
+	PlayerMask enabled_;
+	PlayerMask verified_;
+
+	std::vector<std::array<char, TOTP_SECRET_LENGTH_SAMP>> secrets_;
+	std::vector<uint8_t> secretLengths_;
+	std::vector<TOTPUtils::Params> params_;
+	std::vector<TOTPUtils::TOTPKey> keys_;
+	std::vector<TOTPUtils::CodeCache> codes_;
+	std::vector<int> failedAttempts_;
+	std::vector<Clock::time_point> lastAttempts_;
+	std::vector<uint64_t> pendingTickets_;
+	std::vector<std::array<char, TOTPStore::MAX_ACCOUNT_LENGTH>> accounts_;
+	std::vector<uint8_t> accountLengths_;
+	std::vector<std::array<char, MAX_ADDRESS_LENGTH>> addresses_;
+	std::vector<uint8_t> addressLengths_;
+	std::vector<std::array<char, MAX_SERIAL_LENGTH>> serials_;
+	std::vector<uint8_t> serialLengths_;
+
+	PlayerDataManager();
+
+	// Rebuild the key from the stored secret and params, dropping the secret if it no longer decodes.
+	void prepareKey(int playerid);
 
 public:
 	static PlayerDataManager& Get()
@@ -83,28 +78,120 @@ public:
 		instance_ = nullptr;
 	}
 
-	PlayerTOTPData* GetPlayer(int playerid)
+	// Size the store for the server's player limit. Every player is reset if the size changes.
+	void Resize(size_t maxPlayers);
+
+	size_t Capacity() const
 	{
-		if (playerid < 0 || playerid >= MAX_PLAYERS)
-		{
-			return nullptr;
-		}
-		return &players_[playerid];
+		return capacity_;
 	}
 
-	void ResetPlayer(int playerid)
+	bool IsValid(int playerid) const
 	{
-		if (playerid >= 0 && playerid < MAX_PLAYERS)
-		{
-			players_[playerid].reset();
-		}
+		return playerid >= 0 && static_cast<size_t>(playerid) < capacity_;
 	}
 
-	void ResetAll()
+	void ResetPlayer(int playerid);
+
+	void ResetAll();
+
+	bool IsEnabled(int playerid) const { return enabled_.test(playerid); }
+	bool IsVerified(int playerid) const { return verified_.test(playerid); }
+
+	// Disabling also clears verification.
+	void SetEnabled(int playerid, bool enabled);
+	void SetVerified(int playerid, bool verified) { verified_.assign(playerid, verified); }
+
+	const PlayerMask& GetEnabledMask() const { return enabled_; }
+	const PlayerMask& GetVerifiedMask() const { return verified_; }
+
+	bool HasSecret(int playerid) const { return secretLengths_[playerid] != 0; }
+
+	std::string_view GetSecret(int playerid) const
 	{
-		for (int i = 0; i < MAX_PLAYERS; i++)
+		return std::string_view(secrets_[playerid].data(), secretLengths_[playerid]);
+	}
+
+	// Longer secrets are truncated; an empty or undecodable secret clears the key.
+	void SetSecret(int playerid, std::string_view secret);
+
+	const TOTPUtils::Params& GetParams(int playerid) const { return params_[playerid]; }
+
+	// Returns false and keeps the current params if they are out of range.
+	bool SetParams(int playerid, const TOTPUtils::Params& params);
+
+	const TOTPUtils::TOTPKey& GetKey(int playerid) const { return keys_[playerid]; }
+	TOTPUtils::CodeCache& GetCodeCache(int playerid) { return codes_[playerid]; }
+
+	int GetFailedAttempts(int playerid) const { return failedAttempts_[playerid]; }
+	void IncrementFailedAttempts(int playerid) { failedAttempts_[playerid]++; }
+	void ResetFailedAttempts(int playerid) { failedAttempts_[playerid] = 0; }
+
+	Clock::time_point GetLastAttempt(int playerid) const { return lastAttempts_[playerid]; }
+	void SetLastAttempt(int playerid, Clock::time_point time) { lastAttempts_[playerid] = time; }
+
+	// Ticket of the asynchronous verification in flight, or 0. Cleared with the key.
+	uint64_t GetPendingTicket(int playerid) const { return pendingTickets_[playerid]; }
+	void SetPendingTicket(int playerid, uint64_t ticket) { pendingTickets_[playerid] = ticket; }
+
+	// Account the player was last loaded from or saved to in the account store, or empty.
+	std::string_view GetAccount(int playerid) const
+	{
+		return std::string_view(accounts_[playerid].data(), accountLengths_[playerid]);
+	}
+
+	// Longer names are truncated; the store never holds them.
+	void SetAccount(int playerid, std::string_view account);
+
+	// Address and client serial the include passed when the player connected, or empty.
+	std::string_view GetAddress(int playerid) const
+	{
+		return std::string_view(addresses_[playerid].data(), addressLengths_[playerid]);
+	}
+
+	std::string_view GetSerial(int playerid) const
+	{
+		return std::string_view(serials_[playerid].data(), serialLengths_[playerid]);
+	}
+
+	void SetConnection(int playerid, std::string_view address, std::string_view serial);
+
+	// Players with TOTP enabled who have not verified yet.
+	size_t CountUnverified() const { return enabled_.countExcept(verified_); }
+
+	// One player's state, with the accessors TOTPEngine expects.
+	class Slot
+	{
+	private:
+		PlayerDataManager& players_;
+		int id_;
+
+	public:
+		Slot(PlayerDataManager& players, int playerid)
+			: players_(players)
+			, id_(playerid)
 		{
-			players_[i].reset();
 		}
+
+		bool isEnabled() const { return players_.IsEnabled(id_); }
+		void setEnabled(bool enabled) { players_.SetEnabled(id_, enabled); }
+		void setVerified(bool verified) { players_.SetVerified(id_, verified); }
+		bool hasSecret() const { return players_.HasSecret(id_); }
+		void setSecret(std::string_view secret) { players_.SetSecret(id_, secret); }
+		const TOTPUtils::Params& getParams() const { return players_.GetParams(id_); }
+		const TOTPUtils::TOTPKey& getKey() const { return players_.GetKey(id_); }
+		TOTPUtils::CodeCache& getCodeCache() { return players_.GetCodeCache(id_); }
+		uint64_t getPendingTicket() const { return players_.GetPendingTicket(id_); }
+		void setPendingTicket(uint64_t ticket) { players_.SetPendingTicket(id_, ticket); }
+		int getFailedAttempts() const { return players_.GetFailedAttempts(id_); }
+		void incrementFailedAttempts() { players_.IncrementFailedAttempts(id_); }
+		void resetFailedAttempts() { players_.ResetFailedAttempts(id_); }
+		Clock::time_point getLastAttempt() const { return players_.GetLastAttempt(id_); }
+		void setLastAttempt(Clock::time_point time) { players_.SetLastAttempt(id_, time); }
+	};
+
+	Slot GetSlot(int playerid)
+	{
+		return Slot(*this, playerid);
 	}
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One bit per player ID: player N is bit N % 64 of word N / 64. Kept up to date as players
+// change state, so bulk queries are a copy of a few words rather than a loop over players.
+class PlayerMask
+{
+private:
+	std::vector<uint64_t> words_;
+	size_t size_ = 0;
+
+public:
+	// Clears every bit.
+	void resize(size_t players)
+	{
+		size_ = players;
+		words_.assign((players + 63) / 64, 0);
+	}
+
+	// Number of player IDs covered.
+	size_t size() const
+	{
+		return size_;
+	}
+
+	const std::vector<uint64_t>& words() const
+	{
+		return words_;
+	}
+
+	bool test(int playerid) const
+	{
+		return (words_[playerid >> 6] >> (playerid & 63)) & 1;
+	}
+
+	void assign(int playerid, bool value)
+	{
+		uint64_t bit = uint64_t(1) << (playerid & 63);
+		if (value)
+			words_[playerid >> 6] |= bit;
+		else
+			words_[playerid >> 6] &= ~bit;
+	}
+
+	void clear()
+	{
+		std::fill(words_.begin(), words_.end(), 0);
+	}
+
+	// Players set here and not in other.
+	size_t countExcept(const PlayerMask& other) const
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < words_.size(); i++)
+			count += std::bitset<64>(words_[i] & ~other.words_[i]).count();
+		return count;
+	}
+};
@@ -25,6 +25,7 @@
 
 #include <amx/amx.h>
 #include <plugincommon.h>
+#include <string_view>
 
 typedef void (*logprintf_t)(const char* format, ...);
 
@@ -33,3 +34,35 @@ extern logprintf_t logprintf;
 extern bool isPluginMode;
 
 extern "C" const AMX_NATIVE_INFO native_list[];
+
+// Callbacks the plugin calls, indexing the public indices cached per script.
+enum PluginCallback
+{
+	PLUGIN_CALLBACK_VERIFY,
+	PLUGIN_CALLBACK_ENABLE,
+	PLUGIN_CALLBACK_DISABLE,
+	PLUGIN_CALLBACK_LOADED,
+	PLUGIN_CALLBACK_COUNT
+};
+
+// Call a callback in every loaded script that defines it, in load order.
+void CallPluginCallback(PluginCallback callback, int playerid);
+void CallPluginCallback(PluginCallback callback, int playerid, bool success);
+
+// Clear the slots of players who left, after every script has handled the disconnect; called
+// every server tick before the results below are delivered.
+void ProcessPluginDisconnects();
+
+// Deliver finished TOTP_VerifyAsync results; called every server tick.
+void ProcessPluginVerifications();
+
+// Deliver finished TOTP_LoadAccountAsync results and report account store errors; called every
+// server tick.
+void ProcessPluginLoads();
+
+// Stop the verification workers before the plugin is unloaded.
+void StopPluginVerifications();
+
+// Seal secrets handed to scripts and the account store under a key of 64 hex digits, from
+// totp_master_key in server.cfg. Empty turns sealing off. Returns false if the key is unusable.
+bool SetPluginMasterKey(std::string_view hex);
@@ -0,0 +1,273 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-seal.hpp"
+#include "totp-crypto.hpp"
+#include <cstring>
+
+#if defined(TOTP_USE_OPENSSL)
+	#include <openssl/evp.h>
+#endif
+
+namespace
+{
+	// Bound into every tag, so blobs sealed for something else under the same key do not open.
+	constexpr uint8_t AAD[] = { 'n', 'e', 'u', 'f', 'o', 'x', '-', '2', 'f', 'a' };
+
+	constexpr size_t MAX_BLOB = TOTPSeal::NONCE_SIZE + TOTPUtils::MAX_SECRET_LENGTH + TOTPSeal::TAG_SIZE;
+
+	constexpr char BASE64URL[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+	int base64Value(char c)
+	{
+		if (c >= 'A' && c <= 'Z')
+			return c - 'A';
+		if (c >= 'a' && c <= 'z')
+			return c - 'a' + 26;
+		if (c >= '0' && c <= '9')
+			return c - '0' + 52;
+		if (c == '-')
+			return 62;
+		if (c == '_')
+			return 63;
+		return -1;
+	}
+
+	// Unpadded base64url. Returns the number of characters written.
+	size_t encode(const uint8_t* data, size_t length, char* output)
+	{
+		size_t written = 0;
+		uint32_t buffer = 0;
+		int bits = 0;
+		for (size_t i = 0; i < length; i++)
+		{
+			buffer = (buffer << 8) | data[i];
+			bits += 8;
+			while (bits >= 6)
+			{
+				bits -= 6;
+				output[written++] = BASE64URL[(buffer >> bits) & 63];
+			}
+		}
+		if (bits > 0)
+			output[written++] = BASE64URL[(buffer << (6 - bits)) & 63];
+		return written;
+	}
+
+	// Returns the number of bytes written, or 0 if the text is not base64url or too long.
+	size_t decode(std::string_view text, uint8_t* output, size_t size)
+	{
+		size_t written = 0;
+		uint32_t buffer = 0;
+		int bits = 0;
+		for (char c : text)
+		{
+			int value = base64Value(c);
+			if (value < 0)
+				return 0;
+
+			buffer = (buffer << 6) | static_cast<uint32_t>(value);
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				if (written == size)
+					return 0;
+				output[written++] = static_cast<uint8_t>(buffer >> bits);
+			}
+		}
+		return written;
+	}
+
+	int hexValue(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		return -1;
+	}
+
+#if defined(TOTP_USE_OPENSSL)
+	EVP_CIPHER_CTX* context(void* handle)
+	{
+		return static_cast<EVP_CIPHER_CTX*>(handle);
+	}
+
+	// Decrypt one blob with a context whose key is already set.
+	size_t openBlob(EVP_CIPHER_CTX* ctx, const uint8_t* blob, size_t length, char* secret, size_t size)
+	{
+		if (length <= TOTPSeal::NONCE_SIZE + TOTPSeal::TAG_SIZE)
+			return 0;
+
+		size_t cipherLength = length - TOTPSeal::NONCE_SIZE - TOTPSeal::TAG_SIZE;
+		if (cipherLength > size)
+			return 0;
+
+		const uint8_t* nonce = blob;
+		const uint8_t* cipher = blob + TOTPSeal::NONCE_SIZE;
+		uint8_t tag[TOTPSeal::TAG_SIZE];
+		std::memcpy(tag, cipher + cipherLength, sizeof(tag));
+
+		int outLength = 0;
+		int finalLength = 0;
+		bool ok = EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) == 1
+			&& EVP_DecryptUpdate(ctx, nullptr, &outLength, AAD, sizeof(AAD)) == 1
+			&& EVP_DecryptUpdate(ctx, reinterpret_cast<uint8_t*>(secret), &outLength, cipher, static_cast<int>(cipherLength)) == 1
+			&& EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, sizeof(tag), tag) == 1
+			&& EVP_DecryptFinal_ex(ctx, reinterpret_cast<uint8_t*>(secret) + outLength, &finalLength) == 1;
+
+		if (!ok)
+		{
+			std::memset(secret, 0, cipherLength);
+			return 0;
+		}
+		return static_cast<size_t>(outLength + finalLength);
+	}
+#endif
+}
+
+namespace TOTPSeal
+{
+	bool isSealed(std::string_view text)
+	{
+		return text.substr(0, SEALED_PREFIX.length()) == SEALED_PREFIX;
+	}
+
+	bool isAvailable()
+	{
+#if defined(TOTP_USE_OPENSSL)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	Sealer::~Sealer()
+	{
+		clear();
+	}
+
+	void Sealer::clear()
+	{
+#if defined(TOTP_USE_OPENSSL)
+		EVP_CIPHER_CTX_free(context(sealContext_));
+		EVP_CIPHER_CTX_free(context(openContext_));
+#endif
+		sealContext_ = nullptr;
+		openContext_ = nullptr;
+		std::memset(key_, 0, sizeof(key_));
+		enabled_ = false;
+	}
+
+	bool Sealer::setKey(std::string_view hex)
+	{
+		clear();
+		if (hex.empty())
+			return true;
+
+		if (!isAvailable() || hex.length() != KEY_SIZE * 2)
+			return false;
+
+		for (size_t i = 0; i < KEY_SIZE; i++)
+		{
+			int high = hexValue(hex[i * 2]);
+			int low = hexValue(hex[i * 2 + 1]);
+			if (high < 0 || low < 0)
+			{
+				clear();
+				return false;
+			}
+			key_[i] = static_cast<uint8_t>((high << 4) | low);
+		}
+
+#if defined(TOTP_USE_OPENSSL)
+		// Expand the key once; each secret after that only sets a nonce.
+		EVP_CIPHER_CTX* sealCtx = EVP_CIPHER_CTX_new();
+		EVP_CIPHER_CTX* openCtx = EVP_CIPHER_CTX_new();
+		sealContext_ = sealCtx;
+		openContext_ = openCtx;
+		if (!sealCtx || !openCtx
+			|| EVP_EncryptInit_ex(sealCtx, EVP_aes_256_gcm(), nullptr, key_, nullptr) != 1
+			|| EVP_DecryptInit_ex(openCtx, EVP_aes_256_gcm(), nullptr, key_, nullptr) != 1)
+		{
+			clear();
+			return false;
+		}
+#endif
+
+		enabled_ = true;
+		return true;
+	}
+
+	size_t Sealer::seal(std::string_view secret, char* output, size_t size)
+	{
+#if defined(TOTP_USE_OPENSSL)
+		if (!enabled_ || secret.empty() || secret.length() > TOTPUtils::MAX_SECRET_LENGTH)
+			return 0;
+
+		size_t blobLength = NONCE_SIZE + secret.length() + TAG_SIZE;
+		size_t textLength = SEALED_PREFIX.length() + (blobLength * 4 + 2) / 3;
+		if (textLength > size)
+			return 0;
+
+		uint8_t blob[MAX_BLOB];
+		if (!TOTPCrypto::randomBytes(blob, NONCE_SIZE))
+			return 0;
+
+		EVP_CIPHER_CTX* ctx = context(sealContext_);
+		uint8_t* cipher = blob + NONCE_SIZE;
+		int outLength = 0;
+		int finalLength = 0;
+		bool ok = EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, blob) == 1
+			&& EVP_EncryptUpdate(ctx, nullptr, &outLength, AAD, sizeof(AAD)) == 1
+			&& EVP_EncryptUpdate(ctx, cipher, &outLength, reinterpret_cast<const uint8_t*>(secret.data()), static_cast<int>(secret.length())) == 1
+			&& EVP_EncryptFinal_ex(ctx, cipher + outLength, &finalLength) == 1
+			&& EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, cipher + secret.length()) == 1;
+		if (!ok)
+			return 0;
+
+		std::memcpy(output, SEALED_PREFIX.data(), SEALED_PREFIX.length());
+		return SEALED_PREFIX.length() + encode(blob, blobLength, output + SEALED_PREFIX.length());
+#else
+		(void)secret;
+		(void)output;
+		(void)size;
+		return 0;
+#endif
+	}
+
+	size_t Sealer::open(std::string_view sealed, char* secret, size_t size)
+	{
+#if defined(TOTP_USE_OPENSSL)
+		if (!enabled_ || !isSealed(sealed))
+			return 0;
+
+		uint8_t blob[MAX_BLOB];
+		size_t length = decode(sealed.substr(SEALED_PREFIX.length()), blob, sizeof(blob));
+		return openBlob(context(openContext_), blob, length, secret, size);
+#else
+		(void)sealed;
+		(void)secret;
+		(void)size;
+		return 0;
+#endif
+	}
+
+	void Sealer::openAll(OpenRequest* requests, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			OpenRequest& request = requests[i];
+			request.secretLength = open(request.sealed, request.secret, sizeof(request.secret));
+			request.success = request.secretLength != 0;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Secrets sealed with AES-256-GCM under a server master key, so what scripts and the account
+// store keep is an opaque blob rather than the base32 secret. A sealed secret is text:
+// SEALED_PREFIX followed by base64url of the nonce, the ciphertext and the tag. Needs OpenSSL;
+// builds without it never seal and reject sealed input.
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "totp-utils.hpp"
+
+namespace TOTPSeal
+{
+	constexpr size_t KEY_SIZE = 32;
+	constexpr size_t NONCE_SIZE = 12;
+	constexpr size_t TAG_SIZE = 16;
+
+	constexpr std::string_view SEALED_PREFIX = "$gcm1$";
+
+	// Longest sealed text, for a secret of MAX_SECRET_LENGTH characters.
+	constexpr size_t MAX_SEALED_LENGTH = SEALED_PREFIX.length()
+		+ ((NONCE_SIZE + TOTPUtils::MAX_SECRET_LENGTH + TAG_SIZE) * 4 + 2) / 3;
+
+	// True if text looks like a sealed secret rather than a base32 one.
+	bool isSealed(std::string_view text);
+
+	// Whether this build can seal at all.
+	bool isAvailable();
+
+	// One of several secrets to open with openAll.
+	struct OpenRequest
+	{
+		std::string_view sealed;
+		// Filled in by openAll.
+		char secret[TOTPUtils::MAX_SECRET_LENGTH];
+		size_t secretLength;
+		bool success;
+	};
+
+	class Sealer
+	{
+	public:
+		Sealer() = default;
+		Sealer(const Sealer&) = delete;
+		Sealer& operator=(const Sealer&) = delete;
+		~Sealer();
+
+		// Set the master key from 64 hex digits. An empty key turns sealing off. Returns false
+		// and turns sealing off if the key is malformed or this build cannot seal.
+		bool setKey(std::string_view hex);
+
+		bool isEnabled() const { return enabled_; }
+
+		// Write the sealed form of secret to output. Returns its length, or 0 on failure.
+		size_t seal(std::string_view secret, char* output, size_t size);
+
+		// Recover a secret. Returns its length, or 0 if the text is not a secret sealed under
+		// this key.
+		size_t open(std::string_view sealed, char* secret, size_t size);
+
+		// Call open for each request in turn, for callers that collect the secrets first. Each is
+		// still decrypted on its own; the key schedule is expanded once in setKey either way.
+		void openAll(OpenRequest* requests, size_t count);
+
+	private:
+		bool enabled_ = false;
+		uint8_t key_[KEY_SIZE] = {};
+		// Cipher contexts with the key already expanded, created on first use.
+		void* sealContext_ = nullptr;
+		void* openContext_ = nullptr;
+
+		void clear();
+	};
+}
@@ -0,0 +1,44 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Compiled with AVX2 enabled; only called after CPU detection.
+
+#include "totp-sha1-multibuffer-impl.hpp"
+
+#if defined(TOTP_ARCH_X86)
+#include <immintrin.h>
+
+namespace
+{
+	struct AVX2
+	{
+		using Type = __m256i;
+		static constexpr size_t LANES = 8;
+
+		static Type load(const uint32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+		static void store(uint32_t* p, Type v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+		static Type set1(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+		static Type add(Type a, Type b) { return _mm256_add_epi32(a, b); }
+		static Type bxor(Type a, Type b) { return _mm256_xor_si256(a, b); }
+		static Type ch(Type b, Type c, Type d) { return _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d))); }
+		static Type parity(Type b, Type c, Type d) { return _mm256_xor_si256(_mm256_xor_si256(b, c), d); }
+		static Type maj(Type b, Type c, Type d) { return _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c))); }
+
+		template <int N>
+		static Type rotl(Type v) { return _mm256_or_si256(_mm256_slli_epi32(v, N), _mm256_srli_epi32(v, 32 - N)); }
+	};
+}
+
+namespace SHA1MultiBuffer::Detail
+{
+	void hmacCountersAVX2(const Job* jobs, size_t count, uint32_t (*digests)[5])
+	{
+		hmacCounters<AVX2>(jobs, count, digests);
+	}
+}
+#endif
@@ -0,0 +1,44 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Compiled with AVX-512F enabled; only called after CPU detection.
+
+#include "totp-sha1-multibuffer-impl.hpp"
+
+#if defined(TOTP_ARCH_X86)
+#include <immintrin.h>
+
+namespace
+{
+	struct AVX512
+	{
+		using Type = __m512i;
+		static constexpr size_t LANES = 16;
+
+		static Type load(const uint32_t* p) { return _mm512_load_si512(p); }
+		static void store(uint32_t* p, Type v) { _mm512_store_si512(p, v); }
+		static Type set1(uint32_t v) { return _mm512_set1_epi32(static_cast<int>(v)); }
+		static Type add(Type a, Type b) { return _mm512_add_epi32(a, b); }
+		static Type bxor(Type a, Type b) { return _mm512_xor_si512(a, b); }
+		static Type ch(Type b, Type c, Type d) { return _mm512_ternarylogic_epi32(b, c, d, 0xCA); }
+		static Type parity(Type b, Type c, Type d) { return _mm512_ternarylogic_epi32(b, c, d, 0x96); }
+		static Type maj(Type b, Type c, Type d) { return _mm512_ternarylogic_epi32(b, c, d, 0xE8); }
+
+		template <int N>
+		static Type rotl(Type v) { return _mm512_rol_epi32(v, N); }
+	};
+}
+
+namespace SHA1MultiBuffer::Detail
+{
+	void hmacCountersAVX512(const Job* jobs, size_t count, uint32_t (*digests)[5])
+	{
+		hmacCounters<AVX512>(jobs, count, digests);
+	}
+}
+#endif
@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Lane-generic SHA-1 used by the multi-buffer kernels. Each kernel translation unit
+// is compiled for its own instruction set and instantiates these templates with a
+// vector type, so nothing in here may pull in inline code from the standard library.
+
+#include "totp-cpu.hpp"
+#include "totp-sha1-multibuffer.hpp"
+
+namespace SHA1MultiBuffer
+{
+	namespace Detail
+	{
+		// Message length in bits of the single block hashed on each side of the HMAC.
+		constexpr uint32_t INNER_BITS = (64 + 8) * 8;
+		constexpr uint32_t OUTER_BITS = (64 + 20) * 8;
+
+		template <class V>
+		inline void compress(uint32_t (*state)[V::LANES], const uint32_t (*block)[V::LANES])
+		{
+			using T = typename V::Type;
+
+			T w[16];
+			for (int i = 0; i < 16; i++)
+				w[i] = V::load(block[i]);
+
+			T a = V::load(state[0]);
+			T b = V::load(state[1]);
+			T c = V::load(state[2]);
+			T d = V::load(state[3]);
+			T e = V::load(state[4]);
+
+			auto schedule = [&w](int t) {
+				if (t >= 16)
+					w[t & 15] = V::template rotl<1>(V::bxor(V::bxor(w[(t - 3) & 15], w[(t - 8) & 15]), V::bxor(w[(t - 14) & 15], w[t & 15])));
+				return w[t & 15];
+			};
+
+			auto round = [&](T f, T k, T wt) {
+				T temp = V::add(V::add(V::template rotl<5>(a), f), V::add(V::add(e, k), wt));
+				e = d;
+				d = c;
+				c = V::template rotl<30>(b);
+				b = a;
+				a = temp;
+			};
+
+			const T k0 = V::set1(0x5A827999);
+			const T k1 = V::set1(0x6ED9EBA1);
+			const T k2 = V::set1(0x8F1BBCDC);
+			const T k3 = V::set1(0xCA62C1D6);
+
+			for (int t = 0; t < 20; t++)
+				round(V::ch(b, c, d), k0, schedule(t));
+			for (int t = 20; t < 40; t++)
+				round(V::parity(b, c, d), k1, schedule(t));
+			for (int t = 40; t < 60; t++)
+				round(V::maj(b, c, d), k2, schedule(t));
+			for (int t = 60; t < 80; t++)
+				round(V::parity(b, c, d), k3, schedule(t));
+
+			V::store(state[0], V::add(V::load(state[0]), a));
+			V::store(state[1], V::add(V::load(state[1]), b));
+			V::store(state[2], V::add(V::load(state[2]), c));
+			V::store(state[3], V::add(V::load(state[3]), d));
+			V::store(state[4], V::add(V::load(state[4]), e));
+		}
+
+		// Hashes up to V::LANES jobs in one pass. Spare lanes repeat the last job and are discarded.
+		template <class V>
+		inline void hmacChunk(const Job* jobs, size_t count, uint32_t (*digests)[5])
+		{
+			constexpr size_t L = V::LANES;
+			alignas(64) uint32_t state[5][L];
+			alignas(64) uint32_t block[16][L];
+
+			for (size_t lane = 0; lane < L; lane++)
+			{
+				const Job& job = jobs[lane < count ? lane : count - 1];
+				for (int i = 0; i < 5; i++)
+					state[i][lane] = job.inner[i];
+
+				block[0][lane] = static_cast<uint32_t>(job.counter >> 32);
+				block[1][lane] = static_cast<uint32_t>(job.counter);
+				block[2][lane] = 0x80000000;
+				for (int i = 3; i < 15; i++)
+					block[i][lane] = 0;
+				block[15][lane] = INNER_BITS;
+			}
+
+			compress<V>(state, block);
+
+			for (size_t lane = 0; lane < L; lane++)
+			{
+				const Job& job = jobs[lane < count ? lane : count - 1];
+				for (int i = 0; i < 5; i++)
+				{
+					block[i][lane] = state[i][lane];
+					state[i][lane] = job.outer[i];
+				}
+
+				block[5][lane] = 0x80000000;
+				for (int i = 6; i < 15; i++)
+					block[i][lane] = 0;
+				block[15][lane] = OUTER_BITS;
+			}
+
+			compress<V>(state, block);
+
+			for (size_t lane = 0; lane < count && lane < L; lane++)
+			{
+				for (int i = 0; i < 5; i++)
+					digests[lane][i] = state[i][lane];
+			}
+		}
+
+		template <class V>
+		inline void hmacCounters(const Job* jobs, size_t count, uint32_t (*digests)[5])
+		{
+			for (size_t i = 0; i < count; i += V::LANES)
+			{
+				size_t chunk = count - i < V::LANES ? count - i : V::LANES;
+				hmacChunk<V>(jobs + i, chunk, digests + i);
+			}
+		}
+
+#if defined(TOTP_ARCH_X86)
+		void hmacCountersSSE2(const Job* jobs, size_t count, uint32_t (*digests)[5]);
+		void hmacCountersAVX2(const Job* jobs, size_t count, uint32_t (*digests)[5]);
+		void hmacCountersAVX512(const Job* jobs, size_t count, uint32_t (*digests)[5]);
+#endif
+	}
+}
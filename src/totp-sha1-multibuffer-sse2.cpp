@@ -0,0 +1,44 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Compiled with SSE2 enabled; only called after CPU detection.
+
+#include "totp-sha1-multibuffer-impl.hpp"
+
+#if defined(TOTP_ARCH_X86)
+#include <emmintrin.h>
+
+namespace
+{
+	struct SSE2
+	{
+		using Type = __m128i;
+		static constexpr size_t LANES = 4;
+
+		static Type load(const uint32_t* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+		static void store(uint32_t* p, Type v) { _mm_store_si128(reinterpret_cast<__m128i*>(p), v); }
+		static Type set1(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+		static Type add(Type a, Type b) { return _mm_add_epi32(a, b); }
+		static Type bxor(Type a, Type b) { return _mm_xor_si128(a, b); }
+		static Type ch(Type b, Type c, Type d) { return _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d))); }
+		static Type parity(Type b, Type c, Type d) { return _mm_xor_si128(_mm_xor_si128(b, c), d); }
+		static Type maj(Type b, Type c, Type d) { return _mm_or_si128(_mm_and_si128(b, c), _mm_and_si128(d, _mm_or_si128(b, c))); }
+
+		template <int N>
+		static Type rotl(Type v) { return _mm_or_si128(_mm_slli_epi32(v, N), _mm_srli_epi32(v, 32 - N)); }
+	};
+}
+
+namespace SHA1MultiBuffer::Detail
+{
+	void hmacCountersSSE2(const Job* jobs, size_t count, uint32_t (*digests)[5])
+	{
+		hmacCounters<SSE2>(jobs, count, digests);
+	}
+}
+#endif
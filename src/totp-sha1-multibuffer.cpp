@@ -0,0 +1,74 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-sha1-multibuffer-impl.hpp"
+
+namespace
+{
+	struct Scalar
+	{
+		using Type = uint32_t;
+		static constexpr size_t LANES = 1;
+
+		static Type load(const uint32_t* p) { return *p; }
+		static void store(uint32_t* p, Type v) { *p = v; }
+		static Type set1(uint32_t v) { return v; }
+		static Type add(Type a, Type b) { return a + b; }
+		static Type bxor(Type a, Type b) { return a ^ b; }
+		static Type ch(Type b, Type c, Type d) { return d ^ (b & (c ^ d)); }
+		static Type parity(Type b, Type c, Type d) { return b ^ c ^ d; }
+		static Type maj(Type b, Type c, Type d) { return (b & c) | (d & (b | c)); }
+
+		template <int N>
+		static Type rotl(Type v) { return (v << N) | (v >> (32 - N)); }
+	};
+
+	using Kernel = void (*)(const SHA1MultiBuffer::Job*, size_t, uint32_t (*)[5]);
+
+	struct Selection
+	{
+		Kernel kernel;
+		size_t lanes;
+	};
+
+	Selection select()
+	{
+#if defined(TOTP_ARCH_X86)
+		const TOTPCpu::Features& cpu = TOTPCpu::features();
+		if (cpu.avx512f)
+			return { SHA1MultiBuffer::Detail::hmacCountersAVX512, 16 };
+		if (cpu.avx2)
+			return { SHA1MultiBuffer::Detail::hmacCountersAVX2, 8 };
+		if (cpu.sse2)
+			return { SHA1MultiBuffer::Detail::hmacCountersSSE2, 4 };
+#endif
+		return { SHA1MultiBuffer::Detail::hmacCounters<Scalar>, 1 };
+	}
+
+	const Selection& selected()
+	{
+		static const Selection selection = select();
+		return selection;
+	}
+}
+
+namespace SHA1MultiBuffer
+{
+	void hmacCounters(const Job* jobs, size_t count, uint32_t (*digests)[5])
+	{
+		if (count == 0)
+			return;
+
+		selected().kernel(jobs, count, digests);
+	}
+
+	size_t lanes()
+	{
+		return selected().lanes;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SHA1MultiBuffer
+{
+	// Widest kernel we ship (AVX-512, 16 x 32-bit lanes).
+	constexpr size_t MAX_LANES = 16;
+
+	// One HMAC-SHA1 over an 8-byte big-endian counter, starting from pre-keyed states.
+	struct Job
+	{
+		uint32_t inner[5];
+		uint32_t outer[5];
+		uint64_t counter;
+	};
+
+	// Runs every job through the widest kernel the CPU supports, falling back to one lane at a time.
+	// Digests are written as the five SHA-1 state words.
+	void hmacCounters(const Job* jobs, size_t count, uint32_t (*digests)[5]);
+
+	// Lane count of the kernel selected for this CPU.
+	size_t lanes();
+}
@@ -0,0 +1,371 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-sqlite.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(TOTP_USE_SQLITE)
+	#include <sqlite3.h>
+#endif
+
+namespace
+{
+#if defined(TOTP_USE_SQLITE)
+	constexpr const char* SCHEMA =
+		"CREATE TABLE IF NOT EXISTS totp_accounts ("
+		"account TEXT NOT NULL PRIMARY KEY COLLATE NOCASE, "
+		"secret TEXT NOT NULL, "
+		"algorithm INTEGER NOT NULL, "
+		"digits INTEGER NOT NULL, "
+		"period INTEGER NOT NULL"
+		") WITHOUT ROWID";
+
+	constexpr const char* SELECT_SQL = "SELECT secret, algorithm, digits, period FROM totp_accounts WHERE account = ?1";
+	constexpr const char* UPSERT_SQL = "INSERT OR REPLACE INTO totp_accounts (account, secret, algorithm, digits, period) VALUES (?1, ?2, ?3, ?4, ?5)";
+	constexpr const char* DELETE_SQL = "DELETE FROM totp_accounts WHERE account = ?1";
+
+	// How long a statement waits for a lock held by another connection, such as an outside
+	// tool reading the WAL, before it fails with SQLITE_BUSY.
+	constexpr int BUSY_TIMEOUT_MS = 2000;
+
+	// Batches a write is tried in before it is given up on.
+	constexpr int MAX_COMMIT_ATTEMPTS = 5;
+
+	sqlite3* database(void* handle)
+	{
+		return static_cast<sqlite3*>(handle);
+	}
+
+	sqlite3_stmt* statement(void* handle)
+	{
+		return static_cast<sqlite3_stmt*>(handle);
+	}
+
+	bool prepare(sqlite3* db, const char* sql, void*& handle)
+	{
+		sqlite3_stmt* stmt = nullptr;
+		if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+			return false;
+		handle = stmt;
+		return true;
+	}
+
+	// Run a statement to completion and make it ready for the next use.
+	bool step(sqlite3_stmt* stmt)
+	{
+		int result = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		return result == SQLITE_DONE;
+	}
+
+	void bindAccount(sqlite3_stmt* stmt, std::string_view account)
+	{
+		sqlite3_bind_text(stmt, 1, account.data(), static_cast<int>(account.length()), SQLITE_STATIC);
+	}
+#endif
+}
+
+namespace TOTPSQLite
+{
+	bool isAvailable()
+	{
+#if defined(TOTP_USE_SQLITE)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	AccountDatabase::~AccountDatabase()
+	{
+		close();
+	}
+
+	bool AccountDatabase::open(const std::string& path, std::chrono::milliseconds commitInterval)
+	{
+		close();
+
+#if defined(TOTP_USE_SQLITE)
+		sqlite3* db = nullptr;
+		if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK)
+		{
+			sqlite3_close(db);
+			return false;
+		}
+		connection_ = db;
+		sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+
+		// WAL lets outside tools read while the server writes; commits are batched, so syncing
+		// at checkpoints only is enough.
+		bool ready = sqlite3_exec(db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL", nullptr, nullptr, nullptr) == SQLITE_OK
+			&& sqlite3_exec(db, SCHEMA, nullptr, nullptr, nullptr) == SQLITE_OK
+			&& prepare(db, SELECT_SQL, selectStatement_)
+			&& prepare(db, UPSERT_SQL, upsertStatement_)
+			&& prepare(db, DELETE_SQL, deleteStatement_);
+		if (!ready)
+		{
+			release();
+			return false;
+		}
+
+		// From here on only the I/O thread touches the connection.
+		commitInterval_ = commitInterval;
+		stopping_ = false;
+		loadQueued_ = false;
+		thread_ = std::thread(&AccountDatabase::run, this);
+		return true;
+#else
+		(void)path;
+		(void)commitInterval;
+		return false;
+#endif
+	}
+
+	void AccountDatabase::close()
+	{
+		if (thread_.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			wake_.notify_one();
+			thread_.join();
+		}
+
+		release();
+
+		for (LoadJob& job : completed_)
+			job.entry.clear();
+		completed_.clear();
+		collected_.clear();
+	}
+
+	void AccountDatabase::release()
+	{
+#if defined(TOTP_USE_SQLITE)
+		sqlite3_finalize(statement(selectStatement_));
+		sqlite3_finalize(statement(upsertStatement_));
+		sqlite3_finalize(statement(deleteStatement_));
+		sqlite3_close(database(connection_));
+#endif
+		selectStatement_ = nullptr;
+		upsertStatement_ = nullptr;
+		deleteStatement_ = nullptr;
+		connection_ = nullptr;
+	}
+
+	bool AccountDatabase::store(std::string_view account, const TOTPStore::Entry& entry)
+	{
+		if (entry.secretLength == 0 || entry.secretLength > sizeof(entry.secret))
+			return false;
+
+		return enqueue(Operation::Store, account, &entry, 0, -1);
+	}
+
+	bool AccountDatabase::remove(std::string_view account)
+	{
+		return enqueue(Operation::Remove, account, nullptr, 0, -1);
+	}
+
+	bool AccountDatabase::load(uint64_t ticket, int playerID, std::string_view account)
+	{
+		return enqueue(Operation::Load, account, nullptr, ticket, playerID);
+	}
+
+	bool AccountDatabase::enqueue(Operation operation, std::string_view account, const TOTPStore::Entry* entry, uint64_t ticket, int playerID)
+	{
+		if (!isOpen() || account.empty() || account.length() > TOTPStore::MAX_ACCOUNT_LENGTH)
+			return false;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			pending_.emplace_back();
+			Request& request = pending_.back();
+			request.operation = operation;
+			request.job.ticket = ticket;
+			request.job.playerID = playerID;
+			std::memcpy(request.job.account, account.data(), account.length());
+			request.job.accountLength = account.length();
+			request.job.found = false;
+			if (entry)
+				request.job.entry = *entry;
+
+			if (operation == Operation::Load)
+				loadQueued_ = true;
+		}
+
+		// Writes wait for the commit interval so they share a transaction; a player waits on a load.
+		if (operation == Operation::Load)
+			wake_.notify_one();
+		return true;
+	}
+
+	void AccountDatabase::run()
+	{
+		std::vector<Request> batch;
+		std::vector<LoadJob> loaded;
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			wake_.wait_for(lock, commitInterval_, [this] { return stopping_ || loadQueued_; });
+			bool stopping = stopping_;
+
+			// Swap rather than copy, so the main thread waits for the lock at most this long.
+			// Writes left from a failed commit stay first, ahead of anything queued since.
+			if (batch.empty())
+			{
+				batch.swap(pending_);
+			}
+			else
+			{
+				batch.insert(batch.end(), pending_.begin(), pending_.end());
+				for (Request& request : pending_)
+					request.job.entry.clear();
+				pending_.clear();
+			}
+			loadQueued_ = false;
+			lock.unlock();
+
+			execute(batch, loaded);
+
+			lock.lock();
+			completed_.insert(completed_.end(), loaded.begin(), loaded.end());
+			for (LoadJob& job : loaded)
+				job.entry.clear();
+			loaded.clear();
+
+			// On the way out, writes that failed are retried until they commit or are given up on.
+			if (stopping && batch.empty())
+				break;
+		}
+	}
+
+	bool AccountDatabase::takeError(std::string& message)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (error_.empty())
+			return false;
+
+		message.swap(error_);
+		error_.clear();
+		return true;
+	}
+
+	void AccountDatabase::reportError(const char* what, size_t changes, bool dropped)
+	{
+		char message[256];
+		std::snprintf(message, sizeof(message), "%s; %zu change(s) %s", what, changes,
+			dropped ? "were lost" : "will be retried with the next commit");
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		error_ = message;
+	}
+
+	void AccountDatabase::execute(std::vector<Request>& batch, std::vector<LoadJob>& loaded)
+	{
+		if (batch.empty())
+			return;
+
+#if defined(TOTP_USE_SQLITE)
+		sqlite3* db = database(connection_);
+		sqlite3_stmt* select = statement(selectStatement_);
+		sqlite3_stmt* upsert = statement(upsertStatement_);
+		sqlite3_stmt* erase = statement(deleteStatement_);
+
+		// One transaction for the whole batch, in the order the requests were made, so a load
+		// sees every change queued before it.
+		const char* failed = nullptr;
+		if (sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK)
+			failed = "BEGIN";
+
+		for (Request& request : batch)
+		{
+			LoadJob& job = request.job;
+			switch (request.operation)
+			{
+			case Operation::Store:
+				bindAccount(upsert, job.getAccount());
+				sqlite3_bind_text(upsert, 2, job.entry.secret, static_cast<int>(job.entry.secretLength), SQLITE_STATIC);
+				sqlite3_bind_int(upsert, 3, static_cast<int>(job.entry.params.algorithm));
+				sqlite3_bind_int(upsert, 4, job.entry.params.digits);
+				sqlite3_bind_int(upsert, 5, job.entry.params.period);
+				if (!step(upsert) && !failed)
+					failed = "storing an account";
+				break;
+
+			case Operation::Remove:
+				bindAccount(erase, job.getAccount());
+				if (!step(erase) && !failed)
+					failed = "removing an account";
+				break;
+
+			case Operation::Load:
+				bindAccount(select, job.getAccount());
+				if (sqlite3_step(select) == SQLITE_ROW)
+				{
+					const char* secret = reinterpret_cast<const char*>(sqlite3_column_text(select, 0));
+					size_t secretLength = static_cast<size_t>(sqlite3_column_bytes(select, 0));
+					if (secret && secretLength <= sizeof(job.entry.secret))
+					{
+						std::memcpy(job.entry.secret, secret, secretLength);
+						job.entry.secretLength = secretLength;
+						job.entry.params.algorithm = static_cast<TOTPUtils::Algorithm>(sqlite3_column_int(select, 1));
+						job.entry.params.digits = sqlite3_column_int(select, 2);
+						job.entry.params.period = sqlite3_column_int(select, 3);
+						job.found = true;
+					}
+				}
+				sqlite3_reset(select);
+				sqlite3_clear_bindings(select);
+				loaded.push_back(job);
+				job.entry.clear();
+				break;
+			}
+		}
+
+		if (!failed && sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK)
+			failed = "COMMIT";
+
+		// Loads are answered either way; only the writes are kept to be tried again.
+		auto isLoad = [](const Request& request)
+		{
+			return request.operation == Operation::Load;
+		};
+		batch.erase(std::remove_if(batch.begin(), batch.end(), isLoad), batch.end());
+
+		if (failed)
+		{
+			char what[160];
+			std::snprintf(what, sizeof(what), "%s failed: %s", failed, sqlite3_errmsg(db));
+			if (!sqlite3_get_autocommit(db))
+				sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+
+			if (batch.empty())
+				return;
+
+			bool giveUp = ++failedCommits_ >= MAX_COMMIT_ATTEMPTS;
+			reportError(what, batch.size(), giveUp);
+			if (!giveUp)
+				return;
+		}
+		failedCommits_ = 0;
+
+		// Requests carry secrets.
+		for (Request& request : batch)
+			request.job.entry.clear();
+#else
+		(void)loaded;
+#endif
+
+		batch.clear();
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Accounts kept in an SQLite database instead of the mapped account store, for servers that
+// want to query them with their own tools. One I/O thread owns the connection and its prepared
+// statements. The main thread only queues changes and loads; the thread runs everything queued
+// in one transaction, and finished loads are collected on the main thread's tick like
+// asynchronous verifications. Needs a build with USE_SQLITE; other builds never open.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "totp-store.hpp"
+
+namespace TOTPSQLite
+{
+	// A load queued by the main thread, and its result once the I/O thread has run it.
+	struct LoadJob
+	{
+		// Matched against the player's pending load when the result comes back.
+		uint64_t ticket;
+		int playerID;
+		char account[TOTPStore::MAX_ACCOUNT_LENGTH];
+		size_t accountLength;
+		bool found;
+		TOTPStore::Entry entry;
+
+		std::string_view getAccount() const
+		{
+			return std::string_view(account, accountLength);
+		}
+	};
+
+	// Whether this build has the SQLite backend at all.
+	bool isAvailable();
+
+	class AccountDatabase
+	{
+	public:
+		AccountDatabase() = default;
+		AccountDatabase(const AccountDatabase&) = delete;
+		AccountDatabase& operator=(const AccountDatabase&) = delete;
+		~AccountDatabase();
+
+		// Open or create the database, prepare the statements and start the I/O thread. Writes
+		// are committed at most commitInterval after they are queued; loads wake it at once.
+		bool open(const std::string& path, std::chrono::milliseconds commitInterval);
+
+		// Commit what is queued and stop the I/O thread. Loads not yet collected are dropped.
+		void close();
+
+		bool isOpen() const { return thread_.joinable(); }
+
+		// Queue a change. Fails if the name is empty or too long, or the secret is.
+		bool store(std::string_view account, const TOTPStore::Entry& entry);
+
+		bool remove(std::string_view account);
+
+		// Queue a load. Its result comes back through drain.
+		bool load(uint64_t ticket, int playerID, std::string_view account);
+
+		// The last error the I/O thread hit since the previous call, if any, for the main thread
+		// to log; the thread itself has no logger.
+		bool takeError(std::string& message);
+
+		// Call handler for every finished load, oldest first. Main thread only.
+		template <class Handler>
+		void drain(Handler&& handler)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (completed_.empty())
+					return;
+				collected_.swap(completed_);
+			}
+
+			for (LoadJob& job : collected_)
+			{
+				handler(job);
+				job.entry.clear();
+			}
+			collected_.clear();
+		}
+
+	private:
+		enum class Operation : uint8_t
+		{
+			Store,
+			Remove,
+			Load
+		};
+
+		struct Request
+		{
+			Operation operation;
+			LoadJob job;
+		};
+
+		// Owned by the I/O thread once it is running.
+		void* connection_ = nullptr;
+		void* selectStatement_ = nullptr;
+		void* upsertStatement_ = nullptr;
+		void* deleteStatement_ = nullptr;
+
+		std::thread thread_;
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::chrono::milliseconds commitInterval_ { TOTPJournal::DEFAULT_COMMIT_INTERVAL };
+		bool stopping_ = false;
+		bool loadQueued_ = false;
+
+		// Requests in the order they were made, and finished loads. Guarded by mutex_.
+		std::vector<Request> pending_;
+		std::vector<LoadJob> completed_;
+		std::string error_;
+
+		// Batches in a row whose writes could not be committed. I/O thread only.
+		int failedCommits_ = 0;
+
+		// Main thread only.
+		std::vector<LoadJob> collected_;
+
+		void run();
+
+		// Run one batch in a single transaction. If it cannot be committed, its writes are left in
+		// batch to be tried again ahead of the next one, up to MAX_COMMIT_ATTEMPTS times.
+		// I/O thread only.
+		void execute(std::vector<Request>& batch, std::vector<LoadJob>& loaded);
+
+		void reportError(const char* what, size_t changes, bool dropped);
+
+		bool enqueue(Operation operation, std::string_view account, const TOTPStore::Entry* entry, uint64_t ticket, int playerID);
+
+		void release();
+	};
+}
@@ -0,0 +1,679 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+#include "totp-store.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TOTPStore
+{
+	namespace
+	{
+		constexpr char MAGIC[8] = { 'N', 'F', 'X', '2', 'F', 'A', 'S', 'T' };
+		// Version 2 made room for sealed secrets.
+		constexpr uint32_t VERSION = 2;
+
+		// The header takes a page of its own so records never straddle pages.
+		constexpr size_t HEADER_SIZE = 4096;
+		constexpr size_t RECORD_SIZE = 256;
+		constexpr uint64_t INITIAL_CAPACITY = 1024;
+
+		// Journal records: the change, account and secret lengths, algorithm, digits and period
+		// (two bytes, little-endian), then the account name and secret.
+		constexpr size_t JOURNAL_HEADER = 7;
+
+		enum ChangeType : uint8_t
+		{
+			CHANGE_STORE = 1,
+			CHANGE_REMOVE = 2,
+		};
+
+		enum RecordState : uint8_t
+		{
+			RECORD_EMPTY = 0,
+			RECORD_USED = 1,
+			RECORD_DELETED = 2,
+		};
+
+		char lower(char c)
+		{
+			return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+
+		bool sameAccount(const char* stored, size_t length, std::string_view account)
+		{
+			if (length != account.length())
+				return false;
+
+			for (size_t i = 0; i < length; i++)
+			{
+				if (lower(stored[i]) != lower(account[i]))
+					return false;
+			}
+			return true;
+		}
+
+		uint64_t newSeed()
+		{
+			std::random_device device;
+			return (static_cast<uint64_t>(device()) << 32) | device();
+		}
+	}
+
+	// Fields are only ever read and written through the mapping, in the machine's byte order.
+	struct AccountStore::Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t recordSize;
+		// Records in the table; a power of two.
+		uint64_t capacity;
+		uint64_t used;
+		uint64_t deleted;
+		// Keys the hash, so account names cannot be chosen to collide.
+		uint64_t seed;
+	};
+
+	struct AccountStore::Record
+	{
+		uint64_t hash;
+		uint8_t state;
+		uint8_t accountLength;
+		uint8_t secretLength;
+		uint8_t algorithm;
+		uint8_t digits;
+		uint8_t reserved;
+		uint16_t period;
+		char account[MAX_ACCOUNT_LENGTH];
+		char secret[MAX_STORED_SECRET_LENGTH];
+	};
+
+	void Entry::clear()
+	{
+		std::memset(secret, 0, sizeof(secret));
+		secretLength = 0;
+	}
+
+	// ------------------------------------------------------------------------
+	// MappedFile
+	// ------------------------------------------------------------------------
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(const std::string& path, size_t minSize)
+	{
+		close();
+
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		uint64_t length = std::max<uint64_t>(static_cast<uint64_t>(size.QuadPart), minSize);
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(length >> 32), static_cast<DWORD>(length), nullptr);
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		if (!view)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		file_ = file;
+		mapping_ = mapping;
+		data_ = static_cast<unsigned char*>(view);
+		size_ = static_cast<size_t>(length);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (data_)
+		{
+			if (flushOnClose_)
+				FlushViewOfFile(data_, 0);
+			UnmapViewOfFile(data_);
+			CloseHandle(static_cast<HANDLE>(mapping_));
+			CloseHandle(static_cast<HANDLE>(file_));
+		}
+		data_ = nullptr;
+		size_ = 0;
+		file_ = nullptr;
+		mapping_ = nullptr;
+	}
+
+	void MappedFile::flush()
+	{
+		if (data_)
+		{
+			FlushViewOfFile(data_, 0);
+			FlushFileBuffers(static_cast<HANDLE>(file_));
+		}
+	}
+#else
+	bool MappedFile::open(const std::string& path, size_t minSize)
+	{
+		close();
+
+		int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		size_t length = static_cast<size_t>(info.st_size);
+		if (length < minSize)
+		{
+			if (ftruncate(fd, static_cast<off_t>(minSize)) != 0)
+			{
+				::close(fd);
+				return false;
+			}
+			length = minSize;
+		}
+
+		void* view = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			::close(fd);
+			return false;
+		}
+
+		fd_ = fd;
+		data_ = static_cast<unsigned char*>(view);
+		size_ = length;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (data_)
+		{
+			if (flushOnClose_)
+				msync(data_, size_, MS_SYNC);
+			munmap(data_, size_);
+			::close(fd_);
+		}
+		data_ = nullptr;
+		size_ = 0;
+		fd_ = -1;
+	}
+
+	void MappedFile::flush()
+	{
+		if (data_)
+			msync(data_, size_, MS_SYNC);
+	}
+#endif
+
+	// ------------------------------------------------------------------------
+	// AccountStore
+	// ------------------------------------------------------------------------
+
+	AccountStore::~AccountStore()
+	{
+		close();
+	}
+
+	AccountStore::Header& AccountStore::header() const
+	{
+		return *reinterpret_cast<Header*>(file_->data());
+	}
+
+	AccountStore::Record* AccountStore::records() const
+	{
+		static_assert(sizeof(Record) == RECORD_SIZE, "records must pack evenly into pages");
+		static_assert(HEADER_SIZE % RECORD_SIZE == 0, "records must start on a record boundary");
+
+		return reinterpret_cast<Record*>(file_->data() + HEADER_SIZE);
+	}
+
+	bool AccountStore::isValid() const
+	{
+		const Header& h = header();
+		return std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) == 0
+			&& h.version == VERSION
+			&& h.recordSize == RECORD_SIZE
+			&& h.capacity != 0
+			&& (h.capacity & (h.capacity - 1)) == 0
+			&& file_->size() == HEADER_SIZE + h.capacity * RECORD_SIZE
+			&& h.used + h.deleted <= h.capacity;
+	}
+
+	bool AccountStore::map()
+	{
+		// An empty file is what a crash between creating and sizing a new store leaves behind.
+		std::error_code error;
+		bool created = !std::filesystem::exists(path_, error) || std::filesystem::file_size(path_, error) == 0;
+
+		size_t initialSize = HEADER_SIZE + INITIAL_CAPACITY * RECORD_SIZE;
+		auto file = std::make_shared<MappedFile>();
+		if (!file->open(path_, created ? initialSize : 0))
+			return false;
+
+		file_ = std::move(file);
+
+		if (created)
+		{
+			Header& h = header();
+			std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+			h.version = VERSION;
+			h.recordSize = RECORD_SIZE;
+			h.capacity = INITIAL_CAPACITY;
+			h.used = 0;
+			h.deleted = 0;
+			h.seed = newSeed();
+			file_->flush();
+		}
+		else if (file_->size() < HEADER_SIZE || !isValid())
+		{
+			file_.reset();
+			return false;
+		}
+		return true;
+	}
+
+	bool AccountStore::open(const std::string& path, std::chrono::milliseconds commitInterval)
+	{
+		close();
+
+		path_ = path;
+		if (!map())
+			return false;
+
+		// Changes after the last checkpoint are only in the journal. Replaying is safe even for
+		// changes that did reach the table, as each one sets an account to a given state.
+		std::string journalPath = path_ + ".journal";
+		size_t replayed = TOTPJournal::Journal::replay(journalPath, [this](const unsigned char* data, size_t length)
+		{
+			replayRecord(data, length);
+		});
+
+		if (replayed != 0)
+		{
+			recount();
+			file_->flush();
+		}
+
+		if (!journal_.open(journalPath, commitInterval, [this] { checkpoint(); }))
+		{
+			file_.reset();
+			return false;
+		}
+		return true;
+	}
+
+	void AccountStore::close()
+	{
+		// The journal checkpoints on the way out, so it needs the mapping until it is done.
+		journal_.close();
+		file_.reset();
+	}
+
+	void AccountStore::checkpoint()
+	{
+#ifdef _WIN32
+		std::lock_guard<std::mutex> syncing(syncMutex_);
+#endif
+		// Only held to take a reference, never across the sync.
+		std::shared_ptr<MappedFile> file;
+		{
+			std::lock_guard<std::mutex> lock(mappingMutex_);
+			file = file_;
+		}
+
+		if (file)
+			file->flush();
+	}
+
+	void AccountStore::recount()
+	{
+		Header& h = header();
+		const Record* table = records();
+		h.used = 0;
+		h.deleted = 0;
+		for (uint64_t i = 0; i < h.capacity; i++)
+		{
+			if (table[i].state == RECORD_USED)
+				h.used++;
+			else if (table[i].state == RECORD_DELETED)
+				h.deleted++;
+		}
+	}
+
+	size_t AccountStore::count() const
+	{
+		return isOpen() ? static_cast<size_t>(header().used) : 0;
+	}
+
+	size_t AccountStore::forEach(const Visitor& visit) const
+	{
+		if (!isOpen())
+			return 0;
+
+		size_t visited = 0;
+		Entry entry;
+		const Record* table = records();
+		for (uint64_t i = 0; i < header().capacity; i++)
+		{
+			const Record& record = table[i];
+			if (record.state != RECORD_USED || record.secretLength > sizeof(entry.secret) || record.accountLength > MAX_ACCOUNT_LENGTH)
+				continue;
+
+			std::memcpy(entry.secret, record.secret, record.secretLength);
+			entry.secretLength = record.secretLength;
+			entry.params.algorithm = static_cast<TOTPUtils::Algorithm>(record.algorithm);
+			entry.params.digits = record.digits;
+			entry.params.period = record.period;
+			visit(std::string_view(record.account, record.accountLength), entry);
+			visited++;
+		}
+
+		entry.clear();
+		return visited;
+	}
+
+	uint64_t AccountStore::hash(std::string_view account) const
+	{
+		// FNV-1a over the lower-cased name, finished with a splitmix round keyed by the seed.
+		uint64_t h = 14695981039346656037ull;
+		for (char c : account)
+		{
+			h ^= static_cast<unsigned char>(lower(c));
+			h *= 1099511628211ull;
+		}
+
+		h ^= header().seed;
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+		return h ^ (h >> 31);
+	}
+
+	AccountStore::Record* AccountStore::lookup(std::string_view account, uint64_t hash, Record** insert) const
+	{
+		Record* table = records();
+		uint64_t mask = header().capacity - 1;
+		if (insert)
+			*insert = nullptr;
+
+		// The table is never more than half full, so an empty record is always reached.
+		for (uint64_t i = hash & mask;; i = (i + 1) & mask)
+		{
+			Record& record = table[i];
+			if (record.state == RECORD_EMPTY)
+			{
+				if (insert && !*insert)
+					*insert = &record;
+				return nullptr;
+			}
+
+			if (record.state == RECORD_DELETED)
+			{
+				if (insert && !*insert)
+					*insert = &record;
+				continue;
+			}
+
+			if (record.hash == hash && sameAccount(record.account, record.accountLength, account))
+				return &record;
+		}
+	}
+
+	bool AccountStore::find(std::string_view account, Entry& entry) const
+	{
+		if (!isOpen() || account.empty() || account.length() > MAX_ACCOUNT_LENGTH)
+			return false;
+
+		const Record* record = lookup(account, hash(account), nullptr);
+		if (!record || record->secretLength > sizeof(entry.secret))
+			return false;
+
+		std::memcpy(entry.secret, record->secret, record->secretLength);
+		entry.secretLength = record->secretLength;
+		entry.params.algorithm = static_cast<TOTPUtils::Algorithm>(record->algorithm);
+		entry.params.digits = record->digits;
+		entry.params.period = record->period;
+		return true;
+	}
+
+	bool AccountStore::store(std::string_view account, const Entry& entry)
+	{
+		if (!isOpen() || !put(account, entry))
+			return false;
+
+		unsigned char change[JOURNAL_HEADER + MAX_ACCOUNT_LENGTH + MAX_STORED_SECRET_LENGTH];
+		change[0] = CHANGE_STORE;
+		change[1] = static_cast<uint8_t>(account.length());
+		change[2] = static_cast<uint8_t>(entry.secretLength);
+		change[3] = static_cast<uint8_t>(entry.params.algorithm);
+		change[4] = static_cast<uint8_t>(entry.params.digits);
+		change[5] = static_cast<uint8_t>(entry.params.period);
+		change[6] = static_cast<uint8_t>(entry.params.period >> 8);
+		std::memcpy(change + JOURNAL_HEADER, account.data(), account.length());
+		std::memcpy(change + JOURNAL_HEADER + account.length(), entry.secret, entry.secretLength);
+
+		size_t length = JOURNAL_HEADER + account.length() + entry.secretLength;
+		journal_.append(change, length);
+		std::memset(change, 0, sizeof(change));
+		return true;
+	}
+
+	bool AccountStore::remove(std::string_view account)
+	{
+		if (!isOpen() || !erase(account))
+			return false;
+
+		unsigned char change[JOURNAL_HEADER + MAX_ACCOUNT_LENGTH] = {};
+		change[0] = CHANGE_REMOVE;
+		change[1] = static_cast<uint8_t>(account.length());
+		std::memcpy(change + JOURNAL_HEADER, account.data(), account.length());
+		journal_.append(change, JOURNAL_HEADER + account.length());
+		return true;
+	}
+
+	void AccountStore::replayRecord(const unsigned char* data, size_t length)
+	{
+		if (length < JOURNAL_HEADER)
+			return;
+
+		size_t accountLength = data[1];
+		size_t secretLength = data[2];
+		if (JOURNAL_HEADER + accountLength + secretLength != length)
+			return;
+
+		std::string_view account(reinterpret_cast<const char*>(data + JOURNAL_HEADER), accountLength);
+		if (data[0] == CHANGE_REMOVE)
+		{
+			erase(account);
+			return;
+		}
+
+		if (data[0] != CHANGE_STORE || secretLength > MAX_STORED_SECRET_LENGTH)
+			return;
+
+		Entry entry;
+		std::memcpy(entry.secret, data + JOURNAL_HEADER + accountLength, secretLength);
+		entry.secretLength = secretLength;
+		entry.params.algorithm = static_cast<TOTPUtils::Algorithm>(data[3]);
+		entry.params.digits = data[4];
+		entry.params.period = data[5] | (data[6] << 8);
+		put(account, entry);
+		entry.clear();
+	}
+
+	bool AccountStore::put(std::string_view account, const Entry& entry)
+	{
+		if (account.empty() || account.length() > MAX_ACCOUNT_LENGTH)
+			return false;
+
+		if (entry.secretLength == 0 || entry.secretLength > sizeof(Record::secret))
+			return false;
+
+		uint64_t h = hash(account);
+		Record* insert;
+		Record* record = lookup(account, h, &insert);
+		bool added = !record;
+		if (added)
+		{
+			// Keep the table at most half full, counting deleted records, so probes stay short.
+			Header& head = header();
+			if ((head.used + head.deleted + 1) * 2 > head.capacity)
+			{
+				if (!grow())
+					return false;
+				lookup(account, h, &insert);
+			}
+			record = insert;
+		}
+
+		bool reused = record->state == RECORD_DELETED;
+
+		// Fill in the record before marking it used, so a torn write leaves it unused.
+		record->hash = h;
+		record->accountLength = static_cast<uint8_t>(account.length());
+		record->secretLength = static_cast<uint8_t>(entry.secretLength);
+		record->algorithm = static_cast<uint8_t>(entry.params.algorithm);
+		record->digits = static_cast<uint8_t>(entry.params.digits);
+		record->reserved = 0;
+		record->period = static_cast<uint16_t>(entry.params.period);
+		std::memset(record->account, 0, sizeof(record->account));
+		std::memcpy(record->account, account.data(), account.length());
+		std::memset(record->secret, 0, sizeof(record->secret));
+		std::memcpy(record->secret, entry.secret, entry.secretLength);
+		record->state = RECORD_USED;
+
+		if (added)
+		{
+			Header& head = header();
+			head.used++;
+			if (reused)
+				head.deleted--;
+		}
+		return true;
+	}
+
+	bool AccountStore::erase(std::string_view account)
+	{
+		if (account.empty() || account.length() > MAX_ACCOUNT_LENGTH)
+			return false;
+
+		Record* record = lookup(account, hash(account), nullptr);
+		if (!record)
+			return false;
+
+		// Deleted rather than emptied, so accounts probed past this record are still found.
+		record->state = RECORD_DELETED;
+		std::memset(record->account, 0, sizeof(record->account));
+		std::memset(record->secret, 0, sizeof(record->secret));
+		record->accountLength = 0;
+		record->secretLength = 0;
+
+		Header& head = header();
+		head.used--;
+		head.deleted++;
+		return true;
+	}
+
+	bool AccountStore::grow()
+	{
+		const Header& old = header();
+
+		// Room for twice the live records at half load; deleted records are dropped.
+		uint64_t capacity = INITIAL_CAPACITY;
+		while (capacity < (old.used + 1) * 4)
+			capacity *= 2;
+
+		std::string tempPath = path_ + ".tmp";
+		std::error_code error;
+		std::filesystem::remove(tempPath, error);
+
+		MappedFile temp;
+		if (!temp.open(tempPath, HEADER_SIZE + capacity * RECORD_SIZE))
+			return false;
+
+		Header& h = *reinterpret_cast<Header*>(temp.data());
+		std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+		h.version = VERSION;
+		h.recordSize = RECORD_SIZE;
+		h.capacity = capacity;
+		h.used = old.used;
+		h.deleted = 0;
+		h.seed = old.seed;
+
+		// Same seed, so stored hashes stay valid and only need placing.
+		Record* from = records();
+		Record* to = reinterpret_cast<Record*>(temp.data() + HEADER_SIZE);
+		uint64_t mask = capacity - 1;
+		for (uint64_t i = 0; i < old.capacity; i++)
+		{
+			if (from[i].state != RECORD_USED)
+				continue;
+
+			uint64_t slot = from[i].hash & mask;
+			while (to[slot].state != RECORD_EMPTY)
+				slot = (slot + 1) & mask;
+			to[slot] = from[i];
+		}
+
+		temp.close();
+
+#ifdef _WIN32
+		std::lock_guard<std::mutex> syncing(syncMutex_);
+#endif
+		// Held until the new file is mapped, so a checkpoint syncs whichever mapping is at
+		// path_. The new file is already synced, so the old mapping is dropped without waiting
+		// for its pages; if the journal writer is syncing it, that sync unmaps it when done.
+		std::lock_guard<std::mutex> lock(mappingMutex_);
+		file_->setFlushOnClose(false);
+		file_.reset();
+
+		std::filesystem::rename(tempPath, path_, error);
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			map();
+			return false;
+		}
+		return map();
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Secrets kept by the server itself, keyed by account name. The file is a header followed by
+// an open-addressing table of fixed-size records and is used through a memory mapping, so
+// opening it is a map and looking an account up reads one record, normally on one page.
+// Every change is also written to a journal next to it, which makes changes durable within a
+// commit interval without syncing the mapping on the main thread.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "totp-utils.hpp"
+#include "totp-journal.hpp"
+#include "totp-seal.hpp"
+
+namespace TOTPStore
+{
+	// Longest account name that can be stored. Names are compared ignoring ASCII case.
+	constexpr size_t MAX_ACCOUNT_LENGTH = 48;
+
+	// Longest secret that can be stored; room for a sealed one.
+	constexpr size_t MAX_STORED_SECRET_LENGTH = 192;
+	static_assert(TOTPSeal::MAX_SEALED_LENGTH <= MAX_STORED_SECRET_LENGTH, "sealed secrets must fit a record");
+
+	struct Entry
+	{
+		char secret[MAX_STORED_SECRET_LENGTH];
+		size_t secretLength = 0;
+		TOTPUtils::Params params;
+
+		std::string_view getSecret() const
+		{
+			return std::string_view(secret, secretLength);
+		}
+
+		// Wipe the secret once it has been used.
+		void clear();
+	};
+
+	// A read-write mapping of a whole file.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		// Open or create the file and map it, growing it to at least minSize bytes.
+		bool open(const std::string& path, size_t minSize);
+
+		void close();
+
+		// Write dirty pages back to the file.
+		void flush();
+
+		// Whether close waits for dirty pages to be written back. Off for a mapping whose file is
+		// being replaced, so dropping it does not wait for a sync nobody needs.
+		void setFlushOnClose(bool flush) { flushOnClose_ = flush; }
+
+		bool isOpen() const { return data_ != nullptr; }
+		unsigned char* data() const { return data_; }
+		size_t size() const { return size_; }
+
+	private:
+		unsigned char* data_ = nullptr;
+		size_t size_ = 0;
+		bool flushOnClose_ = true;
+#ifdef _WIN32
+		void* file_ = nullptr;
+		void* mapping_ = nullptr;
+#else
+		int fd_ = -1;
+#endif
+	};
+
+	class AccountStore
+	{
+	public:
+		AccountStore() = default;
+		AccountStore(const AccountStore&) = delete;
+		AccountStore& operator=(const AccountStore&) = delete;
+		~AccountStore();
+
+		// Map the store at path, creating it if it does not exist, and apply what the journal
+		// holds from before a crash. Fails if the file exists but is not a store, so nothing is
+		// ever overwritten.
+		bool open(const std::string& path, std::chrono::milliseconds commitInterval = TOTPJournal::DEFAULT_COMMIT_INTERVAL);
+
+		void close();
+
+		bool isOpen() const { return file_ != nullptr; }
+
+		// Copy an account's secret and settings into entry. Returns false if it is not stored.
+		bool find(std::string_view account, Entry& entry) const;
+
+		// Add or replace an account. Fails if the name is empty or too long, or the secret is.
+		bool store(std::string_view account, const Entry& entry);
+
+		// Returns false if the account was not stored.
+		bool remove(std::string_view account);
+
+		// Number of stored accounts.
+		size_t count() const;
+
+		// The last journal write error since the previous call, if any. Main thread only.
+		bool takeError(std::string& message) { return journal_.takeError(message); }
+
+		using Visitor = std::function<void(std::string_view account, const Entry& entry)>;
+
+		// Call visit for every stored account, in table order. Returns the number visited.
+		size_t forEach(const Visitor& visit) const;
+
+	private:
+		struct Header;
+		struct Record;
+
+		std::string path_;
+		TOTPJournal::Journal journal_;
+
+		// Shared with the journal writer, which takes its own reference under mappingMutex_ and
+		// syncs outside it, so grow never waits for a sync to replace the mapping. Whoever lets
+		// go of a replaced mapping last unmaps it.
+		std::shared_ptr<MappedFile> file_;
+		std::mutex mappingMutex_;
+#ifdef _WIN32
+		// Held by the writer while it has a reference. Windows cannot replace a file that is
+		// still mapped, so there grow does wait for a sync in progress.
+		std::mutex syncMutex_;
+#endif
+
+		Header& header() const;
+		Record* records() const;
+		uint64_t hash(std::string_view account) const;
+		bool isValid() const;
+
+		// Map path_ and check it, creating it if needed, and make it the current mapping. Called
+		// with mappingMutex_ held once the journal writer is running.
+		bool map();
+
+		// Count used and deleted records again, after a crash may have torn the header.
+		void recount();
+
+		// Make every change applied so far durable. Runs on the journal writer.
+		void checkpoint();
+
+		// Apply a change to the table without journaling it.
+		bool put(std::string_view account, const Entry& entry);
+		bool erase(std::string_view account);
+
+		void replayRecord(const unsigned char* data, size_t length);
+
+		// The account's record, or null. If insert is given, it is set to where the account
+		// would be added: the first free or deleted record on its probe path.
+		Record* lookup(std::string_view account, uint64_t hash, Record** insert) const;
+
+		// Rewrite the table at twice the size into a new file and swap it in.
+		bool grow();
+	};
+}
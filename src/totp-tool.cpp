@@ -0,0 +1,822 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// neufox-2fa-tool: moves accounts between CSV or JSON-lines files and the account store.
+//
+//   neufox-2fa-tool import <input> <store> [--format csv|jsonl] [--master-key HEX] [--threads N]
+//   neufox-2fa-tool export <store> <output> [--format csv|jsonl] [--master-key HEX]
+//
+// Rows are account, secret and optionally algorithm, digits and period. Imports read the file
+// in chunks, parse, validate and normalise the chunks on worker threads and store them in file
+// order, so memory stays at a few chunks per thread however large the file is. With a master
+// key, imported secrets are sealed and exported ones opened. Stop the server first: it keeps
+// the store mapped and its journal open, and does not expect anyone else to touch either.
+
+#include "totp-store.hpp"
+#include "totp-seal.hpp"
+#include "totp-engine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	enum class Format
+	{
+		Unknown,
+		CSV,
+		JSONLines
+	};
+
+	struct Options
+	{
+		Format format = Format::Unknown;
+		std::string masterKey;
+		unsigned threads = 0;
+	};
+
+	// Input is handed to workers in chunks of whole lines of about this size.
+	constexpr size_t CHUNK_BYTES = 1024 * 1024;
+
+	// Only this many rejected rows are described; the rest are counted.
+	constexpr size_t MAX_REPORTED_ERRORS = 20;
+
+	struct Chunk
+	{
+		std::string text;
+		uint64_t firstLine = 0;
+	};
+
+	struct Row
+	{
+		char account[TOTPStore::MAX_ACCOUNT_LENGTH];
+		size_t accountLength;
+		TOTPStore::Entry entry;
+	};
+
+	struct RowError
+	{
+		uint64_t line;
+		const char* reason;
+	};
+
+	// What a worker made of a chunk.
+	struct ChunkResult
+	{
+		std::vector<Row> rows;
+		std::vector<RowError> errors;
+		size_t rejected = 0;
+	};
+
+	struct Fields
+	{
+		std::string account;
+		std::string secret;
+		std::string algorithm;
+		std::string digits;
+		std::string period;
+	};
+
+	bool equalsIgnoreCase(std::string_view a, std::string_view b)
+	{
+		if (a.length() != b.length())
+			return false;
+		for (size_t i = 0; i < a.length(); i++)
+		{
+			char x = a[i] >= 'a' && a[i] <= 'z' ? static_cast<char>(a[i] - 32) : a[i];
+			char y = b[i] >= 'a' && b[i] <= 'z' ? static_cast<char>(b[i] - 32) : b[i];
+			if (x != y)
+				return false;
+		}
+		return true;
+	}
+
+	Format formatOf(std::string_view path)
+	{
+		size_t dot = path.rfind('.');
+		std::string_view extension = dot == std::string_view::npos ? std::string_view() : path.substr(dot + 1);
+		if (equalsIgnoreCase(extension, "csv"))
+			return Format::CSV;
+		if (equalsIgnoreCase(extension, "jsonl") || equalsIgnoreCase(extension, "ndjson") || equalsIgnoreCase(extension, "json"))
+			return Format::JSONLines;
+		return Format::Unknown;
+	}
+
+	// ------------------------------------------------------------------------
+	// Parsing
+	// ------------------------------------------------------------------------
+
+	// One CSV line: account,secret[,algorithm[,digits[,period]]]. Fields may be double-quoted,
+	// with "" for a quote inside.
+	bool parseCSV(std::string_view line, Fields& fields, const char*& reason)
+	{
+		std::string* columns[] = { &fields.account, &fields.secret, &fields.algorithm, &fields.digits, &fields.period };
+		size_t column = 0;
+		size_t i = 0;
+		while (true)
+		{
+			if (column == sizeof(columns) / sizeof(columns[0]))
+			{
+				reason = "too many columns";
+				return false;
+			}
+
+			std::string& field = *columns[column++];
+			field.clear();
+			if (i < line.length() && line[i] == '"')
+			{
+				i++;
+				while (true)
+				{
+					if (i >= line.length())
+					{
+						reason = "unterminated quote";
+						return false;
+					}
+					if (line[i] == '"')
+					{
+						if (i + 1 < line.length() && line[i + 1] == '"')
+						{
+							field += '"';
+							i += 2;
+							continue;
+						}
+						i++;
+						break;
+					}
+					field += line[i++];
+				}
+			}
+			else
+			{
+				size_t end = line.find(',', i);
+				if (end == std::string_view::npos)
+					end = line.length();
+				field.assign(line.data() + i, end - i);
+				i = end;
+			}
+
+			if (i >= line.length())
+				break;
+			if (line[i] != ',')
+			{
+				reason = "text after a quoted field";
+				return false;
+			}
+			i++;
+		}
+
+		if (column < 2)
+		{
+			reason = "missing secret column";
+			return false;
+		}
+		return true;
+	}
+
+	void skipSpace(std::string_view text, size_t& i)
+	{
+		while (i < text.length() && (text[i] == ' ' || text[i] == '\t'))
+			i++;
+	}
+
+	// A JSON string starting at text[i]. Escapes outside ASCII are not needed for names or secrets.
+	bool parseString(std::string_view text, size_t& i, std::string& output)
+	{
+		if (i >= text.length() || text[i] != '"')
+			return false;
+		i++;
+		output.clear();
+		while (i < text.length())
+		{
+			char c = text[i++];
+			if (c == '"')
+				return true;
+			if (c != '\\')
+			{
+				output += c;
+				continue;
+			}
+			if (i >= text.length())
+				return false;
+			char escape = text[i++];
+			switch (escape)
+			{
+			case '"': output += '"'; break;
+			case '\\': output += '\\'; break;
+			case '/': output += '/'; break;
+			case 'b': output += '\b'; break;
+			case 'f': output += '\f'; break;
+			case 'n': output += '\n'; break;
+			case 'r': output += '\r'; break;
+			case 't': output += '\t'; break;
+			case 'u':
+			{
+				if (i + 4 > text.length())
+					return false;
+				unsigned value = 0;
+				for (int k = 0; k < 4; k++)
+				{
+					char h = text[i++];
+					value <<= 4;
+					if (h >= '0' && h <= '9')
+						value |= static_cast<unsigned>(h - '0');
+					else if (h >= 'a' && h <= 'f')
+						value |= static_cast<unsigned>(h - 'a' + 10);
+					else if (h >= 'A' && h <= 'F')
+						value |= static_cast<unsigned>(h - 'A' + 10);
+					else
+						return false;
+				}
+				if (value > 0x7F)
+					return false;
+				output += static_cast<char>(value);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		return false;
+	}
+
+	// A number, true, false or null, kept as its text.
+	bool parseScalar(std::string_view text, size_t& i, std::string& output)
+	{
+		size_t start = i;
+		while (i < text.length() && text[i] != ',' && text[i] != '}' && text[i] != ' ' && text[i] != '\t')
+			i++;
+		output.assign(text.data() + start, i - start);
+		return !output.empty() && output.find_first_of("[{\"") == std::string::npos;
+	}
+
+	// One flat JSON object per line. Unknown keys are ignored.
+	bool parseJSONLine(std::string_view line, Fields& fields, const char*& reason)
+	{
+		fields = Fields();
+		reason = "not a flat JSON object";
+
+		size_t i = 0;
+		skipSpace(line, i);
+		if (i >= line.length() || line[i++] != '{')
+			return false;
+
+		std::string key;
+		std::string value;
+		skipSpace(line, i);
+		if (i < line.length() && line[i] == '}')
+		{
+			reason = "missing account";
+			return false;
+		}
+
+		while (true)
+		{
+			skipSpace(line, i);
+			if (!parseString(line, i, key))
+				return false;
+			skipSpace(line, i);
+			if (i >= line.length() || line[i++] != ':')
+				return false;
+			skipSpace(line, i);
+			bool parsed = i < line.length() && line[i] == '"' ? parseString(line, i, value) : parseScalar(line, i, value);
+			if (!parsed)
+				return false;
+
+			if (key == "account")
+				fields.account = value;
+			else if (key == "secret")
+				fields.secret = value;
+			else if (key == "algorithm")
+				fields.algorithm = value;
+			else if (key == "digits")
+				fields.digits = value;
+			else if (key == "period")
+				fields.period = value;
+
+			skipSpace(line, i);
+			if (i >= line.length())
+				return false;
+			char c = line[i++];
+			if (c == '}')
+				break;
+			if (c != ',')
+				return false;
+		}
+
+		skipSpace(line, i);
+		if (i != line.length())
+			return false;
+		if (fields.account.empty() || fields.secret.empty())
+		{
+			reason = "missing account or secret";
+			return false;
+		}
+		return true;
+	}
+
+	bool parseInt(const std::string& text, int& value)
+	{
+		if (text.empty() || text.length() > 9)
+			return false;
+		int result = 0;
+		for (char c : text)
+		{
+			if (c < '0' || c > '9')
+				return false;
+			result = result * 10 + (c - '0');
+		}
+		value = result;
+		return true;
+	}
+
+	bool parseAlgorithm(const std::string& text, TOTPUtils::Algorithm& algorithm)
+	{
+		if (text.empty() || equalsIgnoreCase(text, "SHA1") || text == "0")
+			algorithm = TOTPUtils::Algorithm::SHA1;
+		else if (equalsIgnoreCase(text, "SHA256") || text == "1")
+			algorithm = TOTPUtils::Algorithm::SHA256;
+		else if (equalsIgnoreCase(text, "SHA512") || text == "2")
+			algorithm = TOTPUtils::Algorithm::SHA512;
+		else
+			return false;
+		return true;
+	}
+
+	const char* algorithmName(TOTPUtils::Algorithm algorithm)
+	{
+		switch (algorithm)
+		{
+		case TOTPUtils::Algorithm::SHA256: return "SHA256";
+		case TOTPUtils::Algorithm::SHA512: return "SHA512";
+		default: return "SHA1";
+		}
+	}
+
+	// Authenticator exports group secrets, pad them and mix case; the store wants bare upper-case base32.
+	size_t normaliseSecret(std::string_view input, char (&output)[TOTPUtils::MAX_SECRET_LENGTH])
+	{
+		size_t length = 0;
+		for (char c : input)
+		{
+			if (c == ' ' || c == '\t' || c == '-' || c == '=')
+				continue;
+			if (length == sizeof(output))
+				return 0;
+			output[length++] = c >= 'a' && c <= 'z' ? static_cast<char>(c - 32) : c;
+		}
+		return length;
+	}
+
+	// Turn one line into a row ready to store. Returns null on success, or why it was rejected.
+	const char* processLine(std::string_view line, Format format, TOTPSeal::Sealer& sealer, Fields& fields, Row& row)
+	{
+		const char* reason = nullptr;
+		bool parsed = format == Format::CSV ? parseCSV(line, fields, reason) : parseJSONLine(line, fields, reason);
+		if (!parsed)
+			return reason;
+
+		if (fields.account.empty() || fields.account.length() > TOTPStore::MAX_ACCOUNT_LENGTH)
+			return "account name is empty or longer than 48 characters";
+
+		TOTPUtils::Params params;
+		if (!parseAlgorithm(fields.algorithm, params.algorithm))
+			return "unknown algorithm";
+		if (!fields.digits.empty() && !parseInt(fields.digits, params.digits))
+			return "digits is not a number";
+		if (!fields.period.empty() && !parseInt(fields.period, params.period))
+			return "period is not a number";
+		if (!TOTPUtils::validParams(params))
+			return "digits or period out of range";
+
+		TOTPStore::Entry& entry = row.entry;
+		entry.params = params;
+		if (TOTPSeal::isSealed(fields.secret))
+		{
+			// Already sealed: kept as is, but checked against the key when there is one.
+			if (fields.secret.length() > sizeof(entry.secret))
+				return "sealed secret is too long";
+			if (sealer.isEnabled())
+			{
+				char secret[TOTPUtils::MAX_SECRET_LENGTH];
+				size_t length = sealer.open(fields.secret, secret, sizeof(secret));
+				std::memset(secret, 0, sizeof(secret));
+				if (length == 0)
+					return "sealed secret does not open under the master key";
+			}
+			std::memcpy(entry.secret, fields.secret.data(), fields.secret.length());
+			entry.secretLength = fields.secret.length();
+		}
+		else
+		{
+			char secret[TOTPUtils::MAX_SECRET_LENGTH];
+			std::string_view normalised(secret, normaliseSecret(fields.secret, secret));
+			bool valid = TOTPEngine::isValidSecret(normalised);
+			if (valid)
+				entry.secretLength = TOTPEngine::exportSecret(sealer, normalised, entry.secret, sizeof(entry.secret));
+			std::memset(secret, 0, sizeof(secret));
+			if (!valid)
+				return "secret is not 10 to 64 base32 characters";
+			if (entry.secretLength == 0)
+				return "secret could not be sealed";
+		}
+
+		std::memcpy(row.account, fields.account.data(), fields.account.length());
+		row.accountLength = fields.account.length();
+		return nullptr;
+	}
+
+	void processChunk(const Chunk& chunk, Format format, const std::string& masterKey, ChunkResult& result)
+	{
+		// Cipher contexts are not shared between threads, so each worker sets the key up itself.
+		TOTPSeal::Sealer sealer;
+		sealer.setKey(masterKey);
+
+		result.rows.clear();
+		result.errors.clear();
+		result.rejected = 0;
+
+		Fields fields;
+		std::string_view text(chunk.text);
+		uint64_t lineNumber = chunk.firstLine;
+		size_t start = 0;
+		while (start < text.length())
+		{
+			size_t end = text.find('\n', start);
+			if (end == std::string_view::npos)
+				end = text.length();
+			std::string_view line = text.substr(start, end - start);
+			start = end + 1;
+			uint64_t number = lineNumber++;
+
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			// A CSV header names its columns.
+			if (format == Format::CSV && number == 1 && equalsIgnoreCase(line.substr(0, 8), "account,"))
+				continue;
+
+			result.rows.emplace_back();
+			const char* reason = processLine(line, format, sealer, fields, result.rows.back());
+			if (reason)
+			{
+				result.rows.back().entry.clear();
+				result.rows.pop_back();
+				result.rejected++;
+				if (result.errors.size() < MAX_REPORTED_ERRORS)
+					result.errors.push_back({ number, reason });
+			}
+		}
+
+		std::memset(&fields.secret[0], 0, fields.secret.size());
+	}
+
+	// Reads whole lines in chunks of about CHUNK_BYTES.
+	class ChunkReader
+	{
+	public:
+		explicit ChunkReader(std::FILE* file)
+			: file_(file)
+		{
+		}
+
+		bool next(Chunk& chunk)
+		{
+			chunk.text.swap(carry_);
+			carry_.clear();
+			chunk.firstLine = line_;
+
+			char buffer[64 * 1024];
+			while (!eof_)
+			{
+				size_t read = std::fread(buffer, 1, sizeof(buffer), file_);
+				if (read == 0)
+				{
+					eof_ = true;
+					break;
+				}
+				chunk.text.append(buffer, read);
+				if (chunk.text.length() >= CHUNK_BYTES && chunk.text.find('\n', chunk.text.length() - read) != std::string::npos)
+					break;
+			}
+
+			// Keep a partial last line for the next chunk.
+			if (!eof_)
+			{
+				size_t lastNewline = chunk.text.rfind('\n');
+				carry_.assign(chunk.text, lastNewline + 1, std::string::npos);
+				chunk.text.resize(lastNewline + 1);
+			}
+
+			line_ += static_cast<uint64_t>(std::count(chunk.text.begin(), chunk.text.end(), '\n'));
+			return !chunk.text.empty();
+		}
+
+	private:
+		std::FILE* file_;
+		std::string carry_;
+		uint64_t line_ = 1;
+		bool eof_ = false;
+	};
+
+	double secondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	int runImport(const std::string& inputPath, const std::string& storePath, const Options& options)
+	{
+		Format format = options.format != Format::Unknown ? options.format : formatOf(inputPath);
+		if (format == Format::Unknown)
+		{
+			std::fprintf(stderr, "Cannot tell the format of %s; pass --format csv or --format jsonl\n", inputPath.c_str());
+			return 1;
+		}
+
+		std::FILE* input = std::fopen(inputPath.c_str(), "rb");
+		if (!input)
+		{
+			std::fprintf(stderr, "Could not open %s\n", inputPath.c_str());
+			return 1;
+		}
+
+		TOTPStore::AccountStore store;
+		if (!store.open(storePath))
+		{
+			std::fprintf(stderr, "Could not open account store %s\n", storePath.c_str());
+			std::fclose(input);
+			return 1;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		unsigned threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+		// One chunk per worker in flight; stored in file order, so a later row for the same
+		// account wins as it would have through TOTP_SaveAccount.
+		std::vector<Chunk> chunks(threads);
+		std::vector<ChunkResult> results(threads);
+		std::vector<std::thread> workers;
+		ChunkReader reader(input);
+
+		size_t imported = 0;
+		size_t rejected = 0;
+		size_t failed = 0;
+		size_t reported = 0;
+		bool more = true;
+		while (more)
+		{
+			size_t filled = 0;
+			while (filled < threads && (more = reader.next(chunks[filled])))
+				filled++;
+
+			workers.clear();
+			for (size_t i = 0; i < filled; i++)
+				workers.emplace_back(processChunk, std::cref(chunks[i]), format, std::cref(options.masterKey), std::ref(results[i]));
+			for (std::thread& worker : workers)
+				worker.join();
+
+			for (size_t i = 0; i < filled; i++)
+			{
+				ChunkResult& result = results[i];
+				for (Row& row : result.rows)
+				{
+					if (store.store(std::string_view(row.account, row.accountLength), row.entry))
+						imported++;
+					else
+						failed++;
+					row.entry.clear();
+				}
+
+				rejected += result.rejected;
+				for (const RowError& error : result.errors)
+				{
+					if (reported++ < MAX_REPORTED_ERRORS)
+						std::fprintf(stderr, "line %llu: %s\n", static_cast<unsigned long long>(error.line), error.reason);
+				}
+			}
+		}
+
+		bool readError = std::ferror(input) != 0;
+		std::fclose(input);
+		store.close();
+
+		if (readError)
+			std::fprintf(stderr, "Error reading %s; the import is incomplete\n", inputPath.c_str());
+		if (reported > MAX_REPORTED_ERRORS)
+			std::fprintf(stderr, "... and %llu more rejected rows\n", static_cast<unsigned long long>(rejected - MAX_REPORTED_ERRORS));
+		if (failed != 0)
+			std::fprintf(stderr, "%llu rows could not be written to the store\n", static_cast<unsigned long long>(failed));
+
+		std::printf("Imported %llu accounts, rejected %llu rows in %.2f s\n",
+			static_cast<unsigned long long>(imported), static_cast<unsigned long long>(rejected), secondsSince(start));
+		return readError || failed != 0 ? 1 : rejected != 0 ? 2 : 0;
+	}
+
+	void writeCSVField(std::FILE* output, std::string_view field)
+	{
+		if (field.find_first_of(",\"\r\n") == std::string_view::npos)
+		{
+			std::fwrite(field.data(), 1, field.length(), output);
+			return;
+		}
+
+		std::fputc('"', output);
+		for (char c : field)
+		{
+			if (c == '"')
+				std::fputc('"', output);
+			std::fputc(c, output);
+		}
+		std::fputc('"', output);
+	}
+
+	void writeJSONString(std::FILE* output, std::string_view text)
+	{
+		std::fputc('"', output);
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				std::fputc('\\', output);
+				std::fputc(c, output);
+			}
+			else if (static_cast<unsigned char>(c) < 0x20)
+				std::fprintf(output, "\\u%04x", static_cast<unsigned>(c));
+			else
+				std::fputc(c, output);
+		}
+		std::fputc('"', output);
+	}
+
+	int runExport(const std::string& storePath, const std::string& outputPath, const Options& options)
+	{
+		Format format = options.format != Format::Unknown ? options.format : formatOf(outputPath);
+		if (format == Format::Unknown)
+		{
+			std::fprintf(stderr, "Cannot tell the format of %s; pass --format csv or --format jsonl\n", outputPath.c_str());
+			return 1;
+		}
+
+		// Opening a store creates it, which an export should never do.
+		std::error_code error;
+		TOTPStore::AccountStore store;
+		if (!std::filesystem::exists(storePath, error) || !store.open(storePath))
+		{
+			std::fprintf(stderr, "Could not open account store %s\n", storePath.c_str());
+			return 1;
+		}
+
+		std::FILE* output = std::fopen(outputPath.c_str(), "wb");
+		if (!output)
+		{
+			std::fprintf(stderr, "Could not create %s\n", outputPath.c_str());
+			return 1;
+		}
+
+		TOTPSeal::Sealer sealer;
+		sealer.setKey(options.masterKey);
+
+		auto start = std::chrono::steady_clock::now();
+		if (format == Format::CSV)
+			std::fputs("account,secret,algorithm,digits,period\n", output);
+
+		size_t sealedFailures = 0;
+		size_t exported = store.forEach([&](std::string_view account, const TOTPStore::Entry& entry)
+		{
+			// With the key, sealed secrets come out as base32 again; without it, as stored.
+			char secret[TOTPUtils::MAX_SECRET_LENGTH];
+			std::string_view value = entry.getSecret();
+			if (sealer.isEnabled() && TOTPSeal::isSealed(value))
+			{
+				size_t length = sealer.open(value, secret, sizeof(secret));
+				if (length == 0)
+					sealedFailures++;
+				else
+					value = std::string_view(secret, length);
+			}
+
+			if (format == Format::CSV)
+			{
+				writeCSVField(output, account);
+				std::fputc(',', output);
+				writeCSVField(output, value);
+				std::fprintf(output, ",%s,%d,%d\n", algorithmName(entry.params.algorithm), entry.params.digits, entry.params.period);
+			}
+			else
+			{
+				std::fputs("{\"account\":", output);
+				writeJSONString(output, account);
+				std::fputs(",\"secret\":", output);
+				writeJSONString(output, value);
+				std::fprintf(output, ",\"algorithm\":\"%s\",\"digits\":%d,\"period\":%d}\n", algorithmName(entry.params.algorithm), entry.params.digits, entry.params.period);
+			}
+			std::memset(secret, 0, sizeof(secret));
+		});
+
+		bool writeError = std::fflush(output) != 0 || std::ferror(output) != 0;
+		std::fclose(output);
+		store.close();
+
+		if (writeError)
+		{
+			std::fprintf(stderr, "Error writing %s\n", outputPath.c_str());
+			return 1;
+		}
+		if (sealedFailures != 0)
+			std::fprintf(stderr, "%llu sealed secrets did not open under the master key and were exported sealed\n", static_cast<unsigned long long>(sealedFailures));
+
+		std::printf("Exported %llu accounts in %.2f s\n", static_cast<unsigned long long>(exported), secondsSince(start));
+		return sealedFailures != 0 ? 2 : 0;
+	}
+
+	void printUsage()
+	{
+		std::fputs(
+			"Usage:\n"
+			"  neufox-2fa-tool import <input> <store> [options]\n"
+			"  neufox-2fa-tool export <store> <output> [options]\n"
+			"\n"
+			"Rows are account,secret[,algorithm,digits,period] in CSV, or objects with those\n"
+			"keys in JSON lines. The format is taken from the file extension unless given.\n"
+			"\n"
+			"Options:\n"
+			"  --format csv|jsonl   Format of the input or output file\n"
+			"  --master-key HEX     Seal imported secrets, open exported ones (64 hex digits)\n"
+			"  --threads N          Import worker threads (default: one per core)\n",
+			stderr);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::string command = argv[1];
+	Options options;
+	for (int i = 4; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::fprintf(stderr, "%s needs a value\n", option.c_str());
+			return 1;
+		}
+
+		std::string value = argv[++i];
+		if (option == "--format")
+		{
+			options.format = value == "csv" ? Format::CSV : value == "jsonl" ? Format::JSONLines : Format::Unknown;
+			if (options.format == Format::Unknown)
+			{
+				std::fprintf(stderr, "Unknown format %s\n", value.c_str());
+				return 1;
+			}
+		}
+		else if (option == "--master-key")
+		{
+			TOTPSeal::Sealer sealer;
+			if (!sealer.setKey(value) || !sealer.isEnabled())
+			{
+				std::fprintf(stderr, "The master key must be 64 hex digits, and this build needs OpenSSL to use one\n");
+				return 1;
+			}
+			options.masterKey = value;
+		}
+		else if (option == "--threads")
+		{
+			options.threads = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s\n", option.c_str());
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (command == "import")
+		return runImport(argv[2], argv[3], options);
+	if (command == "export")
+		return runExport(argv[2], argv[3], options);
+
+	printUsage();
+	return 1;
+}
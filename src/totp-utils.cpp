@@ -7,130 +7,466 @@
  */
 
 #include "totp-utils.hpp"
+#include "totp-base32.hpp"
+#include "totp-sha1-multibuffer.hpp"
+#include <algorithm>
 #include <array>
-#include <iomanip>
-#include <sstream>
-#include <vector>
-#include <openssl/hmac.h>
-#include <openssl/sha.h>
-#include <openssl/rand.h>
+#include <cstring>
+#include <type_traits>
+
+namespace TOTPUtils::Detail
+{
+	struct CodeFunctions
+	{
+		uint32_t (*generate)(const TOTPKey& key, uint64_t counter);
+		// Non-zero if any step in [counter - window, counter + window] produces the code.
+		uint32_t (*match)(const TOTPKey& key, uint32_t code, uint64_t counter, int window);
+	};
+}
 
 namespace
 {
-	constexpr std::string_view BASE32_CHARS = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
-	constexpr size_t SECRET_LENGTH = 16;
+	using TOTPUtils::Algorithm;
+	using TOTPUtils::TOTPKey;
+
+	// Secrets are generated this many characters at a time (a multiple of 8, so whole random bytes encode exactly).
+	constexpr size_t SECRET_CHUNK = 256;
+
+	// Jobs hashed per multi-buffer call when verifying a batch.
+	constexpr size_t BATCH_JOBS = SHA1MultiBuffer::MAX_LANES * 16;
+
+	constexpr uint32_t POWERS_OF_TEN[TOTPUtils::MAX_DIGITS + 1] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	};
+
+	template <class Hash>
+	const TOTPCrypto::HMACState<Hash>& hmacState(const TOTPKey& key)
+	{
+		if constexpr (std::is_same_v<Hash, TOTPCrypto::SHA1>)
+			return key.hmac.sha1;
+		else if constexpr (std::is_same_v<Hash, TOTPCrypto::SHA256>)
+			return key.hmac.sha256;
+		else
+			return key.hmac.sha512;
+	}
 
-	std::array<uint8_t, 20> hmacSHA1(const uint8_t* key, size_t keyLen, const std::array<uint8_t, 8>& data)
+	// RFC 4226 dynamic truncation, before the modulus is applied.
+	uint32_t truncate(const uint8_t* hash, size_t size)
 	{
-		std::array<uint8_t, 20> output;
-		unsigned int len = 20;
-		HMAC(EVP_sha1(), key, keyLen, data.data(), data.size(), output.data(), &len);
-		return output;
+		int offset = hash[size - 1] & 0x0F;
+		return ((hash[offset] & 0x7F) << 24)
+		     | ((hash[offset + 1] & 0xFF) << 16)
+		     | ((hash[offset + 2] & 0xFF) << 8)
+		     | (hash[offset + 3] & 0xFF);
 	}
 
-	std::optional<std::vector<uint8_t>> decodeBase32(const std::string& input)
+	uint8_t digestByte(const uint32_t digest[5], int index)
 	{
-		std::vector<uint8_t> output;
-		uint32_t buffer = 0;
-		int bitsLeft = 0;
+		return static_cast<uint8_t>(digest[index >> 2] >> (24 - 8 * (index & 3)));
+	}
+
+	uint32_t truncateDigest(const uint32_t digest[5])
+	{
+		int offset = digestByte(digest, 19) & 0x0F;
+		return ((digestByte(digest, offset) & 0x7F) << 24)
+		     | (digestByte(digest, offset + 1) << 16)
+		     | (digestByte(digest, offset + 2) << 8)
+		     | digestByte(digest, offset + 3);
+	}
 
-		for (char c : input)
+	std::optional<uint32_t> parseCode(std::string_view code, int digits)
+	{
+		if (code.length() != static_cast<size_t>(digits))
+			return std::nullopt;
+
+		uint32_t value = 0;
+		for (char c : code)
 		{
-			if (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '-')
-				continue;
-
-			int val = -1;
-			if (c >= 'A' && c <= 'Z')
-				val = c - 'A';
-			else if (c >= '2' && c <= '7')
-				val = c - '2' + 26;
-			else if (c >= 'a' && c <= 'z')
-				val = c - 'a';
-
-			if (val < 0)
+			if (c < '0' || c > '9')
 				return std::nullopt;
+			value = value * 10 + (c - '0');
+		}
 
-			buffer = (buffer << 5) | val;
-			bitsLeft += 5;
+		return value;
+	}
 
-			if (bitsLeft >= 8)
-			{
-				output.push_back(static_cast<uint8_t>((buffer >> (bitsLeft - 8)) & 0xFF));
-				bitsLeft -= 8;
-			}
+	// 1 if the codes match, 0 otherwise, without a data-dependent branch.
+	uint32_t codesEqual(uint32_t a, uint32_t b)
+	{
+		uint32_t diff = a ^ b;
+		return ((diff | (0u - diff)) >> 31) ^ 1u;
+	}
+
+	// Generator and verifier for one (hash, digits) pair. The hash, the digest size and the
+	// modulus are all compile-time constants, so each instantiation is straight-line code.
+	template <class Hash, int Digits>
+	struct CodeGenerator
+	{
+		static constexpr uint32_t MODULUS = POWERS_OF_TEN[Digits];
+
+		static uint32_t generate(const TOTPKey& key, uint64_t counter)
+		{
+			uint8_t message[8];
+			TOTPCrypto::Detail::storeBE<uint64_t>(message, counter);
+
+			uint8_t hash[Hash::DIGEST_SIZE];
+			TOTPCrypto::hmacShort(hmacState<Hash>(key), message, sizeof(message), hash);
+			return truncate(hash, sizeof(hash)) % MODULUS;
+		}
+
+		static uint32_t match(const TOTPKey& key, uint32_t code, uint64_t counter, int window)
+		{
+			// Check every step without stopping at the first match so the timing does not reveal which one it was.
+			uint32_t matched = 0;
+			for (int i = -window; i <= window; i++)
+				matched |= codesEqual(generate(key, counter + i), code);
+			return matched;
+		}
+
+		static constexpr TOTPUtils::Detail::CodeFunctions FUNCTIONS = { generate, match };
+	};
+
+	template <class Hash>
+	const TOTPUtils::Detail::CodeFunctions* codeFunctions(int digits)
+	{
+		switch (digits)
+		{
+		case 6:
+			return &CodeGenerator<Hash, 6>::FUNCTIONS;
+		case 7:
+			return &CodeGenerator<Hash, 7>::FUNCTIONS;
+		default:
+			return &CodeGenerator<Hash, 8>::FUNCTIONS;
+		}
+	}
+
+	const TOTPUtils::Detail::CodeFunctions* codeFunctions(const TOTPUtils::Params& params)
+	{
+		switch (params.algorithm)
+		{
+		case Algorithm::SHA256:
+			return codeFunctions<TOTPCrypto::SHA256>(params.digits);
+		case Algorithm::SHA512:
+			return codeFunctions<TOTPCrypto::SHA512>(params.digits);
+		default:
+			return codeFunctions<TOTPCrypto::SHA1>(params.digits);
+		}
+	}
+
+	bool cacheCovers(const TOTPUtils::CodeCache& cache, uint64_t first, size_t steps)
+	{
+		return cache.count == steps && cache.first == first;
+	}
+
+	// Bring the cache to [first, first + steps), hashing only the steps it does not already hold.
+	void refreshCache(const TOTPKey& key, TOTPUtils::CodeCache& cache, uint64_t first, size_t steps)
+	{
+		if (cacheCovers(cache, first, steps))
+			return;
+
+		std::array<uint32_t, TOTPUtils::CodeCache::MAX_STEPS> codes;
+		for (size_t i = 0; i < steps; i++)
+		{
+			uint64_t counter = first + i;
+			uint64_t cached = counter - cache.first;
+			codes[i] = cached < cache.count ? cache.codes[cached] : key.functions->generate(key, counter);
 		}
 
-		return output;
+		cache.codes = codes;
+		cache.first = first;
+		cache.count = steps;
 	}
 }
 
 namespace TOTPUtils
 {
-	std::optional<std::string> generateSecret()
+	bool validParams(const Params& params)
+	{
+		return params.algorithm <= Algorithm::SHA512
+			&& params.digits >= MIN_DIGITS && params.digits <= MAX_DIGITS
+			&& params.period > 0 && params.period <= MAX_PERIOD;
+	}
+
+	std::optional<std::string> generateSecret(size_t length)
 	{
-		std::array<uint8_t, SECRET_LENGTH> randomBytes;
-		if (RAND_bytes(randomBytes.data(), randomBytes.size()) != 1)
+		std::string secret(length, '\0');
+		if (!generateSecrets(1, length, secret.data()))
 			return std::nullopt;
 
-		std::string secret;
-		secret.reserve(SECRET_LENGTH);
+		return secret;
+	}
 
-		for (uint8_t byte : randomBytes)
-			secret += BASE32_CHARS[byte % 32];
+	bool generateSecrets(size_t count, size_t length, char* output)
+	{
+		if (length == 0 || length > MAX_SECRET_LENGTH)
+			return false;
 
-		return secret;
+		// The output has no terminators, so all secrets are one run of random characters.
+		std::array<uint8_t, SECRET_CHUNK * 5 / 8> random;
+		std::array<char, SECRET_CHUNK> chars;
+		bool generated = true;
+
+		for (size_t remaining = count * length; remaining > 0;)
+		{
+			size_t n = std::min(remaining, SECRET_CHUNK);
+			size_t randomLength = (n * 5 + 7) / 8;
+			if (!TOTPCrypto::pooledRandomBytes(random.data(), randomLength))
+			{
+				generated = false;
+				break;
+			}
+
+			if (n % 8 == 0)
+			{
+				TOTPBase32::encode(random.data(), randomLength, output);
+			}
+			else
+			{
+				TOTPBase32::encode(random.data(), randomLength, chars.data());
+				std::memcpy(output, chars.data(), n);
+			}
+
+			output += n;
+			remaining -= n;
+		}
+
+		random.fill(0);
+		chars.fill(0);
+		return generated;
 	}
 
-	std::string generateTOTP(const std::string& secret, uint64_t timestamp, int timeStep)
+	std::optional<std::vector<std::string>> generateSecrets(size_t count, size_t length)
 	{
-		auto key = decodeBase32(secret);
-		if (!key)
+		if (length == 0 || length > MAX_SECRET_LENGTH)
+			return std::nullopt;
+
+		std::string flat(count * length, '\0');
+		if (!generateSecrets(count, length, flat.data()))
+			return std::nullopt;
+
+		std::vector<std::string> secrets;
+		secrets.reserve(count);
+		for (size_t i = 0; i < count; i++)
+			secrets.emplace_back(flat, i * length, length);
+
+		return secrets;
+	}
+
+	void TOTPKey::clear()
+	{
+		bytes.fill(0);
+		length = 0;
+		params = {};
+		std::memset(&hmac, 0, sizeof(hmac));
+		functions = nullptr;
+	}
+
+	bool prepareKey(std::string_view secret, const Params& params, TOTPKey& key)
+	{
+		auto length = validParams(params) ? TOTPBase32::decode(secret, key.bytes.data(), key.bytes.size()) : std::nullopt;
+		if (!length || *length == 0)
+		{
+			key.clear();
+			return false;
+		}
+
+		key.length = *length;
+		key.params = params;
+		key.functions = codeFunctions(params);
+
+		switch (params.algorithm)
+		{
+		case Algorithm::SHA256:
+			TOTPCrypto::hmacInit(key.hmac.sha256, key.bytes.data(), key.length);
+			break;
+		case Algorithm::SHA512:
+			TOTPCrypto::hmacInit(key.hmac.sha512, key.bytes.data(), key.length);
+			break;
+		default:
+			TOTPCrypto::hmacInit(key.hmac.sha1, key.bytes.data(), key.length);
+			break;
+		}
+
+		return true;
+	}
+
+	uint32_t generateCode(const TOTPKey& key, uint64_t timestamp)
+	{
+		return key.functions->generate(key, timestamp / key.params.period);
+	}
+
+	std::string generateTOTP(const TOTPKey& key, uint64_t timestamp)
+	{
+		if (key.empty())
 			return {};
 
-		uint64_t timeCounter = timestamp / timeStep;
+		uint32_t code = generateCode(key, timestamp);
 
-		std::array<uint8_t, 8> timeBytes;
-		for (int i = 7; i >= 0; i--)
+		char digits[MAX_DIGITS];
+		for (int i = key.params.digits - 1; i >= 0; i--)
 		{
-			timeBytes[i] = timeCounter & 0xFF;
-			timeCounter >>= 8;
+			digits[i] = static_cast<char>('0' + code % 10);
+			code /= 10;
 		}
 
-		auto hash = hmacSHA1(key->data(), key->size(), timeBytes);
+		return std::string(digits, key.params.digits);
+	}
 
-		int offset = hash[19] & 0x0F;
-		uint32_t code = ((hash[offset] & 0x7F) << 24)
-		              | ((hash[offset + 1] & 0xFF) << 16)
-		              | ((hash[offset + 2] & 0xFF) << 8)
-		              | (hash[offset + 3] & 0xFF);
+	bool verifyTOTP(const TOTPKey& key, std::string_view code, uint64_t timestamp, int window)
+	{
+		if (key.empty())
+			return false;
 
-		code = code % 1000000;
+		auto submitted = parseCode(code, key.params.digits);
+		if (!submitted)
+			return false;
 
-		std::ostringstream oss;
-		oss << std::setfill('0') << std::setw(6) << code;
-		return oss.str();
+		return key.functions->match(key, *submitted, timestamp / key.params.period, window) != 0;
 	}
 
-	bool verifyTOTP(const std::string& secret, const std::string& code, uint64_t timestamp, int timeStep, int window)
+	bool verifyTOTP(const TOTPKey& key, CodeCache& cache, std::string_view code, uint64_t timestamp, int window)
 	{
-		if (secret.empty() || code.length() != 6)
+		const size_t steps = static_cast<size_t>(2 * window + 1);
+		if (window < 0 || steps > CodeCache::MAX_STEPS)
+			return verifyTOTP(key, code, timestamp, window);
+
+		if (key.empty())
 			return false;
 
-		for (char c : code)
+		auto submitted = parseCode(code, key.params.digits);
+		if (!submitted)
+			return false;
+
+		refreshCache(key, cache, timestamp / key.params.period - window, steps);
+
+		// Compare against every step so the timing does not reveal which one matched.
+		uint32_t match = 0;
+		for (size_t i = 0; i < steps; i++)
+			match |= codesEqual(cache.codes[i], *submitted);
+
+		return match != 0;
+	}
+
+	size_t uncachedSteps(const TOTPKey& key, const CodeCache& cache, uint64_t timestamp, int window)
+	{
+		const size_t steps = static_cast<size_t>(2 * window + 1);
+		if (window < 0 || key.empty())
+			return 0;
+		if (steps > CodeCache::MAX_STEPS)
+			return steps;
+
+		uint64_t first = timestamp / key.params.period - window;
+		size_t missing = 0;
+		for (size_t i = 0; i < steps; i++)
+			missing += (first + i - cache.first) >= cache.count;
+		return missing;
+	}
+
+	void verifyTOTPBatch(BatchRequest* requests, size_t count, int window)
+	{
+		const size_t steps = static_cast<size_t>(2 * window + 1);
+		const size_t perPass = BATCH_JOBS / steps;
+		const bool cacheable = steps <= CodeCache::MAX_STEPS;
+
+		if (perPass == 0)
 		{
-			if (c < '0' || c > '9')
-				return false;
+			for (size_t i = 0; i < count; i++)
+			{
+				BatchRequest& request = requests[i];
+				request.success = request.key && verifyTOTP(*request.key, request.code, request.timestamp, window);
+			}
+			return;
 		}
 
-		for (int i = -window; i <= window; i++)
+		SHA1MultiBuffer::Job jobs[BATCH_JOBS];
+		uint32_t digests[BATCH_JOBS][5];
+		uint32_t expected[BATCH_JOBS];
+		uint32_t moduli[BATCH_JOBS];
+		size_t owners[BATCH_JOBS];
+		size_t stepIndex[BATCH_JOBS];
+
+		for (size_t first = 0; first < count; first += perPass)
 		{
-			uint64_t adjustedTime = timestamp + (i * timeStep);
-			std::string expectedCode = generateTOTP(secret, adjustedTime, timeStep);
+			size_t last = std::min(count, first + perPass);
+			size_t jobCount = 0;
+
+			for (size_t i = first; i < last; i++)
+			{
+				BatchRequest& request = requests[i];
+				request.success = false;
+
+				if (!request.key || request.key->empty())
+					continue;
 
-			if (code == expectedCode)
-				return true;
+				const TOTPKey& key = *request.key;
+				CodeCache* cache = cacheable ? request.cache : nullptr;
+				uint64_t counter = request.timestamp / key.params.period;
+
+				// Requests whose codes are already cached, or that the multi-buffer kernels cannot
+				// hash, take the single-request path.
+				if (key.params.algorithm != Algorithm::SHA1 || (cache && cacheCovers(*cache, counter - window, steps)))
+				{
+					request.success = cache ? verifyTOTP(key, *cache, request.code, request.timestamp, window)
+					                        : verifyTOTP(key, request.code, request.timestamp, window);
+					continue;
+				}
+
+				auto code = parseCode(request.code, key.params.digits);
+				if (!code)
+					continue;
+
+				for (int offset = -window; offset <= window; offset++)
+				{
+					SHA1MultiBuffer::Job& job = jobs[jobCount];
+					std::memcpy(job.inner, key.hmac.sha1.inner, sizeof(job.inner));
+					std::memcpy(job.outer, key.hmac.sha1.outer, sizeof(job.outer));
+					job.counter = counter + offset;
+					expected[jobCount] = *code;
+					moduli[jobCount] = POWERS_OF_TEN[key.params.digits];
+					owners[jobCount] = i;
+					stepIndex[jobCount] = static_cast<size_t>(offset + window);
+					jobCount++;
+				}
+			}
+
+			SHA1MultiBuffer::hmacCounters(jobs, jobCount, digests);
+
+			for (size_t j = 0; j < jobCount; j++)
+			{
+				BatchRequest& request = requests[owners[j]];
+				uint32_t generated = truncateDigest(digests[j]) % moduli[j];
+
+				// Caches are only updated once the pass is hashed, so a player listed twice never reads a half-filled one.
+				if (request.cache && cacheable)
+				{
+					request.cache->codes[stepIndex[j]] = generated;
+					request.cache->first = jobs[j].counter - stepIndex[j];
+					request.cache->count = steps;
+				}
+
+				request.success = request.success | (codesEqual(generated, expected[j]) != 0);
+			}
 		}
+	}
+
+	std::string generateTOTP(const std::string& secret, uint64_t timestamp, const Params& params)
+	{
+		TOTPKey key;
+		if (!prepareKey(secret, params, key))
+			return {};
+
+		return generateTOTP(key, timestamp);
+	}
+
+	bool verifyTOTP(const std::string& secret, std::string_view code, uint64_t timestamp, const Params& params, int window)
+	{
+		if (secret.empty())
+			return false;
+
+		TOTPKey key;
+		if (!prepareKey(secret, params, key))
+			return false;
 
-		return false;
+		return verifyTOTP(key, code, timestamp, window);
 	}
 }
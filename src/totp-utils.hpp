@@ -8,13 +8,125 @@
  *  The original code is copyright (c) 2025, itsneufox.
  */
 
+#include <array>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <optional>
+#include <vector>
+#include "totp-crypto.hpp"
 
 namespace TOTPUtils
 {
-	std::optional<std::string> generateSecret();
-	bool verifyTOTP(const std::string& secret, const std::string& code, uint64_t timestamp, int timeStep = 30, int window = 1);
-	std::string generateTOTP(const std::string& secret, uint64_t timestamp, int timeStep = 30);
+	// Values match TOTPAlgorithm in the public interface and TOTP_ALGORITHM in the include.
+	enum class Algorithm : uint8_t
+	{
+		SHA1 = 0,
+		SHA256 = 1,
+		SHA512 = 2,
+	};
+
+	constexpr int MIN_DIGITS = 6;
+	constexpr int MAX_DIGITS = 8;
+	constexpr int MAX_PERIOD = 3600;
+
+	// Default length of a generated secret, kept at 16 characters so existing script buffers still fit.
+	constexpr size_t DEFAULT_SECRET_LENGTH = 16;
+	// RFC 4226 asks for at least 160 bits of key; 32 base32 characters.
+	constexpr size_t RECOMMENDED_SECRET_LENGTH = 32;
+	constexpr size_t MIN_SECRET_LENGTH = 10;
+	constexpr size_t MAX_SECRET_LENGTH = 64;
+
+	// RFC 6238 parameters. The defaults are what every authenticator app assumes.
+	struct Params
+	{
+		Algorithm algorithm = Algorithm::SHA1;
+		int digits = 6;
+		int period = 30;
+	};
+
+	bool validParams(const Params& params);
+
+	namespace Detail
+	{
+		struct CodeFunctions;
+	}
+
+	// A decoded secret with the HMAC inner and outer pads already absorbed.
+	// Built once when a secret is set, so each time step only costs the two
+	// compressions over the counter and the inner digest.
+	struct TOTPKey
+	{
+		std::array<uint8_t, TOTPCrypto::SHA1::BLOCK_SIZE> bytes;
+		size_t length = 0;
+		Params params;
+
+		// Only the member for params.algorithm is valid.
+		union
+		{
+			TOTPCrypto::HMACState<TOTPCrypto::SHA1> sha1;
+			TOTPCrypto::HMACState<TOTPCrypto::SHA256> sha256;
+			TOTPCrypto::HMACState<TOTPCrypto::SHA512> sha512;
+		} hmac;
+
+		// Code generator and verifier specialized for params.algorithm and params.digits.
+		const Detail::CodeFunctions* functions = nullptr;
+
+		bool empty() const { return length == 0; }
+
+		void clear();
+	};
+
+	// Expected codes for the last window that was checked, keyed by time-step counter. Owned next to
+	// the key and cleared whenever the key changes; steps still in range are reused when the window
+	// moves, so a retry in the same step costs no HMAC work and a rollover costs one.
+	struct CodeCache
+	{
+		static constexpr size_t MAX_STEPS = 5;
+
+		uint64_t first = 0;
+		size_t count = 0;
+		std::array<uint32_t, MAX_STEPS> codes;
+
+		void clear() { count = 0; }
+	};
+
+	// One entry of a batch verification; success is filled in by verifyTOTPBatch.
+	struct BatchRequest
+	{
+		const TOTPKey* key;
+		std::string_view code;
+		uint64_t timestamp;
+		bool success;
+		// Optional, read and refreshed like verifyTOTP does with a cache.
+		CodeCache* cache = nullptr;
+	};
+
+	std::optional<std::string> generateSecret(size_t length = DEFAULT_SECRET_LENGTH);
+
+	// Write count secrets of length characters back to back into output (count * length chars,
+	// no terminators). Every character takes exactly 5 random bits, so no value is favoured.
+	bool generateSecrets(size_t count, size_t length, char* output);
+	std::optional<std::vector<std::string>> generateSecrets(size_t count, size_t length = DEFAULT_SECRET_LENGTH);
+
+	// Decode a base32 secret and precompute its HMAC state. Returns false and clears the key on invalid input.
+	bool prepareKey(std::string_view secret, const Params& params, TOTPKey& key);
+
+	// Hot path: parses the submitted code once and compares it against the truncated HMAC of
+	// each window step as integers, in constant time. Does not allocate.
+	bool verifyTOTP(const TOTPKey& key, std::string_view code, uint64_t timestamp, int window = 1);
+	// Same, but takes the expected codes from the cache and only hashes the steps it is missing.
+	bool verifyTOTP(const TOTPKey& key, CodeCache& cache, std::string_view code, uint64_t timestamp, int window = 1);
+	// Number of HMACs the cached verifyTOTP would compute right now.
+	size_t uncachedSteps(const TOTPKey& key, const CodeCache& cache, uint64_t timestamp, int window = 1);
+	uint32_t generateCode(const TOTPKey& key, uint64_t timestamp);
+	std::string generateTOTP(const TOTPKey& key, uint64_t timestamp);
+
+	// Verify many codes at once. Every window step of every SHA-1 request is hashed through the
+	// multi-buffer kernels, so N requests take roughly 3N / lanes kernel passes. Keys using
+	// other algorithms are verified one by one.
+	void verifyTOTPBatch(BatchRequest* requests, size_t count, int window = 1);
+
+	bool verifyTOTP(const std::string& secret, std::string_view code, uint64_t timestamp, const Params& params = {}, int window = 1);
+	std::string generateTOTP(const std::string& secret, uint64_t timestamp, const Params& params = {});
 }
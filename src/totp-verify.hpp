@@ -0,0 +1,372 @@
+#pragma once
+
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// The open.mp component's verify path on the main thread: the address and serial limiters, the
+// per-tick budget and the queue of attempts deferred past it, batches, and the worker pool.
+// It asks a host for players rather than the server, so neufox-2fa-loadtest can run this same
+// code with players of its own. The host provides:
+//
+//   Player* findPlayer(int id);
+//   TOTPExtension* extensionOf(Player& player);
+//   int playerID(Player& player);
+//   bool addressOf(Player& player, char (&address)[TOTPVerify::ADDRESS_LENGTH]);
+//   std::string_view serialOf(Player& player);
+//   void notifyVerify(Player& player, bool success, std::string_view code);
+//
+// notifyVerify delivers a checked attempt to subscribers and scripts. GmxSnapshot, what a
+// gamemode restart keeps, uses the same host plus:
+//
+//   std::string_view nameOf(Player& player);
+
+#include "totp-engine.hpp"
+#include "totp-extension.hpp"
+#include "totp-limiter.hpp"
+#include "totp-async.hpp"
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <string_view>
+#include <vector>
+
+namespace TOTPVerify
+{
+	// Large enough for any IPv4 or IPv6 address.
+	constexpr size_t ADDRESS_LENGTH = 64;
+
+	template <class Host, class Player>
+	class Verifier
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+		using Microseconds = std::chrono::microseconds;
+
+		explicit Verifier(Host host)
+			: host_(host)
+		{
+		}
+
+		// Main-thread work allowed per tick. Zero means no limit.
+		void setTickBudget(Microseconds time, int hashes)
+		{
+			tickBudget_ = time;
+			tickHashBudget_ = hashes;
+		}
+
+		// Tickets are shared with anything else answered on a later tick, so none repeat.
+		uint64_t nextTicket() { return ++nextTicket_; }
+
+		TOTPVerifyResult verifyCode(Player& player, std::string_view code)
+		{
+			TOTPExtension* data = beginVerify(player, code);
+			if (!data)
+				return TOTPVerifyResult::Failed;
+
+			uint64_t timestamp = TOTPEngine::currentTimestamp();
+
+			// Over budget, or others are already waiting: finish on a later tick through the callbacks.
+			if (!deferred_.empty() || !withinTickBudget())
+			{
+				DeferredVerify entry;
+				entry.ticket = nextTicket();
+				entry.playerID = host_.playerID(player);
+				std::memcpy(entry.code, code.data(), code.length());
+				entry.codeLength = code.length();
+				entry.timestamp = timestamp;
+
+				data->setPendingTicket(entry.ticket);
+				deferred_.push_back(entry);
+				return TOTPVerifyResult::Deferred;
+			}
+
+			bool success = runVerify(*data, code, timestamp);
+			finishVerify(player, *data, success, code);
+			return success ? TOTPVerifyResult::Verified : TOTPVerifyResult::Failed;
+		}
+
+		// Check every request in one pass. Request has player (a Player*), code and success.
+		template <class Request>
+		void verifyCodes(Request* requests, size_t count)
+		{
+			uint64_t timestamp = TOTPEngine::currentTimestamp();
+
+			batchRequests_.clear();
+			batchPending_.clear();
+
+			for (size_t i = 0; i < count; i++)
+			{
+				Request& request = requests[i];
+				request.success = false;
+
+				if (!request.player)
+					continue;
+
+				std::string_view code(request.code.data(), request.code.length());
+				if (TOTPExtension* data = beginVerify(*request.player, code))
+				{
+					batchRequests_.push_back({ &data->getKey(), code, timestamp, false, &data->getCodeCache() });
+					batchPending_.push_back({ i, data });
+				}
+			}
+
+			for (const TOTPUtils::BatchRequest& batchRequest : batchRequests_)
+				tickHashes_ += static_cast<int>(TOTPUtils::uncachedSteps(*batchRequest.key, *batchRequest.cache, timestamp));
+
+			auto start = Clock::now();
+			TOTPUtils::verifyTOTPBatch(batchRequests_.data(), batchRequests_.size());
+			tickSpent_ += std::chrono::duration_cast<Microseconds>(Clock::now() - start);
+
+			for (size_t j = 0; j < batchRequests_.size(); j++)
+			{
+				Request& request = requests[batchPending_[j].index];
+				request.success = batchRequests_[j].success;
+				finishVerify(*request.player, *batchPending_[j].data, request.success, batchRequests_[j].code);
+			}
+		}
+
+		bool verifyCodeAsync(Player& player, std::string_view code)
+		{
+			TOTPExtension* data = beginVerify(player, code);
+			if (!data)
+				return false;
+
+			TOTPEngine::submitJob(pool_, *data, host_.playerID(player), nextTicket(), code, TOTPEngine::currentTimestamp());
+			return true;
+		}
+
+		bool isAddressThrottled(std::string_view address)
+		{
+			return limiter_.addressThrottled(address, Clock::now());
+		}
+
+		// Start a new tick's budget, check what was deferred while it lasts, and deliver what
+		// the workers finished.
+		void onTick()
+		{
+			tickSpent_ = Microseconds(0);
+			tickHashes_ = 0;
+
+			while (!deferred_.empty() && withinTickBudget())
+			{
+				DeferredVerify entry = deferred_.front();
+				deferred_.pop_front();
+
+				Player* player = host_.findPlayer(entry.playerID);
+				TOTPExtension* data = player ? host_.extensionOf(*player) : nullptr;
+				if (!data || data->getPendingTicket() != entry.ticket)
+					continue;
+
+				data->setPendingTicket(0);
+				std::string_view code(entry.code, entry.codeLength);
+				finishVerify(*player, *data, runVerify(*data, code, entry.timestamp), code);
+			}
+
+			pool_.drain([this](TOTPAsync::VerifyJob& job)
+			{
+				Player* player = host_.findPlayer(job.playerID);
+				TOTPExtension* data = player ? host_.extensionOf(*player) : nullptr;
+
+				// The player left, or their secret or settings changed while the job was running.
+				if (!data || !TOTPEngine::completeJob(*data, job))
+					return;
+
+				notifyVerify(*player, job.success, std::string_view(job.code, job.codeLength));
+			});
+		}
+
+		// HMACs charged to the current tick so far.
+		int tickHashes() const { return tickHashes_; }
+
+		size_t deferred() const { return deferred_.size(); }
+
+		size_t inFlight() const { return deferred_.size() + pool_.inFlight(); }
+
+		// Wait for the workers to exit. Unfinished jobs are dropped.
+		void stop() { pool_.stop(); }
+
+	private:
+		Host host_;
+
+		TOTPLimiter::ConnectionLimiter limiter_;
+
+		struct PendingVerify
+		{
+			size_t index;
+			TOTPExtension* data;
+		};
+
+		// Scratch space reused by verifyCodes.
+		std::vector<TOTPUtils::BatchRequest> batchRequests_;
+		std::vector<PendingVerify> batchPending_;
+
+		// Workers for verifyCodeAsync; results are collected in onTick.
+		TOTPAsync::VerifyPool pool_;
+		uint64_t nextTicket_ = 0;
+
+		// An attempt that did not fit in its tick's budget. Players have at most one attempt
+		// pending, so serving the queue in order is round-robin between players.
+		struct DeferredVerify
+		{
+			uint64_t ticket;
+			int playerID;
+			char code[TOTPUtils::MAX_DIGITS];
+			size_t codeLength;
+			uint64_t timestamp;
+		};
+
+		std::deque<DeferredVerify> deferred_;
+
+		Microseconds tickBudget_ { 0 };
+		int tickHashBudget_ = 0;
+		Microseconds tickSpent_ { 0 };
+		int tickHashes_ = 0;
+
+		bool withinTickBudget() const
+		{
+			return (tickBudget_.count() == 0 || tickSpent_ < tickBudget_)
+				&& (tickHashBudget_ == 0 || tickHashes_ < tickHashBudget_);
+		}
+
+		// Validates the attempt and applies rate limiting. Returns the player's data if the code should be checked.
+		TOTPExtension* beginVerify(Player& player, std::string_view code)
+		{
+			TOTPExtension* data = host_.extensionOf(player);
+			if (!data)
+				return nullptr;
+
+			auto now = Clock::now();
+
+			// Reconnecting resets the per-player counter, but not these.
+			char address[ADDRESS_LENGTH];
+			if (limiter_.throttled(addressOf(player, address), host_.serialOf(player), now))
+				return nullptr;
+
+			if (!TOTPEngine::beginVerify(*data, code, now))
+				return nullptr;
+
+			return data;
+		}
+
+		// The player's address, or empty if the host cannot tell.
+		std::string_view addressOf(Player& player, char (&address)[ADDRESS_LENGTH])
+		{
+			return host_.addressOf(player, address) ? std::string_view(address) : std::string_view();
+		}
+
+		// Runs the check on the main thread and charges it to the tick budget.
+		bool runVerify(TOTPExtension& data, std::string_view code, uint64_t timestamp)
+		{
+			tickHashes_ += static_cast<int>(TOTPUtils::uncachedSteps(data.getKey(), data.getCodeCache(), timestamp));
+
+			auto start = Clock::now();
+			bool success = TOTPEngine::verify(data, code, timestamp);
+			tickSpent_ += std::chrono::duration_cast<Microseconds>(Clock::now() - start);
+
+			return success;
+		}
+
+		void finishVerify(Player& player, TOTPExtension& data, bool success, std::string_view code)
+		{
+			TOTPEngine::finishVerify(data, success);
+			notifyVerify(player, success, code);
+		}
+
+		// The part of finishVerify after the player's own state is updated.
+		void notifyVerify(Player& player, bool success, std::string_view code)
+		{
+			if (!success)
+			{
+				char address[ADDRESS_LENGTH];
+				limiter_.recordFailure(addressOf(player, address), host_.serialOf(player), Clock::now());
+			}
+
+			host_.notifyVerify(player, success, code);
+		}
+	};
+
+	// What TOTPExtension::reset() clears, kept across a gamemode restart and put back when the
+	// next script loads if the player's name, serial and address still match.
+	template <class Host, class Player>
+	class GmxSnapshot
+	{
+	public:
+		explicit GmxSnapshot(Host host)
+			: host_(host)
+		{
+		}
+
+		// Reset the player's verification state, remembering it first if keep is set.
+		void reset(Player& player, bool keep)
+		{
+			TOTPExtension* data = host_.extensionOf(player);
+			if (!data)
+				return;
+
+			if (keep)
+				saved_.push_back({ identityOf(player), data->getLastAttempt(), host_.playerID(player), data->getFailedAttempts(), data->isVerified() });
+			data->reset();
+		}
+
+		bool empty() const { return saved_.empty(); }
+
+		void clear() { saved_.clear(); }
+
+		// Put back what reset() remembered, and forget it.
+		void restore()
+		{
+			for (const Saved& saved : saved_)
+			{
+				Player* player = host_.findPlayer(saved.playerID);
+				TOTPExtension* data = player ? host_.extensionOf(*player) : nullptr;
+
+				// Someone else may have taken the slot while no script was loaded.
+				if (!data || identityOf(*player) != saved.identity)
+					continue;
+
+				data->setVerified(saved.verified && data->isEnabled());
+				data->setFailedAttempts(saved.failedAttempts);
+				data->setLastAttempt(saved.lastAttempt);
+			}
+			saved_.clear();
+		}
+
+	private:
+		struct Saved
+		{
+			uint64_t identity;
+			TimePoint lastAttempt;
+			int playerID;
+			int failedAttempts;
+			bool verified;
+		};
+
+		Host host_;
+		std::vector<Saved> saved_;
+
+		// FNV-1a over the player's name, serial and address, to tell whether a slot still holds
+		// the same player.
+		uint64_t identityOf(Player& player)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			auto mix = [&hash](std::string_view text)
+			{
+				for (char c : text)
+					hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+				hash = (hash ^ 0xFF) * 1099511628211ull;
+			};
+
+			char address[ADDRESS_LENGTH] = {};
+			host_.addressOf(player, address);
+			mix(host_.nameOf(player));
+			mix(host_.serialOf(player));
+			mix(std::string_view(address, std::strlen(address)));
+			return hash;
+		}
+	};
+}
@@ -0,0 +1,321 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Checks that verifying a code never touches the heap. The global operator new is replaced
+// to count allocations, and each verify overload is called for every algorithm, digit count
+// and window with valid, wrong and malformed codes. The engine is then run on plugin-mode
+// player state, and TOTP_Verify through its native with the callback dispatched to scripts.
+// Any allocation fails the test.
+
+#include "totp-utils.hpp"
+#include "totp-engine.hpp"
+#include "totp-plugin.hpp"
+#include "totp-player-data.hpp"
+#include "totp-dispatch.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+	std::atomic<uint64_t> allocations { 0 };
+}
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+// GCC sees the malloc behind operator new once both are inlined into a caller, and takes the
+// matching operator delete for a mismatched free.
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+
+// What the natives need from the rest of the plugin, with the AMX replaced by a flat array of
+// cells: an address is an index into it, and strings are stored one character per cell.
+void* pAMXFunctions = nullptr;
+logprintf_t logprintf = nullptr;
+bool isPluginMode = true;
+
+namespace
+{
+	cell amxMemory[64];
+
+	// Stands in for a loaded script; only counts its callbacks.
+	struct TestScript
+	{
+		uint64_t calls = 0;
+	};
+
+	struct Script
+	{
+		TestScript* script;
+		int publics[PLUGIN_CALLBACK_COUNT];
+	};
+
+	TOTPDispatch::ScriptList<Script> scripts;
+
+	// Store a string at address and return the address.
+	cell putString(cell address, std::string_view text)
+	{
+		for (size_t i = 0; i < text.length(); i++)
+			amxMemory[address + i] = static_cast<unsigned char>(text[i]);
+		amxMemory[address + text.length()] = 0;
+		return address;
+	}
+}
+
+int AMXAPI amx_GetAddr(AMX* amx, cell address, cell** physical)
+{
+	*physical = &amxMemory[address];
+	return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_GetString(char* dest, const cell* source, int useWchar, size_t size)
+{
+	size_t i = 0;
+	for (; i + 1 < size && source[i]; i++)
+		dest[i] = static_cast<char>(source[i]);
+	dest[i] = '\0';
+	return AMX_ERR_NONE;
+}
+
+int AMXAPI amx_SetString(cell* dest, const char* source, int pack, int useWchar, size_t size)
+{
+	size_t i = 0;
+	for (; i + 1 < size && source[i]; i++)
+		dest[i] = static_cast<unsigned char>(source[i]);
+	dest[i] = 0;
+	return AMX_ERR_NONE;
+}
+
+// As the plugin dispatches them, minus running the public.
+void CallPluginCallback(PluginCallback callback, int playerid, bool success)
+{
+	scripts.call(&Script::script, static_cast<const TestScript*>(nullptr),
+		[callback](const Script& script)
+		{
+			return script.publics[callback] >= 0;
+		},
+		[](const Script& script)
+		{
+			script.script->calls++;
+		});
+}
+
+void CallPluginCallback(PluginCallback callback, int playerid)
+{
+	CallPluginCallback(callback, playerid, false);
+}
+
+cell AMX_NATIVE_CALL n_TOTP_Verify(AMX* amx, const cell* params);
+
+namespace
+{
+	using namespace TOTPUtils;
+
+	constexpr uint64_t TIMESTAMP = 1700000000;
+	constexpr const char* SECRET = "JBSWY3DPEHPK3PXPJBSWY3DPEHPK3PXP";
+
+	int failures = 0;
+
+	// Run check with allocations counted and report the case if any happened or it returned false.
+	template <class Check>
+	void expect(const std::string& name, Check check)
+	{
+		uint64_t before = allocations.load(std::memory_order_relaxed);
+		bool passed = check();
+		uint64_t allocated = allocations.load(std::memory_order_relaxed) - before;
+		if (allocated != 0 || !passed)
+		{
+			std::fprintf(stderr, "FAIL %s: %s, %llu allocation(s)\n", name.c_str(), passed ? "ok" : "wrong result",
+				static_cast<unsigned long long>(allocated));
+			failures++;
+		}
+	}
+}
+
+int main()
+{
+	const Algorithm algorithms[] = { Algorithm::SHA1, Algorithm::SHA256, Algorithm::SHA512 };
+
+	for (Algorithm algorithm : algorithms)
+	{
+		for (int digits = MIN_DIGITS; digits <= MAX_DIGITS; digits++)
+		{
+			Params params;
+			params.algorithm = algorithm;
+			params.digits = digits;
+
+			TOTPKey key;
+			if (!prepareKey(SECRET, params, key))
+			{
+				std::fprintf(stderr, "FAIL prepareKey\n");
+				return 1;
+			}
+
+			// Built before counting starts; only the verify calls are measured.
+			std::string secret = SECRET;
+			std::string valid = generateTOTP(key, TIMESTAMP);
+			std::string wrong = valid;
+			wrong[0] = wrong[0] == '9' ? '0' : static_cast<char>(wrong[0] + 1);
+			std::string malformed = std::string(static_cast<size_t>(digits) - 1, '1') + "x";
+			std::string prefix = "alg:" + std::to_string(static_cast<int>(algorithm)) + "/digits:" + std::to_string(digits);
+
+			for (int window = 0; window <= 2; window++)
+			{
+				std::string suffix = "/window:" + std::to_string(window);
+
+				expect(prefix + "/key/valid" + suffix, [&] { return verifyTOTP(key, valid, TIMESTAMP, window); });
+				expect(prefix + "/key/wrong" + suffix, [&] { return !verifyTOTP(key, wrong, TIMESTAMP, window); });
+				expect(prefix + "/key/malformed" + suffix, [&] { return !verifyTOTP(key, malformed, TIMESTAMP, window); });
+				expect(prefix + "/string/valid" + suffix, [&] { return verifyTOTP(secret, valid, TIMESTAMP, params, window); });
+				expect(prefix + "/string/wrong" + suffix, [&] { return !verifyTOTP(secret, wrong, TIMESTAMP, params, window); });
+
+				// First call fills the cache, the retry reads it, the next step rolls it over.
+				CodeCache cache;
+				expect(prefix + "/cache/fill" + suffix, [&] { return verifyTOTP(key, cache, valid, TIMESTAMP, window); });
+				expect(prefix + "/cache/hit" + suffix, [&] { return verifyTOTP(key, cache, valid, TIMESTAMP, window); });
+				expect(prefix + "/cache/rollover" + suffix, [&] { return !verifyTOTP(key, cache, wrong, TIMESTAMP + 30 * (window + 1), window); });
+			}
+		}
+	}
+
+	// A batch mixing algorithms, so both the multi-buffer and the one-by-one paths run.
+	std::vector<TOTPKey> keys(24);
+	std::vector<std::string> codes(keys.size());
+	std::vector<CodeCache> caches(keys.size());
+	std::vector<BatchRequest> requests(keys.size());
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		Params params;
+		params.algorithm = algorithms[i % 3 == 2 ? 1 : 0];
+		prepareKey(SECRET, params, keys[i]);
+		codes[i] = generateTOTP(keys[i], TIMESTAMP);
+		requests[i].key = &keys[i];
+		requests[i].code = codes[i];
+		requests[i].timestamp = TIMESTAMP;
+		requests[i].cache = i % 2 ? &caches[i] : nullptr;
+	}
+
+	for (int window = 0; window <= 2; window++)
+	{
+		expect("batch/window:" + std::to_string(window), [&]
+		{
+			verifyTOTPBatch(requests.data(), requests.size(), window);
+			for (const BatchRequest& request : requests)
+			{
+				if (!request.success)
+					return false;
+			}
+			return true;
+		});
+	}
+
+	// The engine on plugin-mode player state: an attempt begun, checked and applied.
+	PlayerDataManager& players = PlayerDataManager::Get();
+	players.Resize(8);
+	for (int playerid = 0; playerid < 8; playerid++)
+	{
+		auto slot = players.GetSlot(playerid);
+		TOTPEngine::enable(slot, SECRET);
+	}
+
+	{
+		TOTPKey key;
+		prepareKey(SECRET, Params {}, key);
+		std::string valid = generateTOTP(key, TIMESTAMP);
+		std::string wrong = std::string(valid.length(), valid[0] == '1' ? '2' : '1');
+
+		auto attempt = [&](int playerid, const std::string& code)
+		{
+			auto slot = players.GetSlot(playerid);
+			if (!TOTPEngine::beginVerify(slot, code, TOTPEngine::Clock::now()))
+				return false;
+			bool success = TOTPEngine::verify(slot, code, TIMESTAMP);
+			TOTPEngine::finishVerify(slot, success);
+			return success;
+		};
+
+		expect("engine/valid", [&] { return attempt(0, valid) && players.IsVerified(0); });
+		expect("engine/wrong", [&] { return !attempt(1, wrong) && players.GetFailedAttempts(1) == 1; });
+	}
+
+	// TOTP_Verify as a script calls it, with the result delivered to three scripts, one of which
+	// does not define the callback.
+	TestScript sideScript, otherScript, gamemode;
+	scripts.add({ &sideScript, { 0, -1, -1, -1 } });
+	scripts.add({ &otherScript, { -1, -1, -1, -1 } });
+	scripts.add({ &gamemode, { 0, -1, -1, -1 } });
+
+	{
+		TOTPKey key;
+		prepareKey(SECRET, Params {}, key);
+		std::string valid = generateTOTP(key, TOTPEngine::currentTimestamp());
+		std::string wrong = std::string(valid.length(), valid[0] == '1' ? '2' : '1');
+
+		auto verify = [](int playerid, cell code)
+		{
+			cell params[] = { 2 * sizeof(cell), playerid, code };
+			return n_TOTP_Verify(nullptr, params) != 0;
+		};
+
+		// The first failure builds the address and serial limiter, which is done once per server.
+		verify(7, putString(0, wrong));
+
+		cell validCode = putString(0, valid);
+		cell wrongCode = putString(16, wrong);
+		expect("native/valid", [&] { return verify(2, validCode) && players.IsVerified(2); });
+		expect("native/wrong", [&] { return !verify(3, wrongCode) && players.GetFailedAttempts(3) == 1; });
+		expect("native/throttled", [&]
+		{
+			for (int i = 0; i < TOTPEngine::MAX_FAILED_ATTEMPTS; i++)
+				verify(4, wrongCode);
+			return !verify(4, validCode);
+		});
+
+		if (sideScript.calls != gamemode.calls || otherScript.calls != 0 || sideScript.calls == 0)
+		{
+			std::fprintf(stderr, "FAIL native/callbacks: %llu, %llu and %llu calls\n", static_cast<unsigned long long>(sideScript.calls),
+				static_cast<unsigned long long>(otherScript.calls), static_cast<unsigned long long>(gamemode.calls));
+			failures++;
+		}
+	}
+
+	if (failures)
+	{
+		std::fprintf(stderr, "%d case(s) failed\n", failures);
+		return 1;
+	}
+
+	std::printf("verify path: no allocations\n");
+	return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ *  This Source Code Form is subject to the terms of the Mozilla Public License,
+ *  v. 2.0. If a copy of the MPL was not distributed with this file, You can
+ *  obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ *  The original code is copyright (c) 2025, itsneufox.
+ */
+
+// Checks the order scripts get callbacks in, and that a callback loading or unloading scripts
+// neither skips a script nor reaches one that was not loaded when the event happened, even
+// when the new one takes the address of one that left.
+
+#include "totp-dispatch.hpp"
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <string>
+
+namespace
+{
+	struct Script
+	{
+		char name;
+	};
+
+	struct Entry
+	{
+		Script* script;
+		bool wants;
+	};
+
+	int failures = 0;
+
+	using Scripts = TOTPDispatch::ScriptList<Entry>;
+
+	Scripts load(std::initializer_list<Entry> entries)
+	{
+		Scripts scripts;
+		for (const Entry& entry : entries)
+			scripts.add(entry);
+		return scripts;
+	}
+
+	// Dispatch once, running action for each script called, and compare the call order.
+	void expect(const char* test, const Scripts& scripts, const Script* last, const std::string& expected,
+		const std::function<void(const Script&)>& action = nullptr)
+	{
+		std::string called;
+		scripts.call(&Entry::script, last,
+			[](const Entry& entry)
+			{
+				return entry.wants;
+			},
+			[&](const Entry& entry)
+			{
+				called += entry.script->name;
+				if (action)
+					action(*entry.script);
+			});
+
+		if (called != expected)
+		{
+			std::fprintf(stderr, "FAIL %s: called \"%s\", expected \"%s\"\n", test, called.c_str(), expected.c_str());
+			failures++;
+		}
+	}
+
+	void unload(Scripts& scripts, const Script* script)
+	{
+		scripts.remove(&Entry::script, script);
+	}
+}
+
+int main()
+{
+	Script a { 'a' }, b { 'b' }, c { 'c' }, d { 'd' }, gamemode { 'm' }, late { 'x' };
+
+	// Side scripts in load order, then the main script wherever it sits in the list.
+	{
+		Scripts scripts = load({ { &a, true }, { &gamemode, true }, { &b, true }, { &c, false } });
+		expect("order", scripts, &gamemode, "abm");
+		expect("order without main", scripts, nullptr, "amb");
+	}
+
+	// Unloading a script that was already called must not skip the next one.
+	{
+		Scripts scripts = load({ { &a, true }, { &b, true }, { &c, true }, { &gamemode, true } });
+		expect("unload called script", scripts, &gamemode, "abcm", [&](const Script& script)
+		{
+			if (&script == &b)
+				unload(scripts, &a);
+		});
+	}
+
+	// A script unloaded before its turn is not called; the rest still are.
+	{
+		Scripts scripts = load({ { &a, true }, { &b, true }, { &c, true }, { &gamemode, true } });
+		expect("unload pending script", scripts, &gamemode, "acm", [&](const Script& script)
+		{
+			if (&script == &a)
+				unload(scripts, &b);
+		});
+	}
+
+	// Unloading the main script from a side script's callback.
+	{
+		Scripts scripts = load({ { &a, true }, { &gamemode, true }, { &b, true } });
+		expect("unload main script", scripts, &gamemode, "ab", [&](const Script& script)
+		{
+			if (&script == &a)
+				unload(scripts, &gamemode);
+		});
+	}
+
+	// A script loaded by a callback only sees later events.
+	{
+		Scripts scripts = load({ { &a, true }, { &b, true }, { &gamemode, true } });
+		expect("load script", scripts, &gamemode, "abm", [&](const Script& script)
+		{
+			if (&script == &a)
+				scripts.add({ &late, true });
+		});
+		expect("loaded script", scripts, &gamemode, "abxm");
+	}
+
+	// A callback that unloads and loads enough to move the list does not break the dispatch.
+	{
+		Scripts scripts = load({ { &a, true }, { &b, true }, { &c, true }, { &d, true }, { &gamemode, true } });
+		expect("reallocate", scripts, &gamemode, "adm", [&](const Script& script)
+		{
+			if (&script != &a)
+				return;
+			unload(scripts, &b);
+			unload(scripts, &c);
+			for (int i = 0; i < 64; i++)
+				scripts.add({ &late, false });
+		});
+	}
+
+	// A script unloaded and another loaded at the same address is not called in its place,
+	// with the public indices of the one that left.
+	{
+		Scripts scripts = load({ { &a, true }, { &b, true }, { &gamemode, true } });
+		expect("reload at same address", scripts, &gamemode, "am", [&](const Script& script)
+		{
+			if (&script != &a)
+				return;
+			unload(scripts, &b);
+			scripts.add({ &b, true });
+		});
+		expect("reloaded script", scripts, &gamemode, "abm");
+	}
+
+	// The main script reloaded at its own address by a side script's callback.
+	{
+		Scripts scripts = load({ { &a, true }, { &gamemode, true } });
+		expect("reload main script", scripts, &gamemode, "a", [&](const Script& script)
+		{
+			if (&script != &a)
+				return;
+			unload(scripts, &gamemode);
+			scripts.add({ &gamemode, true });
+		});
+	}
+
+	// A callback may dispatch another event, which runs to completion inside it.
+	{
+		Scripts scripts = load({ { &a, true }, { &b, true }, { &gamemode, true } });
+		bool nested = false;
+		std::string inner;
+		expect("nested dispatch", scripts, &gamemode, "abm", [&](const Script& script)
+		{
+			if (&script != &a || nested)
+				return;
+			nested = true;
+			scripts.call(&Entry::script, &gamemode,
+				[](const Entry& entry)
+				{
+					return entry.wants;
+				},
+				[&](const Entry& entry)
+				{
+					inner += entry.script->name;
+				});
+		});
+		if (inner != "abm")
+		{
+			std::fprintf(stderr, "FAIL nested dispatch: inner called \"%s\", expected \"abm\"\n", inner.c_str());
+			failures++;
+		}
+	}
+
+	if (failures)
+	{
+		std::fprintf(stderr, "%d case(s) failed\n", failures);
+		return 1;
+	}
+
+	std::printf("script dispatch: ok\n");
+	return 0;
+}